@@ -0,0 +1,326 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace replit {
+
+// Keeps the compiler from eliding a computed value
+template<typename T>
+inline void keep(T&& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Forces pending writes to memory to be considered observable
+inline void clobber() {
+    asm volatile("" : : : "memory");
+}
+
+// Discards everything written to it; keeps OP_PRINT off the terminal
+// while benchmarks run
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+// Hardware instruction and cycle counters read as one perf_event group.
+// Unavailable when the kernel or sandbox refuses perf_event_open; callers
+// then report timings only.
+class PerfCounters {
+public:
+    struct Reading {
+        uint64_t instructions = 0;
+        uint64_t cycles = 0;
+    };
+    
+    PerfCounters() {
+#if defined(__linux__)
+        leader = open_counter(PERF_COUNT_HW_INSTRUCTIONS, -1);
+        if (leader < 0) return;
+        cycles_fd = open_counter(PERF_COUNT_HW_CPU_CYCLES, leader);
+        if (cycles_fd < 0) {
+            close(leader);
+            leader = -1;
+        }
+#endif
+    }
+    
+    ~PerfCounters() {
+#if defined(__linux__)
+        if (cycles_fd >= 0) close(cycles_fd);
+        if (leader >= 0) close(leader);
+#endif
+    }
+    
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    
+    bool available() const { return leader >= 0; }
+    
+    void start() {
+#if defined(__linux__)
+        if (leader < 0) return;
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+    
+    Reading stop() {
+        Reading reading;
+#if defined(__linux__)
+        if (leader < 0) return reading;
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        // PERF_FORMAT_GROUP layout: nr, then one value per counter
+        uint64_t values[3] = {};
+        if (read(leader, values, sizeof(values)) == sizeof(values) && values[0] == 2) {
+            reading.instructions = values[1];
+            reading.cycles = values[2];
+        }
+#endif
+        return reading;
+    }
+    
+private:
+    int leader = -1;
+    int cycles_fd = -1;
+
+#if defined(__linux__)
+    static int open_counter(uint64_t config, int group) {
+        perf_event_attr attr {};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = group < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+    }
+#endif
+};
+
+// One benchmark's summary. Times are per iteration; items lets a benchmark
+// that processes many elements per iteration also report a per-item cost.
+struct BenchResult {
+    std::string group;
+    std::string name;
+    uint64_t iterations = 0;
+    size_t samples = 0;
+    double items = 1;
+    double median_ns = 0;
+    double p10_ns = 0;
+    double p90_ns = 0;
+    double p99_ns = 0;
+    double min_ns = 0;
+    double mean_ns = 0;
+    double mad_ns = 0;
+    bool has_counters = false;
+    double instructions = 0;
+    double cycles = 0;
+};
+
+// Registry and runner. Each benchmark body receives an iteration count and
+// must do that many units of work; the runner calibrates the count so a
+// sample lasts at least min_sample_ms, discards a warm-up sample and then
+// takes the configured number of samples.
+class BenchSuite {
+public:
+    using Body = std::function<void(uint64_t)>;
+    
+    size_t samples = 21;
+    double min_sample_ms = 2.0;
+    std::string filter;
+    
+    void add(const std::string& group, const std::string& name, Body body, double items = 1) {
+        entries.push_back({group, name, std::move(body), items});
+    }
+    
+    std::vector<std::string> names() const {
+        std::vector<std::string> result;
+        for (const auto& entry : entries) result.push_back(entry.group + "/" + entry.name);
+        return result;
+    }
+    
+    const std::vector<BenchResult>& run() {
+        results.clear();
+        print_header();
+        for (auto& entry : entries) {
+            std::string full = entry.group + "/" + entry.name;
+            if (!filter.empty() && full.find(filter) == std::string::npos) continue;
+            results.push_back(measure(entry));
+            print_row(results.back());
+        }
+        return results;
+    }
+    
+    bool counters_available() const { return counters.available(); }
+    
+    bool write_json(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out) return false;
+        out << std::setprecision(6) << std::fixed;
+        out << "{\n  \"schema\": 1,\n";
+        out << "  \"compiler\": \"" << compiler() << "\",\n";
+        out << "  \"perf_counters\": " << (counters.available() ? "true" : "false") << ",\n";
+        out << "  \"samples\": " << samples << ",\n";
+        out << "  \"results\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const BenchResult& r = results[i];
+            out << (i ? ",\n" : "\n") << "    {";
+            out << "\"group\": \"" << r.group << "\", \"name\": \"" << r.name << "\", ";
+            out << "\"iterations\": " << r.iterations << ", \"samples\": " << r.samples << ", ";
+            out << "\"items\": " << r.items << ", ";
+            out << "\"median_ns\": " << r.median_ns << ", \"p10_ns\": " << r.p10_ns << ", ";
+            out << "\"p90_ns\": " << r.p90_ns << ", \"p99_ns\": " << r.p99_ns << ", ";
+            out << "\"min_ns\": " << r.min_ns << ", \"mean_ns\": " << r.mean_ns << ", ";
+            out << "\"mad_ns\": " << r.mad_ns << ", ";
+            out << "\"ns_per_item\": " << r.median_ns / r.items << ", ";
+            if (r.has_counters) {
+                out << "\"instructions\": " << r.instructions << ", \"cycles\": " << r.cycles << ", ";
+                out << "\"ipc\": " << (r.cycles > 0 ? r.instructions / r.cycles : 0.0);
+            } else {
+                out << "\"instructions\": null, \"cycles\": null, \"ipc\": null";
+            }
+            out << "}";
+        }
+        out << "\n  ]\n}\n";
+        return static_cast<bool>(out);
+    }
+    
+private:
+    struct Entry {
+        std::string group;
+        std::string name;
+        Body body;
+        double items;
+    };
+    
+    std::vector<Entry> entries;
+    std::vector<BenchResult> results;
+    PerfCounters counters;
+    
+    using Clock = std::chrono::steady_clock;
+    
+    static double elapsed_ns(Clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+    
+    // Linear interpolation between closest ranks of sorted data
+    static double percentile(const std::vector<double>& sorted, double p) {
+        if (sorted.empty()) return 0;
+        double rank = p * (sorted.size() - 1);
+        size_t low = static_cast<size_t>(rank);
+        size_t high = std::min(low + 1, sorted.size() - 1);
+        return sorted[low] + (sorted[high] - sorted[low]) * (rank - low);
+    }
+    
+    BenchResult measure(Entry& entry) {
+        // Double the iteration count until one sample is long enough to
+        // swamp timer resolution
+        uint64_t iterations = 1;
+        double target_ns = min_sample_ms * 1e6;
+        while (true) {
+            auto start = Clock::now();
+            entry.body(iterations);
+            double ns = elapsed_ns(start);
+            if (ns >= target_ns || iterations >= (uint64_t(1) << 40)) break;
+            uint64_t scale = ns > 0 ? static_cast<uint64_t>(target_ns / ns * 1.2) + 1 : 16;
+            iterations *= std::min<uint64_t>(std::max<uint64_t>(scale, 2), 16);
+        }
+        
+        entry.body(iterations);
+        
+        std::vector<double> per_iteration;
+        per_iteration.reserve(samples);
+        PerfCounters::Reading total;
+        for (size_t s = 0; s < samples; ++s) {
+            counters.start();
+            auto start = Clock::now();
+            entry.body(iterations);
+            double ns = elapsed_ns(start);
+            PerfCounters::Reading reading = counters.stop();
+            total.instructions += reading.instructions;
+            total.cycles += reading.cycles;
+            per_iteration.push_back(ns / iterations);
+        }
+        
+        BenchResult result;
+        result.group = entry.group;
+        result.name = entry.name;
+        result.iterations = iterations;
+        result.samples = samples;
+        result.items = entry.items;
+        
+        double sum = 0;
+        for (double value : per_iteration) sum += value;
+        result.mean_ns = sum / per_iteration.size();
+        
+        std::sort(per_iteration.begin(), per_iteration.end());
+        result.min_ns = per_iteration.front();
+        result.median_ns = percentile(per_iteration, 0.5);
+        result.p10_ns = percentile(per_iteration, 0.1);
+        result.p90_ns = percentile(per_iteration, 0.9);
+        result.p99_ns = percentile(per_iteration, 0.99);
+        
+        std::vector<double> deviations;
+        for (double value : per_iteration) deviations.push_back(std::fabs(value - result.median_ns));
+        std::sort(deviations.begin(), deviations.end());
+        result.mad_ns = percentile(deviations, 0.5);
+        
+        if (counters.available() && total.cycles > 0) {
+            double runs = static_cast<double>(iterations) * samples;
+            result.has_counters = true;
+            result.instructions = total.instructions / runs;
+            result.cycles = total.cycles / runs;
+        }
+        return result;
+    }
+    
+    static std::string compiler() {
+#if defined(__clang__)
+        return "clang " __clang_version__;
+#elif defined(__GNUC__)
+        return "gcc " __VERSION__;
+#else
+        return "unknown";
+#endif
+    }
+    
+    void print_header() const {
+        std::printf("%-36s %12s %12s %12s %8s %8s\n",
+                    "benchmark", "median", "p90", "per item", "mad%", "ipc");
+    }
+    
+    void print_row(const BenchResult& r) const {
+        std::string full = r.group + "/" + r.name;
+        double mad = r.median_ns > 0 ? 100.0 * r.mad_ns / r.median_ns : 0;
+        char ipc[16] = "-";
+        if (r.has_counters && r.cycles > 0) std::snprintf(ipc, sizeof(ipc), "%.2f", r.instructions / r.cycles);
+        std::printf("%-36s %10.1fns %10.1fns %10.2fns %7.2f%% %8s\n",
+                    full.c_str(), r.median_ns, r.p90_ns, r.median_ns / r.items, mad, ipc);
+        std::fflush(stdout);
+    }
+};
+
+// Registration hooks implemented by the benchmark translation units
+void register_micro_benchmarks(BenchSuite& suite);
+void register_macro_benchmarks(BenchSuite& suite);
+
+}
\ No newline at end of file
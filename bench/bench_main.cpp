@@ -0,0 +1,49 @@
+#include "bench.hpp"
+#include <cstdlib>
+
+// Usage: replit_bench [--filter text] [--json path] [--samples n]
+//                     [--min-time ms] [--list]
+int main(int argc, char* argv[]) {
+    replit::BenchSuite suite;
+    std::string json_path;
+    bool list_only = false;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--filter" && has_value) {
+            suite.filter = argv[++i];
+        } else if (arg == "--json" && has_value) {
+            json_path = argv[++i];
+        } else if (arg == "--samples" && has_value) {
+            suite.samples = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--min-time" && has_value) {
+            suite.min_sample_ms = std::max(0.01, std::atof(argv[++i]));
+        } else if (arg == "--list") {
+            list_only = true;
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--filter text] [--json path] [--samples n] [--min-time ms] [--list]" << std::endl;
+            return 1;
+        }
+    }
+    
+    replit::register_micro_benchmarks(suite);
+    replit::register_macro_benchmarks(suite);
+    
+    if (list_only) {
+        for (const auto& name : suite.names()) std::cout << name << std::endl;
+        return 0;
+    }
+    
+    if (!suite.counters_available()) {
+        std::cerr << "perf counters unavailable; reporting timings only" << std::endl;
+    }
+    suite.run();
+    
+    if (!json_path.empty() && !suite.write_json(json_path)) {
+        std::cerr << "Could not write " << json_path << std::endl;
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "bench.hpp"
+#include "replit_core.hpp"
+#include <random>
+
+namespace replit {
+
+namespace {
+
+// Random well-formed expression over numeric literals with at most
+// `literals` leaves
+std::string arithmetic_expression(std::mt19937& rng, int literals) {
+    static const char* OPERATORS[] = {" + ", " - ", " * ", " / "};
+    std::uniform_int_distribution<int> value(1, 999);
+    std::string expr = std::to_string(value(rng));
+    for (int i = 1; i < literals; ++i) {
+        std::string rhs = std::to_string(value(rng));
+        if (rng() % 3 == 0) expr = "(" + expr + ")";
+        expr += OPERATORS[rng() % 4] + rhs;
+    }
+    return expr;
+}
+
+// Generated scripts are kept below the 256-constant limit of one chunk
+struct Script {
+    std::string name;
+    std::string source;
+    double statements = 0;
+};
+
+Script arithmetic_script(uint32_t seed) {
+    std::mt19937 rng(seed);
+    Script script{"arithmetic", "", 0};
+    for (int i = 0; i < 60; ++i) {
+        script.source += arithmetic_expression(rng, 4) + ";\n";
+        script.statements++;
+    }
+    return script;
+}
+
+Script comparison_script(uint32_t seed) {
+    std::mt19937 rng(seed);
+    Script script{"comparison", "", 0};
+    static const char* COMPARE[] = {" < ", " > ", " <= ", " >= ", " == ", " != "};
+    for (int i = 0; i < 60; ++i) {
+        std::string lhs = arithmetic_expression(rng, 2);
+        std::string rhs = arithmetic_expression(rng, 2);
+        script.source += "!(" + lhs + COMPARE[rng() % 6] + rhs + ");\n";
+        script.statements++;
+    }
+    return script;
+}
+
+Script string_script(uint32_t seed) {
+    std::mt19937 rng(seed);
+    Script script{"strings", "", 0};
+    for (int i = 0; i < 60; ++i) {
+        script.source += "\"item" + std::to_string(rng() % 100) + "\" + \"-\" + " +
+                         std::to_string(rng() % 100) + ";\n";
+        script.statements++;
+    }
+    return script;
+}
+
+Script print_script(uint32_t seed) {
+    std::mt19937 rng(seed);
+    Script script{"print", "", 0};
+    for (int i = 0; i < 80; ++i) {
+        if (i % 2) script.source += "print \"line " + std::to_string(i) + "\";\n";
+        else script.source += "print " + arithmetic_expression(rng, 2) + ";\n";
+        script.statements++;
+    }
+    return script;
+}
+
+// Nested counting loops over block-scoped locals
+Script loop_script(uint32_t seed) {
+    std::mt19937 rng(seed);
+    Script script{"loops", "", 0};
+    int outer = 4 + static_cast<int>(rng() % 4);
+    script.source = "{\n    let total = 0;\n"
+                    "    for (let i = 0; i < " + std::to_string(outer) + "; i = i + 1) {\n"
+                    "        let j = 0;\n"
+                    "        while (j < 250) {\n"
+                    "            total = total + i * j;\n"
+                    "            j = j + 1;\n"
+                    "        }\n"
+                    "    }\n"
+                    "    print total;\n}\n";
+    script.statements = outer * 250.0 * 2;
+    return script;
+}
+
+void add_script(BenchSuite& suite, std::shared_ptr<VM> vm, std::shared_ptr<NullBuffer> sink,
+                const std::string& name, std::vector<Script> scripts) {
+    double statements = 0;
+    for (const auto& script : scripts) statements += script.statements;
+    auto shared = std::make_shared<std::vector<Script>>(std::move(scripts));
+    
+    suite.add("macro", name, [vm, sink, shared](uint64_t iterations) {
+        std::streambuf* previous = std::cout.rdbuf(sink.get());
+        for (uint64_t i = 0; i < iterations; ++i) {
+            for (const auto& script : *shared) {
+                VM::InterpretResult result = vm->interpret(script.source);
+                keep(result);
+            }
+        }
+        std::cout.rdbuf(previous);
+    }, statements);
+}
+
+}
+
+// End-to-end lex, compile and run of generated scripts; items are statements
+void register_macro_benchmarks(BenchSuite& suite) {
+    auto vm = std::make_shared<VM>();
+    auto sink = std::make_shared<NullBuffer>();
+    
+    add_script(suite, vm, sink, "arithmetic", {arithmetic_script(1)});
+    add_script(suite, vm, sink, "comparison", {comparison_script(2)});
+    add_script(suite, vm, sink, "strings", {string_script(3)});
+    add_script(suite, vm, sink, "print", {print_script(4)});
+    add_script(suite, vm, sink, "loops", {loop_script(5)});
+    
+    // Many small programs, as a REPL session or test runner would submit
+    std::vector<Script> session;
+    for (uint32_t seed = 0; seed < 16; ++seed) {
+        switch (seed % 4) {
+            case 0: session.push_back(arithmetic_script(100 + seed)); break;
+            case 1: session.push_back(comparison_script(100 + seed)); break;
+            case 2: session.push_back(string_script(100 + seed)); break;
+            default: session.push_back(print_script(100 + seed)); break;
+        }
+    }
+    add_script(suite, vm, sink, "session", std::move(session));
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,321 @@
+#include "bench.hpp"
+#include "replit_core.hpp"
+#include "standard_library.hpp"
+#include "graphics.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+namespace replit {
+
+namespace {
+
+std::vector<Token> tokenize(const std::string& source) {
+    Lexer lexer(source);
+    std::vector<Token> tokens;
+    while (true) {
+        tokens.push_back(lexer.scan_token());
+        if (tokens.back().type == TokenType::EOF_TOKEN) break;
+    }
+    return tokens;
+}
+
+// Mixed expression and print statements; stays under the 256-constant
+// limit of a single chunk
+std::string expression_source(int statements) {
+    static const char* LINES[] = {
+        "1 + 2 * 3 - 4 / 5;",
+        "print (10 - 3) * 2;",
+        "!(1 < 2) == false;",
+        "\"left\" + \"right\";",
+        "-(7 * 8) >= 3 + 4;",
+        "print \"value\";",
+    };
+    std::string source;
+    for (int i = 0; i < statements; ++i) {
+        source += LINES[i % 6];
+        source += "\n";
+    }
+    return source;
+}
+
+uint8_t op(OpCode code) { return static_cast<uint8_t>(code); }
+
+// A chunk that executes `body` repeat times between a prologue and an
+// epilogue, so the measured opcode dominates the run
+struct OpcodeProgram {
+    std::string name;
+    Chunk chunk;
+    double instructions = 0;
+};
+
+OpcodeProgram opcode_program(const std::string& name, const std::vector<Value>& constants,
+                             const std::vector<uint8_t>& prologue,
+                             const std::vector<uint8_t>& body,
+                             const std::vector<uint8_t>& epilogue, int repeat) {
+    OpcodeProgram program;
+    program.name = name;
+    for (const Value& value : constants) program.chunk.add_constant(value);
+    for (uint8_t byte : prologue) program.chunk.write(byte, 1);
+    for (int i = 0; i < repeat; ++i) {
+        for (uint8_t byte : body) program.chunk.write(byte, 1);
+    }
+    for (uint8_t byte : epilogue) program.chunk.write(byte, 1);
+    program.chunk.write(op(OpCode::OP_RETURN), 1);
+    
+    // Count executed instructions of the body (operands skipped)
+    int per_body = 0;
+    for (size_t i = 0; i < body.size(); ++i) {
+        per_body++;
+        if (body[i] == op(OpCode::OP_CONSTANT)) ++i;
+    }
+    program.instructions = static_cast<double>(per_body) * repeat;
+    return program;
+}
+
+std::vector<OpcodeProgram> opcode_programs() {
+    const uint8_t CONSTANT = op(OpCode::OP_CONSTANT);
+    const uint8_t POP = op(OpCode::OP_POP);
+    const int REPEAT = 256;
+    std::vector<Value> numbers = {1.0, 1.0000001};
+    std::vector<Value> bools = {true};
+    std::vector<Value> strings = {std::string("alpha"), std::string("beta")};
+    
+    std::vector<OpcodeProgram> programs;
+    programs.push_back(opcode_program("OP_CONSTANT+OP_POP", numbers, {}, {CONSTANT, 0, POP}, {}, REPEAT));
+    for (OpCode code : {OpCode::OP_ADD, OpCode::OP_SUBTRACT, OpCode::OP_MULTIPLY, OpCode::OP_DIVIDE}) {
+        programs.push_back(opcode_program(std::string(opcode_name(op(code))) + "+OP_CONSTANT", numbers,
+                                          {CONSTANT, 0}, {CONSTANT, 1, op(code)}, {POP}, REPEAT));
+    }
+    programs.push_back(opcode_program("OP_ADD(string)", strings, {},
+                                      {CONSTANT, 0, CONSTANT, 1, op(OpCode::OP_ADD), POP}, {}, REPEAT));
+    programs.push_back(opcode_program("OP_NEGATE", numbers, {CONSTANT, 0},
+                                      {op(OpCode::OP_NEGATE)}, {POP}, REPEAT));
+    programs.push_back(opcode_program("OP_NOT", bools, {CONSTANT, 0},
+                                      {op(OpCode::OP_NOT)}, {POP}, REPEAT));
+    for (OpCode code : {OpCode::OP_EQUAL, OpCode::OP_GREATER, OpCode::OP_LESS}) {
+        programs.push_back(opcode_program(opcode_name(op(code)), numbers, {},
+                                          {CONSTANT, 0, CONSTANT, 1, op(code), POP}, {}, REPEAT));
+    }
+    programs.push_back(opcode_program("OP_PRINT", numbers, {},
+                                      {CONSTANT, 0, op(OpCode::OP_PRINT)}, {}, REPEAT));
+    programs.push_back(opcode_program("OP_RETURN", {}, {}, {}, {}, 0));
+    return programs;
+}
+
+void register_lexer(BenchSuite& suite) {
+    auto source = std::make_shared<std::string>();
+    for (int i = 0; i < 40; ++i) *source += expression_source(6);
+    size_t token_count = tokenize(*source).size();
+    
+    suite.add("lexer", "scan_token", [source](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Lexer lexer(*source);
+            while (true) {
+                Token token = lexer.scan_token();
+                if (token.type == TokenType::EOF_TOKEN) break;
+                keep(token);
+            }
+        }
+    }, static_cast<double>(token_count));
+}
+
+void register_parser(BenchSuite& suite) {
+    auto tokens = std::make_shared<std::vector<Token>>(tokenize(expression_source(36)));
+    
+    suite.add("parser", "compile", [tokens](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Chunk chunk;
+            Parser parser;
+            bool ok = parser.compile(*tokens, &chunk);
+            keep(ok);
+            keep(chunk);
+        }
+    }, static_cast<double>(tokens->size()));
+}
+
+// The "vm" group measures the interpreter (with quickening), the "jit"
+// group the same programs once compiled
+void register_vm(BenchSuite& suite, const std::string& group, uint32_t jit_threshold) {
+    auto programs = std::make_shared<std::vector<OpcodeProgram>>(opcode_programs());
+    auto vm = std::make_shared<VM>();
+    auto sink = std::make_shared<NullBuffer>();
+    vm->set_jit_threshold(jit_threshold);
+    
+    for (size_t p = 0; p < programs->size(); ++p) {
+        OpcodeProgram& program = (*programs)[p];
+        suite.add(group, program.name, [programs, vm, sink, p](uint64_t iterations) {
+            std::streambuf* previous = std::cout.rdbuf(sink.get());
+            Chunk& chunk = (*programs)[p].chunk;
+            for (uint64_t i = 0; i < iterations; ++i) {
+                VM::InterpretResult result = vm->run(chunk);
+                keep(result);
+            }
+            std::cout.rdbuf(previous);
+        }, std::max(1.0, program.instructions));
+    }
+}
+
+// Cold start (running the setup scripts) against a warm start from a
+// snapshot of the globals they build. Each script stays under the
+// 256-constant limit of a chunk.
+void register_snapshot(BenchSuite& suite) {
+    const int SCRIPTS = 10;
+    const int GLOBALS = 80;
+    auto setup = std::make_shared<std::vector<std::string>>();
+    for (int s = 0; s < SCRIPTS; ++s) {
+        std::string source;
+        for (int i = 0; i < GLOBALS; ++i) {
+            std::string name = "table_" + std::to_string(s) + "_" + std::to_string(i);
+            source += "let " + name + " = \"entry\" + \"" + std::to_string(i) + "\";\n";
+        }
+        setup->push_back(source);
+    }
+    
+    auto path = std::make_shared<std::string>(
+        (std::filesystem::temp_directory_path() / "replit_bench_snapshot.img").string());
+    VM builder;
+    for (const auto& source : *setup) builder.interpret(source);
+    builder.save_snapshot(*path);
+    
+    suite.add("snapshot", "cold_start", [setup](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            VM vm;
+            for (const auto& source : *setup) keep(vm.interpret(source));
+        }
+    }, SCRIPTS * GLOBALS);
+    suite.add("snapshot", "warm_start", [path](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            VM vm;
+            vm.attach_snapshot(Snapshot::open(*path));
+            keep(vm.interpret("table_3_42;"));
+        }
+    }, SCRIPTS * GLOBALS);
+}
+
+void register_string_utils(BenchSuite& suite) {
+    auto csv = std::make_shared<std::string>();
+    for (int i = 0; i < 256; ++i) *csv += "  field_" + std::to_string(i) + " ,";
+    auto fields = std::make_shared<std::vector<std::string>>(StringUtils::split(*csv, ','));
+    
+    suite.add("string_utils", "split", [csv](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) keep(StringUtils::split(*csv, ','));
+    }, 256);
+    suite.add("string_utils", "join", [fields](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) keep(StringUtils::join(*fields, ", "));
+    }, 256);
+    suite.add("string_utils", "trim", [fields](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            for (const auto& field : *fields) keep(StringUtils::trim(field));
+        }
+    }, static_cast<double>(fields->size()));
+    suite.add("string_utils", "to_upper", [csv](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) keep(StringUtils::to_upper(*csv));
+    }, static_cast<double>(csv->size()));
+    suite.add("string_utils", "replace_all", [csv](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) keep(StringUtils::replace_all(*csv, "field", "column"));
+    }, 256);
+}
+
+void register_array(BenchSuite& suite) {
+    const size_t COUNT = 4096;
+    auto values = std::make_shared<Array<int>>();
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < COUNT; ++i) values->push(static_cast<int>(rng() % 100000));
+    
+    suite.add("array", "push", [COUNT](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Array<int> array;
+            for (size_t j = 0; j < COUNT; ++j) array.push(static_cast<int>(j));
+            keep(array);
+        }
+    }, COUNT);
+    suite.add("array", "find", [values](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) keep(values->find(-1));
+    }, COUNT);
+    suite.add("array", "sort", [values](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Array<int> copy = *values;
+            copy.sort();
+            keep(copy);
+        }
+    }, COUNT);
+    suite.add("array", "filter", [values](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            keep(values->filter([](const int& v) { return (v & 1) == 0; }));
+        }
+    }, COUNT);
+}
+
+void register_threading(BenchSuite& suite) {
+    const size_t COUNT = 1 << 16;
+    auto output = std::make_shared<std::vector<double>>(COUNT);
+    
+    suite.add("threading", "parallel_for", [output, COUNT](uint64_t iterations) {
+        double* data = output->data();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Threading::parallel_for(0, COUNT, [data](size_t j) { data[j] = std::sqrt(static_cast<double>(j)); });
+            clobber();
+        }
+    }, COUNT);
+}
+
+void register_graphics_math(BenchSuite& suite) {
+    const size_t COUNT = 1024;
+    auto points = std::make_shared<std::vector<Vector2D>>();
+    auto boxes = std::make_shared<std::vector<Rectangle>>();
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> coord(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> extent(1.0f, 40.0f);
+    for (size_t i = 0; i < COUNT; ++i) {
+        points->emplace_back(coord(rng), coord(rng));
+        boxes->emplace_back(coord(rng), coord(rng), extent(rng), extent(rng));
+    }
+    
+    suite.add("graphics_math", "vector_normalized", [points](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            float sum = 0;
+            for (const auto& p : *points) sum += p.normalized().x;
+            keep(sum);
+        }
+    }, COUNT);
+    suite.add("graphics_math", "vector_dot_distance", [points](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            float sum = 0;
+            for (size_t j = 1; j < points->size(); ++j) {
+                sum += (*points)[j].dot((*points)[j - 1]) + (*points)[j].distance((*points)[j - 1]);
+            }
+            keep(sum);
+        }
+    }, COUNT - 1);
+    suite.add("graphics_math", "rectangle_intersects", [boxes](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            int hits = 0;
+            for (size_t j = 1; j < boxes->size(); ++j) hits += (*boxes)[j].intersects((*boxes)[j - 1]);
+            keep(hits);
+        }
+    }, COUNT - 1);
+    suite.add("graphics_math", "rectangle_contains", [boxes, points](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            int hits = 0;
+            for (size_t j = 0; j < boxes->size(); ++j) hits += (*boxes)[j].contains((*points)[j]);
+            keep(hits);
+        }
+    }, COUNT);
+}
+
+}
+
+void register_micro_benchmarks(BenchSuite& suite) {
+    register_lexer(suite);
+    register_parser(suite);
+    register_vm(suite, "vm", 0);
+    if (JitCode::supported()) register_vm(suite, "jit", 1);
+    register_snapshot(suite);
+    register_string_utils(suite);
+    register_array(suite);
+    register_threading(suite);
+    register_graphics_math(suite);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "bench.hpp"
+#include "replit_core.hpp"
+#include <map>
+#include <sstream>
+
+// Finds frequent opcode sequences, the candidates for new
+// superinstructions. Static counts come from the compiled bytecode of each
+// script, dynamic pair counts from running it under the Profiler.
+//
+// Usage: replit_mine [--unfuse] [--run] [--top n] file.rpl...
+//   --unfuse  count existing superinstructions as OP_CONSTANT + operation
+//   --run     also execute the scripts and report executed pairs
+
+namespace {
+
+using replit::OpCode;
+
+std::vector<uint8_t> opcode_stream(const replit::Chunk& chunk, bool unfuse) {
+    std::vector<uint8_t> ops;
+    for (size_t pc = 0; pc < chunk.code.size(); pc += 1 + replit::opcode_operand_bytes(chunk.code[pc])) {
+        OpCode op = replit::generic_opcode(static_cast<OpCode>(chunk.code[pc]));
+        OpCode compare = replit::unbranched_opcode(op);
+        OpCode base = replit::unfused_opcode(compare);
+        if (unfuse && base != op) {
+            ops.push_back(static_cast<uint8_t>(OpCode::OP_CONSTANT));
+            ops.push_back(static_cast<uint8_t>(base));
+            if (compare != op) ops.push_back(static_cast<uint8_t>(OpCode::OP_JUMP_IF_FALSE));
+        } else {
+            ops.push_back(static_cast<uint8_t>(op));
+        }
+    }
+    return ops;
+}
+
+std::string sequence_name(const std::vector<uint8_t>& ops, size_t start, size_t length) {
+    std::string name;
+    for (size_t i = 0; i < length; ++i) {
+        if (i) name += " + ";
+        name += replit::opcode_name(ops[start + i]);
+    }
+    return name;
+}
+
+bool compile_file(const std::string& path, replit::Chunk& chunk) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Could not open " << path << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    
+    replit::Lexer lexer(buffer.str());
+    std::vector<replit::Token> tokens;
+    while (true) {
+        tokens.push_back(lexer.scan_token());
+        if (tokens.back().type == replit::TokenType::EOF_TOKEN) break;
+    }
+    replit::Parser parser;
+    if (!parser.compile(tokens, &chunk)) {
+        std::cerr << "Compile error in " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+template<typename Map>
+void print_top(const std::string& title, const Map& counts, size_t top) {
+    std::vector<std::pair<uint64_t, std::string>> sorted;
+    uint64_t total = 0;
+    for (const auto& entry : counts) {
+        sorted.push_back({entry.second, entry.first});
+        total += entry.second;
+    }
+    std::sort(sorted.rbegin(), sorted.rend());
+    
+    std::cout << title << std::endl;
+    for (size_t i = 0; i < sorted.size() && i < top; ++i) {
+        std::printf("  %10llu  %5.1f%%  %s\n", static_cast<unsigned long long>(sorted[i].first),
+                    total ? 100.0 * sorted[i].first / total : 0.0, sorted[i].second.c_str());
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    bool unfuse = false;
+    bool run = false;
+    size_t top = 15;
+    std::vector<std::string> files;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--unfuse") unfuse = true;
+        else if (arg == "--run") run = true;
+        else if (arg == "--top" && i + 1 < argc) top = std::max(1, std::atoi(argv[++i]));
+        else files.push_back(arg);
+    }
+    if (files.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--unfuse] [--run] [--top n] file.rpl..." << std::endl;
+        return 1;
+    }
+    
+    std::map<size_t, std::map<std::string, uint64_t>> static_counts;
+    std::map<std::string, uint64_t> dynamic_counts;
+    replit::Profiler profiler(0);
+    replit::NullBuffer sink;
+    
+    for (const auto& path : files) {
+        replit::Chunk chunk;
+        if (!compile_file(path, chunk)) return 1;
+        
+        std::vector<uint8_t> ops = opcode_stream(chunk, unfuse);
+        for (size_t length = 2; length <= 4; ++length) {
+            for (size_t start = 0; start + length <= ops.size(); ++start) {
+                static_counts[length][sequence_name(ops, start, length)]++;
+            }
+        }
+        
+        if (run) {
+            replit::VM vm;
+            vm.set_jit_threshold(0);
+            vm.set_profiler(&profiler);
+            std::streambuf* previous = std::cout.rdbuf(&sink);
+            vm.run(chunk);
+            std::cout.rdbuf(previous);
+        }
+    }
+    
+    for (auto& entry : static_counts) {
+        print_top("Static " + std::to_string(entry.first) + "-grams", entry.second, top);
+    }
+    
+    if (run) {
+        for (int first = 0; first < 256; ++first) {
+            for (int second = 0; second < 256; ++second) {
+                uint64_t count = profiler.pair_count(first, second);
+                if (!count) continue;
+                std::vector<uint8_t> pair = {static_cast<uint8_t>(first), static_cast<uint8_t>(second)};
+                dynamic_counts[sequence_name(pair, 0, 2)] += count;
+            }
+        }
+        print_top("Executed pairs", dynamic_counts, top);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,1157 @@
+#pragma once
+#include "standard_library.hpp"
+#include <charconv>
+#include <deque>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace replit {
+
+enum class ColumnType { INT64, DOUBLE, STRING };
+
+struct CsvOptions {
+    char delimiter = ',';
+    char quote = '"';
+    bool has_header = true;
+    size_t threads = 0;                    // 0 = hardware concurrency
+    size_t parallel_threshold = 4 << 20;   // inputs smaller than this are parsed on one thread
+};
+
+// One typed column. Only the vector matching `type` is populated.
+// String values are views into the source file (or the table's arena
+// for fields that needed unescaping).
+class CsvColumn {
+public:
+    std::string name;
+    ColumnType type = ColumnType::INT64;
+    std::vector<int64_t> ints;
+    std::vector<double> doubles;
+    std::vector<std::string_view> strings;
+
+    size_t size() const {
+        switch (type) {
+            case ColumnType::INT64: return ints.size();
+            case ColumnType::DOUBLE: return doubles.size();
+            default: return strings.size();
+        }
+    }
+};
+
+// Move-only: string columns view the table's own arenas, which a copy
+// would share without keeping alive. Moving keeps every view valid.
+class CsvTable {
+public:
+    std::vector<CsvColumn> columns;
+    size_t row_count = 0;
+
+    CsvTable() = default;
+    CsvTable(const CsvTable&) = delete;
+    CsvTable& operator=(const CsvTable&) = delete;
+    CsvTable(CsvTable&&) = default;
+    CsvTable& operator=(CsvTable&&) = default;
+
+    int column_index(const std::string& name) const {
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (columns[i].name == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    const CsvColumn& column(const std::string& name) const {
+        int index = column_index(name);
+        if (index < 0) throw std::runtime_error("Unknown column: " + name);
+        return columns[index];
+    }
+
+private:
+    friend class CsvReader;
+    std::shared_ptr<MappedFile> source;
+    std::vector<std::deque<std::string>> arenas;
+};
+
+// Columnar CSV loader. Files are mapped, split into row-aligned chunks
+// and parsed in two passes (type inference, then conversion straight
+// into the column buffers), each pass running one thread per chunk.
+class CsvReader {
+public:
+    static CsvTable read_file(const std::string& path, const CsvOptions& options = CsvOptions()) {
+        auto mapping = std::make_shared<MappedFile>(path);
+        CsvTable table = parse(mapping->view(), options);
+        table.source = mapping;
+        return table;
+    }
+
+    // String columns reference `text`, which must outlive the table.
+    static CsvTable parse(std::string_view text, const CsvOptions& options = CsvOptions()) {
+        CsvTable table;
+        const char* begin = text.data();
+        const char* end = begin + text.size();
+
+        // Header (or first row) fixes the column count
+        std::vector<std::string> header;
+        std::deque<std::string> header_arena;
+        const char* data = parse_rows(begin, end, options, &header_arena, 1,
+            [&](size_t, std::string_view field) { header.emplace_back(field); },
+            [](size_t) {});
+
+        if (header.empty()) return table;
+        if (!options.has_header) {
+            for (size_t i = 0; i < header.size(); ++i) header[i] = "col_" + std::to_string(i);
+            data = begin;
+        }
+
+        size_t column_count = header.size();
+        std::vector<Chunk> chunks = split_chunks(data, end, options);
+
+        // Pass 1: count rows and infer column types per chunk
+        run_parallel(chunks.size(), [&](size_t c) {
+            Chunk& chunk = chunks[c];
+            chunk.stats.assign(column_count, ColumnStats());
+            chunk.rows = 0;
+            parse_rows(chunk.begin, chunk.end, options, nullptr, SIZE_MAX,
+                [&](size_t col, std::string_view field) {
+                    if (col < column_count) chunk.stats[col].observe(field);
+                },
+                [&](size_t fields) {
+                    for (size_t col = fields; col < column_count; ++col) chunk.stats[col].has_empty = true;
+                    chunk.rows++;
+                });
+        });
+
+        std::vector<size_t> offsets(chunks.size() + 1, 0);
+        for (size_t c = 0; c < chunks.size(); ++c) offsets[c + 1] = offsets[c] + chunks[c].rows;
+        table.row_count = offsets.back();
+
+        table.columns.resize(column_count);
+        for (size_t col = 0; col < column_count; ++col) {
+            ColumnStats merged;
+            for (const auto& chunk : chunks) merged.merge(chunk.stats[col]);
+
+            CsvColumn& column = table.columns[col];
+            column.name = header[col];
+            column.type = merged.type();
+            switch (column.type) {
+                case ColumnType::INT64: column.ints.resize(table.row_count); break;
+                case ColumnType::DOUBLE: column.doubles.resize(table.row_count); break;
+                case ColumnType::STRING: column.strings.resize(table.row_count); break;
+            }
+        }
+
+        // Pass 2: convert fields into their final slots
+        table.arenas.resize(chunks.size());
+        run_parallel(chunks.size(), [&](size_t c) {
+            size_t row = offsets[c];
+            parse_rows(chunks[c].begin, chunks[c].end, options, &table.arenas[c], SIZE_MAX,
+                [&](size_t col, std::string_view field) {
+                    if (col < column_count) store(table.columns[col], row, field);
+                },
+                [&](size_t fields) {
+                    for (size_t col = fields; col < column_count; ++col) {
+                        store(table.columns[col], row, std::string_view());
+                    }
+                    row++;
+                });
+        });
+
+        return table;
+    }
+
+private:
+    struct ColumnStats {
+        bool can_int = true;
+        bool can_double = true;
+        bool has_empty = false;
+
+        void observe(std::string_view field) {
+            if (field.empty()) {
+                has_empty = true;
+                return;
+            }
+            const char* first = field.data();
+            const char* last = first + field.size();
+            if (can_int) {
+                int64_t value;
+                auto result = std::from_chars(first, last, value);
+                if (result.ec == std::errc() && result.ptr == last) return;
+                can_int = false;
+            }
+            if (can_double) {
+                double value;
+                auto result = std::from_chars(first, last, value);
+                can_double = result.ec == std::errc() && result.ptr == last;
+            }
+        }
+
+        void merge(const ColumnStats& other) {
+            can_int = can_int && other.can_int;
+            can_double = can_double && other.can_double;
+            has_empty = has_empty || other.has_empty;
+        }
+
+        // Empty fields become NaN, so they demote integer columns to double
+        ColumnType type() const {
+            if (can_int && !has_empty) return ColumnType::INT64;
+            if (can_double) return ColumnType::DOUBLE;
+            return ColumnType::STRING;
+        }
+    };
+
+    struct Chunk {
+        const char* begin;
+        const char* end;
+        size_t rows = 0;
+        std::vector<ColumnStats> stats;
+    };
+
+    static void store(CsvColumn& column, size_t row, std::string_view field) {
+        const char* first = field.data();
+        const char* last = first + field.size();
+        switch (column.type) {
+            case ColumnType::INT64:
+                std::from_chars(first, last, column.ints[row]);
+                break;
+            case ColumnType::DOUBLE:
+                if (field.empty() || std::from_chars(first, last, column.doubles[row]).ec != std::errc()) {
+                    column.doubles[row] = std::numeric_limits<double>::quiet_NaN();
+                }
+                break;
+            case ColumnType::STRING:
+                column.strings[row] = field;
+                break;
+        }
+    }
+
+    // First occurrence of either byte, 32/16 bytes per step where available
+    static const char* find_either(const char* p, const char* end, char a, char b) {
+#if defined(__AVX2__)
+        const __m256i va = _mm256_set1_epi8(a);
+        const __m256i vb = _mm256_set1_epi8(b);
+        while (end - p >= 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+                _mm256_or_si256(_mm256_cmpeq_epi8(block, va), _mm256_cmpeq_epi8(block, vb))));
+            if (mask) return p + __builtin_ctz(mask);
+            p += 32;
+        }
+#endif
+#if defined(__SSE2__)
+        const __m128i sa = _mm_set1_epi8(a);
+        const __m128i sb = _mm_set1_epi8(b);
+        while (end - p >= 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            int mask = _mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(block, sa), _mm_cmpeq_epi8(block, sb)));
+            if (mask) return p + __builtin_ctz(mask);
+            p += 16;
+        }
+#endif
+        while (p < end && *p != a && *p != b) p++;
+        return p;
+    }
+
+    static size_t count_byte(const char* p, const char* end, char c) {
+        size_t count = 0;
+#if defined(__SSE2__)
+        const __m128i vc = _mm_set1_epi8(c);
+        while (end - p >= 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(block, vc)));
+            p += 16;
+        }
+#endif
+        while (p < end) count += (*p++ == c);
+        return count;
+    }
+
+    // Tokenizes up to max_rows records, calling on_field(column, value) for
+    // each field and on_row(field_count) after each record. Returns the
+    // position after the last consumed record.
+    template<typename FieldFn, typename RowFn>
+    static const char* parse_rows(const char* p, const char* end, const CsvOptions& options,
+                                  std::deque<std::string>* arena, size_t max_rows,
+                                  FieldFn&& on_field, RowFn&& on_row) {
+        const char delimiter = options.delimiter;
+        const char quote = options.quote;
+
+        for (size_t rows = 0; rows < max_rows && p < end; ) {
+            // Blank lines are not records
+            if (*p == '\n') { p++; continue; }
+            if (*p == '\r' && p + 1 < end && p[1] == '\n') { p += 2; continue; }
+
+            size_t column = 0;
+            while (true) {
+                std::string_view field;
+                if (*p == quote) {
+                    const char* start = ++p;
+                    bool escaped = false;
+                    while (true) {
+                        const char* q = static_cast<const char*>(std::memchr(p, quote, end - p));
+                        if (!q) {
+                            field = std::string_view(start, end - start);
+                            p = end;
+                            break;
+                        }
+                        if (q + 1 < end && q[1] == quote) {
+                            escaped = true;
+                            p = q + 2;
+                            continue;
+                        }
+                        field = std::string_view(start, q - start);
+                        p = q + 1;
+                        break;
+                    }
+                    if (escaped && arena) field = unescape(field, quote, *arena);
+                    p = find_either(p, end, delimiter, '\n');
+                } else {
+                    const char* q = find_either(p, end, delimiter, '\n');
+                    field = std::string_view(p, q - p);
+                    if (q == end || *q == '\n') {
+                        if (!field.empty() && field.back() == '\r') field.remove_suffix(1);
+                    }
+                    p = q;
+                }
+
+                on_field(column++, field);
+
+                if (p < end && *p == delimiter) {
+                    p++;
+                    if (p == end || *p == '\n') {
+                        on_field(column++, std::string_view());
+                        if (p < end) p++;
+                        break;
+                    }
+                    continue;
+                }
+                if (p < end) p++; // newline
+                break;
+            }
+
+            on_row(column);
+            rows++;
+        }
+        return p;
+    }
+
+    static std::string_view unescape(std::string_view field, char quote, std::deque<std::string>& arena) {
+        std::string value;
+        value.reserve(field.size());
+        for (size_t i = 0; i < field.size(); ++i) {
+            value += field[i];
+            if (field[i] == quote && i + 1 < field.size() && field[i + 1] == quote) i++;
+        }
+        arena.push_back(std::move(value));
+        return arena.back();
+    }
+
+    // Splits [begin, end) at record boundaries. Quote parity at each raw
+    // split point is recovered from per-slice quote counts, so a newline
+    // inside a quoted field is never mistaken for a record end.
+    static std::vector<Chunk> split_chunks(const char* begin, const char* end, const CsvOptions& options) {
+        size_t size = static_cast<size_t>(end - begin);
+        size_t threads = options.threads ? options.threads
+                                         : std::max(1u, std::thread::hardware_concurrency());
+        if (size < options.parallel_threshold || threads <= 1) {
+            return {Chunk{begin, end}};
+        }
+
+        std::vector<const char*> raw(threads + 1);
+        for (size_t i = 0; i <= threads; ++i) raw[i] = begin + size * i / threads;
+
+        std::vector<size_t> quotes(threads);
+        run_parallel(threads, [&](size_t i) {
+            quotes[i] = count_byte(raw[i], raw[i + 1], options.quote);
+        });
+
+        std::vector<const char*> cuts{begin};
+        bool in_quote = false;
+        for (size_t i = 1; i < threads; ++i) {
+            in_quote ^= (quotes[i - 1] & 1) != 0;
+            bool quoted = in_quote;
+            const char* p = raw[i];
+            while (p < end) {
+                if (*p == options.quote) quoted = !quoted;
+                else if (*p == '\n' && !quoted) { p++; break; }
+                p++;
+            }
+            if (p > cuts.back()) cuts.push_back(p);
+        }
+        cuts.push_back(end);
+
+        std::vector<Chunk> chunks;
+        for (size_t i = 0; i + 1 < cuts.size(); ++i) {
+            if (cuts[i] < cuts[i + 1]) chunks.push_back(Chunk{cuts[i], cuts[i + 1]});
+        }
+        if (chunks.empty()) chunks.push_back(Chunk{end, end});
+        return chunks;
+    }
+
+    template<typename F>
+    static void run_parallel(size_t count, F&& fn) {
+        if (count == 1) {
+            fn(0);
+            return;
+        }
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < count; ++i) {
+            threads.emplace_back([&fn, i]() { fn(i); });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+};
+
+
+// Packed bit vector used for null bitmaps and filter masks
+class Bitmap {
+public:
+    std::vector<uint64_t> words;
+    size_t bits = 0;
+    
+    Bitmap() = default;
+    explicit Bitmap(size_t size, bool value = false)
+        : words((size + 63) / 64, value ? ~uint64_t(0) : 0), bits(size) {
+        trim();
+    }
+    
+    bool get(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    
+    void set(size_t i, bool value) {
+        uint64_t bit = uint64_t(1) << (i & 63);
+        if (value) words[i >> 6] |= bit;
+        else words[i >> 6] &= ~bit;
+    }
+    
+    size_t count() const {
+        size_t total = 0;
+        for (uint64_t word : words) total += __builtin_popcountll(word);
+        return total;
+    }
+    
+    Bitmap operator&(const Bitmap& other) const {
+        Bitmap result(*this);
+        for (size_t i = 0; i < words.size(); ++i) result.words[i] &= other.words[i];
+        return result;
+    }
+    
+    Bitmap operator|(const Bitmap& other) const {
+        Bitmap result(*this);
+        for (size_t i = 0; i < words.size(); ++i) result.words[i] |= other.words[i];
+        return result;
+    }
+    
+    Bitmap operator~() const {
+        Bitmap result(*this);
+        for (auto& word : result.words) word = ~word;
+        result.trim();
+        return result;
+    }
+    
+    std::vector<size_t> indices() const {
+        std::vector<size_t> result;
+        result.reserve(count());
+        for (size_t w = 0; w < words.size(); ++w) {
+            for (uint64_t word = words[w]; word; word &= word - 1) {
+                result.push_back(w * 64 + __builtin_ctzll(word));
+            }
+        }
+        return result;
+    }
+    
+private:
+    void trim() {
+        if (bits % 64 && !words.empty()) words.back() &= (uint64_t(1) << (bits % 64)) - 1;
+    }
+};
+
+enum class Compare { EQUAL, NOT_EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL };
+enum class Aggregate { SUM, MEAN, MIN, MAX, COUNT };
+
+// Contiguous typed column with an optional null bitmap. An empty
+// `validity` means every row is valid.
+class DataColumn {
+public:
+    std::string name;
+    ColumnType type = ColumnType::DOUBLE;
+    std::vector<int64_t> ints;
+    std::vector<double> doubles;
+    std::vector<std::string> strings;
+    Bitmap validity;
+    
+    DataColumn() = default;
+    DataColumn(const std::string& name, std::vector<int64_t> values)
+        : name(name), type(ColumnType::INT64), ints(std::move(values)) {}
+    DataColumn(const std::string& name, std::vector<double> values)
+        : name(name), type(ColumnType::DOUBLE), doubles(std::move(values)) {}
+    DataColumn(const std::string& name, std::vector<std::string> values)
+        : name(name), type(ColumnType::STRING), strings(std::move(values)) {}
+    
+    size_t size() const {
+        switch (type) {
+            case ColumnType::INT64: return ints.size();
+            case ColumnType::DOUBLE: return doubles.size();
+            default: return strings.size();
+        }
+    }
+    
+    bool is_numeric() const { return type != ColumnType::STRING; }
+    bool has_nulls() const { return !validity.words.empty(); }
+    bool is_valid(size_t row) const { return !has_nulls() || validity.get(row); }
+    
+    void set_null(size_t row) {
+        if (!has_nulls()) validity = Bitmap(size(), true);
+        validity.set(row, false);
+    }
+    
+    size_t null_count() const { return has_nulls() ? size() - validity.count() : 0; }
+    
+    double number(size_t row) const {
+        return type == ColumnType::INT64 ? static_cast<double>(ints[row]) : doubles[row];
+    }
+    
+    // Gathers the given rows into a new column
+    DataColumn take(const std::vector<size_t>& rows) const {
+        DataColumn result;
+        result.name = name;
+        result.type = type;
+        switch (type) {
+            case ColumnType::INT64: gather(ints, rows, result.ints); break;
+            case ColumnType::DOUBLE: gather(doubles, rows, result.doubles); break;
+            case ColumnType::STRING: gather(strings, rows, result.strings); break;
+        }
+        if (has_nulls()) {
+            result.validity = Bitmap(rows.size());
+            for (size_t i = 0; i < rows.size(); ++i) result.validity.set(i, validity.get(rows[i]));
+        }
+        return result;
+    }
+    
+private:
+    template<typename T>
+    static void gather(const std::vector<T>& source, const std::vector<size_t>& rows, std::vector<T>& out) {
+        out.resize(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) out[i] = source[rows[i]];
+    }
+};
+
+// Columnar table with vectorizable filter/aggregate/group-by/join kernels.
+// Kernels run over the contiguous column arrays and produce bitmaps or
+// row index lists; rows are only materialized by take().
+class DataFrame {
+public:
+    std::vector<DataColumn> columns;
+    
+    DataFrame() = default;
+    
+    static DataFrame from_csv(const CsvTable& table) {
+        DataFrame frame;
+        for (const auto& source : table.columns) {
+            DataColumn column;
+            column.name = source.name;
+            column.type = source.type;
+            switch (source.type) {
+                case ColumnType::INT64:
+                    column.ints = source.ints;
+                    break;
+                case ColumnType::DOUBLE:
+                    column.doubles = source.doubles;
+                    for (size_t i = 0; i < column.doubles.size(); ++i) {
+                        if (std::isnan(column.doubles[i])) column.set_null(i);
+                    }
+                    break;
+                case ColumnType::STRING:
+                    column.strings.assign(source.strings.begin(), source.strings.end());
+                    break;
+            }
+            frame.columns.push_back(std::move(column));
+        }
+        return frame;
+    }
+    
+    static DataFrame read_csv(const std::string& path, const CsvOptions& options = CsvOptions()) {
+        return from_csv(CsvReader::read_file(path, options));
+    }
+    
+    size_t row_count() const { return columns.empty() ? 0 : columns[0].size(); }
+    size_t column_count() const { return columns.size(); }
+    
+    void add_column(DataColumn column) {
+        if (!columns.empty() && column.size() != row_count()) {
+            throw std::runtime_error("Column length must match row count: " + column.name);
+        }
+        columns.push_back(std::move(column));
+    }
+    
+    int column_index(const std::string& name) const {
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (columns[i].name == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+    
+    const DataColumn& column(const std::string& name) const {
+        int index = column_index(name);
+        if (index < 0) throw std::runtime_error("Unknown column: " + name);
+        return columns[index];
+    }
+    
+    // Null rows never match
+    Bitmap compare(const std::string& name, Compare op, double value) const {
+        const DataColumn& col = column(name);
+        if (!col.is_numeric()) throw std::runtime_error("Column is not numeric: " + name);
+        
+        Bitmap mask = col.type == ColumnType::INT64
+            ? compare_values(col.ints.data(), col.size(), op, value)
+            : compare_values(col.doubles.data(), col.size(), op, value);
+        return col.has_nulls() ? mask & col.validity : mask;
+    }
+    
+    Bitmap compare(const std::string& name, Compare op, const std::string& value) const {
+        const DataColumn& col = column(name);
+        if (col.is_numeric()) throw std::runtime_error("Column is not a string column: " + name);
+        if (op != Compare::EQUAL && op != Compare::NOT_EQUAL) {
+            throw std::runtime_error("Only equality comparisons are supported on strings");
+        }
+        
+        Bitmap mask(col.size());
+        bool want = op == Compare::EQUAL;
+        for (size_t i = 0; i < col.size(); ++i) {
+            if ((col.strings[i] == value) == want) mask.set(i, true);
+        }
+        return col.has_nulls() ? mask & col.validity : mask;
+    }
+    
+    DataFrame filter(const Bitmap& mask) const {
+        if (mask.bits != row_count()) throw std::runtime_error("Filter mask length must match row count");
+        return take(mask.indices());
+    }
+    
+    DataFrame take(const std::vector<size_t>& rows) const {
+        DataFrame result;
+        for (const auto& col : columns) result.columns.push_back(col.take(rows));
+        return result;
+    }
+    
+    double aggregate(const std::string& name, Aggregate op) const {
+        const DataColumn& col = column(name);
+        if (op == Aggregate::COUNT) return static_cast<double>(col.size() - col.null_count());
+        if (!col.is_numeric()) throw std::runtime_error("Column is not numeric: " + name);
+        
+        return col.type == ColumnType::INT64
+            ? reduce(col.ints.data(), col.size(), col, op)
+            : reduce(col.doubles.data(), col.size(), col, op);
+    }
+    
+    double sum(const std::string& name) const { return aggregate(name, Aggregate::SUM); }
+    double mean(const std::string& name) const { return aggregate(name, Aggregate::MEAN); }
+    double min(const std::string& name) const { return aggregate(name, Aggregate::MIN); }
+    double max(const std::string& name) const { return aggregate(name, Aggregate::MAX); }
+    
+    // One output row per distinct key; each (column, op) pair becomes a
+    // double column named "<column>_<op>". Rows with a null key are dropped.
+    DataFrame group_by(const std::string& key,
+                       const std::vector<std::pair<std::string, Aggregate>>& aggregations) const {
+        const DataColumn& key_col = column(key);
+        std::vector<size_t> first_rows;
+        std::vector<uint32_t> groups = group_ids(key_col, first_rows);
+        size_t group_count = first_rows.size();
+        
+        DataFrame result;
+        result.columns.push_back(key_col.take(first_rows));
+        
+        for (const auto& [name, op] : aggregations) {
+            const DataColumn& col = column(name);
+            if (op != Aggregate::COUNT && !col.is_numeric()) {
+                throw std::runtime_error("Column is not numeric: " + name);
+            }
+            
+            std::vector<double> acc(group_count, op == Aggregate::MIN ? INFINITY
+                                               : op == Aggregate::MAX ? -INFINITY : 0.0);
+            std::vector<double> counts(group_count, 0.0);
+            for (size_t row = 0; row < groups.size(); ++row) {
+                uint32_t g = groups[row];
+                if (g == NO_GROUP || !col.is_valid(row)) continue;
+                counts[g] += 1;
+                if (op == Aggregate::COUNT) continue;
+                double v = col.number(row);
+                switch (op) {
+                    case Aggregate::MIN: acc[g] = std::min(acc[g], v); break;
+                    case Aggregate::MAX: acc[g] = std::max(acc[g], v); break;
+                    default: acc[g] += v; break;
+                }
+            }
+            
+            DataColumn out(name + "_" + aggregate_name(op), std::vector<double>(group_count));
+            for (size_t g = 0; g < group_count; ++g) {
+                if (op == Aggregate::COUNT) out.doubles[g] = counts[g];
+                else if (counts[g] == 0) { out.doubles[g] = NAN; out.set_null(g); }
+                else if (op == Aggregate::MEAN) out.doubles[g] = acc[g] / counts[g];
+                else out.doubles[g] = acc[g];
+            }
+            result.columns.push_back(std::move(out));
+        }
+        return result;
+    }
+    
+    // Inner hash join; the smaller side is not chosen automatically, so
+    // pass the smaller frame as `right` (it is the one that gets hashed).
+    DataFrame join(const DataFrame& right, const std::string& left_key, const std::string& right_key) const {
+        const DataColumn& lk = column(left_key);
+        const DataColumn& rk = right.column(right_key);
+        if (lk.is_numeric() != rk.is_numeric()) {
+            throw std::runtime_error("Join keys must have compatible types");
+        }
+        
+        std::vector<size_t> left_rows;
+        std::vector<size_t> right_rows;
+        if (lk.is_numeric()) {
+            hash_join(lk, rk, [](const DataColumn& c, size_t i) { return c.number(i); }, left_rows, right_rows);
+        } else {
+            hash_join(lk, rk, [](const DataColumn& c, size_t i) -> const std::string& { return c.strings[i]; },
+                      left_rows, right_rows);
+        }
+        
+        DataFrame result = take(left_rows);
+        for (const auto& col : right.columns) {
+            if (col.name == right_key) continue;
+            DataColumn taken = col.take(right_rows);
+            if (result.column_index(taken.name) >= 0) taken.name += "_right";
+            result.columns.push_back(std::move(taken));
+        }
+        return result;
+    }
+    
+private:
+    static constexpr uint32_t NO_GROUP = UINT32_MAX;
+    
+    static const char* aggregate_name(Aggregate op) {
+        switch (op) {
+            case Aggregate::SUM: return "sum";
+            case Aggregate::MEAN: return "mean";
+            case Aggregate::MIN: return "min";
+            case Aggregate::MAX: return "max";
+            default: return "count";
+        }
+    }
+    
+    template<typename T>
+    static Bitmap compare_values(const T* data, size_t n, Compare op, double value) {
+        switch (op) {
+            case Compare::EQUAL: return build_mask(data, n, [value](double x) { return x == value; });
+            case Compare::NOT_EQUAL: return build_mask(data, n, [value](double x) { return x != value; });
+            case Compare::LESS: return build_mask(data, n, [value](double x) { return x < value; });
+            case Compare::LESS_EQUAL: return build_mask(data, n, [value](double x) { return x <= value; });
+            case Compare::GREATER: return build_mask(data, n, [value](double x) { return x > value; });
+            default: return build_mask(data, n, [value](double x) { return x >= value; });
+        }
+    }
+    
+    // Branch-free inner loop over 64-row blocks so the compiler can vectorize it
+    template<typename T, typename Pred>
+    static Bitmap build_mask(const T* data, size_t n, Pred pred) {
+        Bitmap mask(n);
+        for (size_t w = 0; w < mask.words.size(); ++w) {
+            size_t base = w * 64;
+            size_t limit = std::min<size_t>(64, n - base);
+            uint64_t word = 0;
+            for (size_t j = 0; j < limit; ++j) {
+                word |= uint64_t(pred(static_cast<double>(data[base + j]))) << j;
+            }
+            mask.words[w] = word;
+        }
+        return mask;
+    }
+    
+    template<typename T>
+    static double reduce(const T* data, size_t n, const DataColumn& col, Aggregate op) {
+        // Four independent accumulators break the loop-carried dependency
+        double acc[4] = {0, 0, 0, 0};
+        if (op == Aggregate::MIN) std::fill(acc, acc + 4, INFINITY);
+        if (op == Aggregate::MAX) std::fill(acc, acc + 4, -INFINITY);
+        size_t count = col.size() - col.null_count();
+        
+        auto step = [op](double a, double v) {
+            switch (op) {
+                case Aggregate::MIN: return std::min(a, v);
+                case Aggregate::MAX: return std::max(a, v);
+                default: return a + v;
+            }
+        };
+        
+        if (!col.has_nulls()) {
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                for (int k = 0; k < 4; ++k) acc[k] = step(acc[k], static_cast<double>(data[i + k]));
+            }
+            for (; i < n; ++i) acc[0] = step(acc[0], static_cast<double>(data[i]));
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                if (col.validity.get(i)) acc[i & 3] = step(acc[i & 3], static_cast<double>(data[i]));
+            }
+        }
+        
+        double total = step(step(acc[0], acc[1]), step(acc[2], acc[3]));
+        if (count == 0) return op == Aggregate::SUM ? 0.0 : NAN;
+        if (op == Aggregate::MEAN) return total / static_cast<double>(count);
+        return total;
+    }
+    
+    static std::vector<uint32_t> group_ids(const DataColumn& key, std::vector<size_t>& first_rows) {
+        std::vector<uint32_t> groups(key.size(), NO_GROUP);
+        auto assign = [&](auto&& value_at, auto& index) {
+            for (size_t row = 0; row < key.size(); ++row) {
+                if (!key.is_valid(row)) continue;
+                auto [it, inserted] = index.try_emplace(value_at(row), static_cast<uint32_t>(first_rows.size()));
+                if (inserted) first_rows.push_back(row);
+                groups[row] = it->second;
+            }
+        };
+        
+        switch (key.type) {
+            case ColumnType::INT64: {
+                std::unordered_map<int64_t, uint32_t> index;
+                assign([&](size_t r) { return key.ints[r]; }, index);
+                break;
+            }
+            case ColumnType::DOUBLE: {
+                std::unordered_map<double, uint32_t> index;
+                assign([&](size_t r) { return key.doubles[r]; }, index);
+                break;
+            }
+            case ColumnType::STRING: {
+                std::unordered_map<std::string_view, uint32_t> index;
+                assign([&](size_t r) { return std::string_view(key.strings[r]); }, index);
+                break;
+            }
+        }
+        return groups;
+    }
+    
+    template<typename KeyFn>
+    static void hash_join(const DataColumn& left, const DataColumn& right, KeyFn key_of,
+                          std::vector<size_t>& left_rows, std::vector<size_t>& right_rows) {
+        using Key = std::decay_t<decltype(key_of(right, 0))>;
+        std::unordered_multimap<Key, size_t> index;
+        index.reserve(right.size());
+        for (size_t row = 0; row < right.size(); ++row) {
+            if (right.is_valid(row)) index.emplace(key_of(right, row), row);
+        }
+        
+        for (size_t row = 0; row < left.size(); ++row) {
+            if (!left.is_valid(row)) continue;
+            auto range = index.equal_range(key_of(left, row));
+            for (auto it = range.first; it != range.second; ++it) {
+                left_rows.push_back(row);
+                right_rows.push_back(it->second);
+            }
+        }
+    }
+};
+
+// Dense row-major matrix of doubles. Vectors are 1xN or Nx1 matrices.
+// C++ API only for now: Value can hold a Matrix, but no builtin or opcode
+// creates one from a script yet; that binding is deferred.
+class Matrix {
+private:
+    size_t row_count = 0;
+    size_t col_count = 0;
+    std::vector<double> values;
+    
+public:
+    Matrix() = default;
+    Matrix(size_t rows, size_t cols, double fill = 0.0)
+        : row_count(rows), col_count(cols), values(rows * cols, fill) {}
+    
+    static Matrix identity(size_t size) {
+        Matrix result(size, size);
+        for (size_t i = 0; i < size; ++i) result(i, i) = 1.0;
+        return result;
+    }
+    
+    static Matrix from_rows(const std::vector<std::vector<double>>& rows) {
+        if (rows.empty()) return Matrix();
+        Matrix result(rows.size(), rows[0].size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (rows[i].size() != result.col_count) {
+                throw std::runtime_error("All rows must have the same length");
+            }
+            std::copy(rows[i].begin(), rows[i].end(), result.row(i));
+        }
+        return result;
+    }
+    
+    static Matrix column_vector(const std::vector<double>& data) {
+        Matrix result(data.size(), 1);
+        std::copy(data.begin(), data.end(), result.values.begin());
+        return result;
+    }
+    
+    // Numeric DataFrame columns become matrix columns; nulls become NaN
+    static Matrix from_frame(const DataFrame& frame, const std::vector<std::string>& names) {
+        Matrix result(frame.row_count(), names.size());
+        for (size_t j = 0; j < names.size(); ++j) {
+            const DataColumn& col = frame.column(names[j]);
+            if (!col.is_numeric()) throw std::runtime_error("Column is not numeric: " + names[j]);
+            for (size_t i = 0; i < result.row_count; ++i) {
+                result(i, j) = col.is_valid(i) ? col.number(i) : NAN;
+            }
+        }
+        return result;
+    }
+    
+    size_t rows() const { return row_count; }
+    size_t cols() const { return col_count; }
+    size_t size() const { return values.size(); }
+    double* data() { return values.data(); }
+    const double* data() const { return values.data(); }
+    double* row(size_t i) { return values.data() + i * col_count; }
+    const double* row(size_t i) const { return values.data() + i * col_count; }
+    
+    double& operator()(size_t i, size_t j) { return values[i * col_count + j]; }
+    double operator()(size_t i, size_t j) const { return values[i * col_count + j]; }
+    
+    // Blocked so that both the source and destination tiles stay in cache
+    Matrix transpose() const {
+        constexpr size_t TILE = 32;
+        Matrix result(col_count, row_count);
+        for (size_t ii = 0; ii < row_count; ii += TILE) {
+            for (size_t jj = 0; jj < col_count; jj += TILE) {
+                size_t i_end = std::min(ii + TILE, row_count);
+                size_t j_end = std::min(jj + TILE, col_count);
+                for (size_t i = ii; i < i_end; ++i) {
+                    for (size_t j = jj; j < j_end; ++j) {
+                        result.values[j * row_count + i] = values[i * col_count + j];
+                    }
+                }
+            }
+        }
+        return result;
+    }
+    
+    Matrix multiply(const Matrix& other) const {
+        if (col_count != other.row_count) {
+            throw std::runtime_error("Matrix dimensions do not match for multiplication");
+        }
+        
+        Matrix result(row_count, other.col_count);
+        size_t work = row_count * col_count * other.col_count;
+        size_t bands = work < PARALLEL_WORK ? 1
+                     : std::min<size_t>(row_count, std::max(1u, std::thread::hardware_concurrency()));
+        
+        auto band = [&](size_t b) {
+            size_t begin = row_count * b / bands;
+            size_t end = row_count * (b + 1) / bands;
+            multiply_rows(other, result, begin, end);
+        };
+        
+        // One thread per band; the caller takes the first
+        std::vector<std::thread> threads;
+        for (size_t b = 1; b < bands; ++b) threads.emplace_back(band, b);
+        band(0);
+        for (auto& thread : threads) thread.join();
+        return result;
+    }
+    
+    Matrix operator*(const Matrix& other) const { return multiply(other); }
+    Matrix operator+(const Matrix& other) const { return zip(other, [](double a, double b) { return a + b; }); }
+    Matrix operator-(const Matrix& other) const { return zip(other, [](double a, double b) { return a - b; }); }
+    Matrix hadamard(const Matrix& other) const { return zip(other, [](double a, double b) { return a * b; }); }
+    
+    Matrix operator*(double scalar) const {
+        Matrix result(*this);
+        for (double& v : result.values) v *= scalar;
+        return result;
+    }
+    
+    template<typename F>
+    Matrix apply(F&& fn) const {
+        Matrix result(*this);
+        for (double& v : result.values) v = fn(v);
+        return result;
+    }
+    
+    double sum() const {
+        double acc[4] = {0, 0, 0, 0};
+        size_t i = 0;
+        for (; i + 4 <= values.size(); i += 4) {
+            for (int k = 0; k < 4; ++k) acc[k] += values[i + k];
+        }
+        for (; i < values.size(); ++i) acc[0] += values[i];
+        return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    }
+    
+    double mean() const { return values.empty() ? NAN : sum() / static_cast<double>(values.size()); }
+    double min() const { return values.empty() ? NAN : *std::min_element(values.begin(), values.end()); }
+    double max() const { return values.empty() ? NAN : *std::max_element(values.begin(), values.end()); }
+    
+    double dot(const Matrix& other) const {
+        if (values.size() != other.values.size()) throw std::runtime_error("Vector lengths do not match");
+        double acc[4] = {0, 0, 0, 0};
+        size_t i = 0;
+        for (; i + 4 <= values.size(); i += 4) {
+            for (int k = 0; k < 4; ++k) acc[k] += values[i + k] * other.values[i + k];
+        }
+        for (; i < values.size(); ++i) acc[0] += values[i] * other.values[i];
+        return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    }
+    
+    double norm() const { return std::sqrt(dot(*this)); }
+    
+    // 1 x cols row of column sums
+    Matrix sum_rows() const {
+        Matrix result(1, col_count);
+        for (size_t i = 0; i < row_count; ++i) axpy(result.data(), row(i), 1.0, col_count);
+        return result;
+    }
+    
+    // rows x 1 column of row sums
+    Matrix sum_cols() const {
+        Matrix result(row_count, 1);
+        for (size_t i = 0; i < row_count; ++i) {
+            const double* r = row(i);
+            double total = 0;
+            for (size_t j = 0; j < col_count; ++j) total += r[j];
+            result.values[i] = total;
+        }
+        return result;
+    }
+    
+    // Solves A x = b for symmetric positive definite A via Cholesky
+    static Matrix solve_spd(const Matrix& a, const Matrix& b) {
+        size_t n = a.row_count;
+        if (a.col_count != n || b.row_count != n) throw std::runtime_error("Matrix dimensions do not match for solve");
+        
+        Matrix l(n, n);
+        for (size_t j = 0; j < n; ++j) {
+            double d = a(j, j);
+            for (size_t k = 0; k < j; ++k) d -= l(j, k) * l(j, k);
+            if (d <= 0) throw std::runtime_error("Matrix is not positive definite");
+            l(j, j) = std::sqrt(d);
+            for (size_t i = j + 1; i < n; ++i) {
+                double s = a(i, j);
+                for (size_t k = 0; k < j; ++k) s -= l(i, k) * l(j, k);
+                l(i, j) = s / l(j, j);
+            }
+        }
+        
+        Matrix x(b);
+        for (size_t c = 0; c < b.col_count; ++c) {
+            for (size_t i = 0; i < n; ++i) {
+                double s = x(i, c);
+                for (size_t k = 0; k < i; ++k) s -= l(i, k) * x(k, c);
+                x(i, c) = s / l(i, i);
+            }
+            for (size_t i = n; i-- > 0; ) {
+                double s = x(i, c);
+                for (size_t k = i + 1; k < n; ++k) s -= l(k, i) * x(k, c);
+                x(i, c) = s / l(i, i);
+            }
+        }
+        return x;
+    }
+    
+private:
+    static constexpr size_t PARALLEL_WORK = 1 << 21;
+    static constexpr size_t BLOCK_K = 64;
+    static constexpr size_t BLOCK_J = 256;
+    
+    template<typename F>
+    Matrix zip(const Matrix& other, F&& fn) const {
+        if (row_count != other.row_count || col_count != other.col_count) {
+            throw std::runtime_error("Matrix dimensions do not match");
+        }
+        Matrix result(row_count, col_count);
+        for (size_t i = 0; i < values.size(); ++i) result.values[i] = fn(values[i], other.values[i]);
+        return result;
+    }
+    
+    // y += a * x
+    static void axpy(double* y, const double* x, double a, size_t n) {
+        size_t j = 0;
+#if defined(__AVX2__)
+        const __m256d va = _mm256_set1_pd(a);
+        for (; j + 4 <= n; j += 4) {
+            __m256d vy = _mm256_loadu_pd(y + j);
+            __m256d vx = _mm256_loadu_pd(x + j);
+#if defined(__FMA__)
+            _mm256_storeu_pd(y + j, _mm256_fmadd_pd(va, vx, vy));
+#else
+            _mm256_storeu_pd(y + j, _mm256_add_pd(vy, _mm256_mul_pd(va, vx)));
+#endif
+        }
+#elif defined(__SSE2__)
+        const __m128d va = _mm_set1_pd(a);
+        for (; j + 2 <= n; j += 2) {
+            __m128d vy = _mm_loadu_pd(y + j);
+            __m128d vx = _mm_loadu_pd(x + j);
+            _mm_storeu_pd(y + j, _mm_add_pd(vy, _mm_mul_pd(va, vx)));
+        }
+#endif
+        for (; j < n; ++j) y[j] += a * x[j];
+    }
+    
+    // i-k-j order over BLOCK_K x BLOCK_J panels of `other`, so the panel
+    // is reused from cache by every row in the band
+    void multiply_rows(const Matrix& other, Matrix& result, size_t begin, size_t end) const {
+        size_t n = other.col_count;
+        for (size_t kk = 0; kk < col_count; kk += BLOCK_K) {
+            size_t k_end = std::min(kk + BLOCK_K, col_count);
+            for (size_t jj = 0; jj < n; jj += BLOCK_J) {
+                size_t width = std::min(BLOCK_J, n - jj);
+                for (size_t i = begin; i < end; ++i) {
+                    double* c = result.row(i) + jj;
+                    const double* a = row(i);
+                    for (size_t k = kk; k < k_end; ++k) {
+                        axpy(c, other.row(k) + jj, a[k], width);
+                    }
+                }
+            }
+        }
+    }
+};
+
+// Ordinary least squares via the normal equations, with an intercept
+class LinearRegression {
+public:
+    Matrix coefficients;   // features x 1
+    double intercept = 0.0;
+    
+    void fit(const Matrix& x, const Matrix& y) {
+        if (x.rows() != y.rows() || y.cols() != 1) {
+            throw std::runtime_error("Target must be a column vector with one row per sample");
+        }
+        
+        // Center the data so the intercept drops out of the solve
+        Matrix x_mean = x.sum_rows() * (1.0 / static_cast<double>(x.rows()));
+        double y_mean = y.mean();
+        Matrix xc(x.rows(), x.cols());
+        Matrix yc(y.rows(), 1);
+        for (size_t i = 0; i < x.rows(); ++i) {
+            for (size_t j = 0; j < x.cols(); ++j) xc(i, j) = x(i, j) - x_mean(0, j);
+            yc(i, 0) = y(i, 0) - y_mean;
+        }
+        
+        Matrix xt = xc.transpose();
+        coefficients = Matrix::solve_spd(xt * xc, xt * yc);
+        intercept = y_mean - (x_mean * coefficients)(0, 0);
+    }
+    
+    Matrix predict(const Matrix& x) const {
+        Matrix result = x * coefficients;
+        for (size_t i = 0; i < result.rows(); ++i) result(i, 0) += intercept;
+        return result;
+    }
+    
+    double r_squared(const Matrix& x, const Matrix& y) const {
+        Matrix residual = y - predict(x);
+        double y_mean = y.mean();
+        double total = y.apply([y_mean](double v) { return (v - y_mean) * (v - y_mean); }).sum();
+        return 1.0 - residual.dot(residual) / total;
+    }
+};
+
+}
\ No newline at end of file
@@ -1,6 +1,21 @@
 #pragma once
 #include "replit_core.hpp"
 #include <cmath>
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <condition_variable>
+#include <map>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 namespace replit {
 
@@ -93,233 +108,3737 @@ public:
     }
 };
 
-// Sprite class for game objects
-class Sprite {
+// Persistent worker threads for per-frame parallel loops. run() hands out
+// task indices through an atomic counter and the calling thread joins in,
+// so there is no thread creation on the frame path.
+class WorkerPool {
 public:
-    Vector2D position;
-    Vector2D velocity;
-    Vector2D scale;
-    float rotation;
-    Color tint;
-    Rectangle bounds;
-    std::string texture_path;
-    bool visible;
-    int layer;
-    
-    Sprite(const std::string& texture = "", float x = 0, float y = 0)
-        : position(x, y), velocity(0, 0), scale(1, 1), rotation(0),
-          tint(Color::WHITE()), texture_path(texture), visible(true), layer(0) {
-        update_bounds();
+    explicit WorkerPool(size_t threads = 0) {
+        size_t count = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 1; i < count; ++i) {
+            workers.emplace_back([this]() { worker_loop(); });
+        }
     }
     
-    void update(float delta_time) {
-        position = position + velocity * delta_time;
-        update_bounds();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
     }
     
-    void update_bounds() {
-        bounds = Rectangle(position.x, position.y, 32 * scale.x, 32 * scale.y);
+    static WorkerPool& shared() {
+        static WorkerPool pool;
+        return pool;
     }
     
-    bool collides_with(const Sprite& other) const {
-        return bounds.intersects(other.bounds);
+    size_t size() const { return workers.size() + 1; }
+    
+    // Calls task(i) for every i in [0, count) and returns when all are done
+    void run(size_t count, const std::function<void(size_t)>& task) {
+        if (workers.empty() || count <= 1) {
+            for (size_t i = 0; i < count; ++i) task(i);
+            return;
+        }
+        
+        std::lock_guard<std::mutex> serial(run_mutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current = &task;
+            task_count = count;
+            next.store(0);
+            active = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        drain();
+        
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return active == 0; });
+        current = nullptr;
     }
     
-    void move_to(float x, float y) {
-        position = Vector2D(x, y);
-        update_bounds();
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::mutex run_mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t)>* current = nullptr;
+    size_t task_count = 0;
+    std::atomic<size_t> next{0};
+    size_t active = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+    
+    void drain() {
+        for (size_t i = next.fetch_add(1); i < task_count; i = next.fetch_add(1)) {
+            (*current)(i);
+        }
     }
     
-    void move_by(float dx, float dy) {
-        position = position + Vector2D(dx, dy);
-        update_bounds();
+    void worker_loop() {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            drain();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--active == 0) done.notify_one();
+            }
+        }
     }
 };
 
-// Input handling system
-class Input {
+// Bounded lock-free single-producer/single-consumer ring. Head and tail
+// live on separate cache lines and each side caches the other's index, so
+// the common case touches no shared line. Capacity rounds up to a power
+// of two.
+template<typename T>
+class SpscQueue {
 public:
-    enum class KeyState { UP, DOWN, PRESSED, RELEASED };
-    enum class MouseButton { LEFT, RIGHT, MIDDLE };
+    explicit SpscQueue(size_t capacity = 1024) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        buffer.resize(size);
+        mask = size - 1;
+    }
     
-    static std::unordered_map<std::string, KeyState> keys;
-    static Vector2D mouse_position;
-    static std::unordered_map<MouseButton, KeyState> mouse_buttons;
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
     
-    static bool is_key_down(const std::string& key) {
-        return keys[key] == KeyState::DOWN || keys[key] == KeyState::PRESSED;
+    size_t capacity() const { return mask + 1; }
+    
+    // Producer side; fails instead of blocking when full
+    bool try_push(const T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head == capacity()) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (t - cached_head == capacity()) return false;
+        }
+        buffer[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
     }
     
-    static bool is_key_pressed(const std::string& key) {
-        return keys[key] == KeyState::PRESSED;
+    // Producer side; pushes as many of count items as fit
+    size_t push(const T* values, size_t count) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        cached_head = head.load(std::memory_order_acquire);
+        size_t n = std::min(count, capacity() - (t - cached_head));
+        for (size_t i = 0; i < n; ++i) buffer[(t + i) & mask] = values[i];
+        tail.store(t + n, std::memory_order_release);
+        return n;
     }
     
-    static bool is_mouse_down(MouseButton button) {
-        return mouse_buttons[button] == KeyState::DOWN || 
-               mouse_buttons[button] == KeyState::PRESSED;
+    // Consumer side
+    bool try_pop(T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (h == cached_tail) return false;
+        }
+        value = buffer[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
     }
     
-    static Vector2D get_mouse_position() {
-        return mouse_position;
+    // Consumer side; pops up to count items
+    size_t pop(T* values, size_t count) {
+        size_t h = head.load(std::memory_order_relaxed);
+        cached_tail = tail.load(std::memory_order_acquire);
+        size_t n = std::min(count, cached_tail - h);
+        for (size_t i = 0; i < n; ++i) values[i] = buffer[(h + i) & mask];
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+    
+    // Approximate when called concurrently with the other side
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
     }
+    
+private:
+    std::vector<T> buffer;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0};
+    size_t cached_tail = 0;     // consumer's view of tail
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t cached_head = 0;     // producer's view of head
 };
 
-// Window class for graphics rendering
-class Window {
+// Placement of a texture inside a TextureAtlas page
+struct AtlasRegion {
+    uint16_t page = 0;
+    uint16_t x = 0, y = 0;
+    uint16_t width = 0, height = 0;
+};
+
+// CPU render target. Pixels are RGBA8 packed into uint32_t (red in the
+// low byte) and stored tile-major: each TILE_SIZE x TILE_SIZE tile is one
+// contiguous block, so a tile being filled stays resident in cache.
+class Framebuffer {
 public:
-    std::string title;
-    int width, height;
-    Color background_color;
-    bool is_open;
-    std::vector<std::shared_ptr<Sprite>> sprites;
+    static constexpr int TILE_SIZE = 64;
     
-    Window(const std::string& title = "Replit Game", int w = 800, int h = 600)
-        : title(title), width(w), height(h), background_color(Color::BLACK()), is_open(true) {}
+    // Half-open pixel rectangle that every draw call is clipped to
+    struct Clip {
+        int x0, y0, x1, y1;
+    };
     
-    void clear() {
-        // Clear the screen with background color
+    Framebuffer(int w = 0, int h = 0) { resize(w, h); }
+    
+    void resize(int w, int h) {
+        frame_width = std::max(w, 0);
+        frame_height = std::max(h, 0);
+        tile_columns = (frame_width + TILE_SIZE - 1) / TILE_SIZE;
+        tile_rows = (frame_height + TILE_SIZE - 1) / TILE_SIZE;
+        pixels.assign(static_cast<size_t>(tile_columns) * tile_rows * TILE_SIZE * TILE_SIZE, 0);
     }
     
-    void render() {
-        clear();
-        // Sort sprites by layer
-        std::sort(sprites.begin(), sprites.end(), 
-                 [](const auto& a, const auto& b) { return a->layer < b->layer; });
+    int width() const { return frame_width; }
+    int height() const { return frame_height; }
+    int tiles_x() const { return tile_columns; }
+    int tiles_y() const { return tile_rows; }
+    
+    Clip bounds() const { return {0, 0, frame_width, frame_height}; }
+    
+    Clip tile_bounds(int tx, int ty) const {
+        return {tx * TILE_SIZE, ty * TILE_SIZE,
+                std::min((tx + 1) * TILE_SIZE, frame_width),
+                std::min((ty + 1) * TILE_SIZE, frame_height)};
+    }
+    
+    uint32_t* tile(int tx, int ty) {
+        return pixels.data() + (static_cast<size_t>(ty) * tile_columns + tx) * TILE_SIZE * TILE_SIZE;
+    }
+    
+    uint32_t get_pixel(int x, int y) const {
+        return pixels[offset(x, y)];
+    }
+    
+    void set_pixel(int x, int y, uint32_t color) {
+        pixels[offset(x, y)] = color;
+    }
+    
+    static uint32_t pack(const Color& color) {
+        auto channel = [](float v) {
+            return static_cast<uint32_t>(std::lround(std::min(std::max(v, 0.0f), 1.0f) * 255.0f));
+        };
+        return channel(color.r) | channel(color.g) << 8 | channel(color.b) << 16 | channel(color.a) << 24;
+    }
+    
+    void clear(const Color& color) {
+        uint32_t packed = pack(color) | 0xFF000000u;
+        std::fill(pixels.begin(), pixels.end(), packed);
+    }
+    
+    void clear(const Color& color, const Clip& clip) {
+        uint32_t packed = pack(color) | 0xFF000000u;
+        for (int y = clip.y0; y < clip.y1; ++y) span(clip.x0, clip.x1, y, packed);
+    }
+    
+    // Covers pixels whose centers fall inside the rectangle
+    void fill_rect(const Rectangle& rect, const Color& color, const Clip& clip) {
+        fill_rect(rect, pack(color), clip);
+    }
+    
+    void fill_rect(const Rectangle& rect, uint32_t packed, const Clip& clip) {
+        int x0 = std::max(clip.x0, static_cast<int>(std::floor(rect.x + 0.5f)));
+        int x1 = std::min(clip.x1, static_cast<int>(std::floor(rect.x + rect.width + 0.5f)));
+        int y0 = std::max(clip.y0, static_cast<int>(std::floor(rect.y + 0.5f)));
+        int y1 = std::min(clip.y1, static_cast<int>(std::floor(rect.y + rect.height + 0.5f)));
+        if (x0 >= x1) return;
         
-        // Render all sprites
-        for (auto& sprite : sprites) {
-            if (sprite->visible) {
-                draw_sprite(*sprite);
+        for (int y = y0; y < y1; ++y) span(x0, x1, y, packed);
+    }
+    
+    // Scales the source rectangle onto rect with nearest sampling, tinted
+    // by multiplying each channel; translucent texels are blended
+    void draw_image(const uint32_t* source, int source_stride, const AtlasRegion& region,
+                    const Rectangle& rect, uint32_t tint, const Clip& clip) {
+        int x0 = std::max(clip.x0, static_cast<int>(std::floor(rect.x + 0.5f)));
+        int x1 = std::min(clip.x1, static_cast<int>(std::floor(rect.x + rect.width + 0.5f)));
+        int y0 = std::max(clip.y0, static_cast<int>(std::floor(rect.y + 0.5f)));
+        int y1 = std::min(clip.y1, static_cast<int>(std::floor(rect.y + rect.height + 0.5f)));
+        if (x0 >= x1 || y0 >= y1 || rect.width <= 0 || rect.height <= 0) return;
+        
+        // Render workers each keep their own column table between calls
+        static thread_local std::vector<int> columns;
+        columns.resize(x1 - x0);
+        float step_u = region.width / rect.width, step_v = region.height / rect.height;
+        for (int x = x0; x < x1; ++x) {
+            int u = static_cast<int>((x + 0.5f - rect.x) * step_u);
+            columns[x - x0] = region.x + std::min(std::max(u, 0), region.width - 1);
+        }
+        
+        for (int y = y0; y < y1; ++y) {
+            int v = static_cast<int>((y + 0.5f - rect.y) * step_v);
+            const uint32_t* line = source + static_cast<size_t>(region.y + std::min(std::max(v, 0), region.height - 1)) * source_stride;
+            int ty = y / TILE_SIZE;
+            int offset_in_tile = (y % TILE_SIZE) * TILE_SIZE;
+            for (int x = x0; x < x1;) {
+                int tx = x / TILE_SIZE;
+                int end = std::min(x1, (tx + 1) * TILE_SIZE);
+                uint32_t* dst = tile(tx, ty) + offset_in_tile + (x % TILE_SIZE);
+                for (int i = x; i < end; ++i) {
+                    uint32_t texel = modulate(line[columns[i - x0]], tint);
+                    uint32_t alpha = texel >> 24;
+                    if (alpha == 255) dst[i - x] = texel;
+                    else if (alpha != 0) fill_blend(dst + (i - x), 1, texel);
+                }
+                x = end;
             }
         }
+    }
+    
+    // One horizontal span per scanline
+    void fill_circle(const Vector2D& center, float radius, const Color& color, const Clip& clip) {
+        if (radius <= 0) return;
+        uint32_t packed = pack(color);
+        int y0 = std::max(clip.y0, static_cast<int>(std::ceil(center.y - radius - 0.5f)));
+        int y1 = std::min(clip.y1, static_cast<int>(std::floor(center.y + radius - 0.5f)) + 1);
         
-        present();
+        for (int y = y0; y < y1; ++y) {
+            float dy = y + 0.5f - center.y;
+            float squared = radius * radius - dy * dy;
+            if (squared < 0) continue;
+            float half = std::sqrt(squared);
+            int x0 = std::max(clip.x0, static_cast<int>(std::floor(center.x - half + 0.5f)));
+            int x1 = std::min(clip.x1, static_cast<int>(std::floor(center.x + half + 0.5f)));
+            if (x0 < x1) span(x0, x1, y, packed);
+        }
     }
     
-    void draw_sprite(const Sprite& sprite) {
-        // Draw sprite at position with rotation, scale, and tint
+    // Bresenham, one pixel wide. The segment is first clipped (Liang-Barsky)
+    // to the clip rect grown by a pixel, so off-screen endpoints cost nothing
+    // and the int casts stay in range; rounding at the cut ends only lands in
+    // the margin, which the per-pixel test drops
+    void draw_line(const Vector2D& start, const Vector2D& end, const Color& color, const Clip& clip) {
+        if (clip.x0 >= clip.x1 || clip.y0 >= clip.y1) return;
+        if (!std::isfinite(start.x) || !std::isfinite(start.y) ||
+            !std::isfinite(end.x) || !std::isfinite(end.y)) return;
+        
+        double from[2] = {start.x, start.y}, to[2] = {end.x, end.y};
+        double lo[2] = {clip.x0 - 1.0, clip.y0 - 1.0}, hi[2] = {clip.x1 + 1.0, clip.y1 + 1.0};
+        double t0 = 0.0, t1 = 1.0;
+        int axis0 = -1, axis1 = -1;
+        double edge0 = 0.0, edge1 = 0.0;
+        for (int axis = 0; axis < 2; ++axis) {
+            double d = to[axis] - from[axis];
+            if (d == 0.0) {
+                if (from[axis] < lo[axis] || from[axis] > hi[axis]) return;
+                continue;
+            }
+            double enter = ((d > 0 ? lo[axis] : hi[axis]) - from[axis]) / d;
+            double leave = ((d > 0 ? hi[axis] : lo[axis]) - from[axis]) / d;
+            if (enter > t0) { t0 = enter; axis0 = axis; edge0 = d > 0 ? lo[axis] : hi[axis]; }
+            if (leave < t1) { t1 = leave; axis1 = axis; edge1 = d > 0 ? hi[axis] : lo[axis]; }
+        }
+        if (t0 > t1) return;
+        
+        // The coordinate that was clipped is set to its edge exactly, since
+        // t loses the precision to place it for very long segments
+        auto point = [&](double t, int clipped, double edge, int axis) {
+            double v = axis == clipped ? edge : from[axis] + t * (to[axis] - from[axis]);
+            return static_cast<int>(std::floor(std::min(std::max(v, lo[axis]), hi[axis])));
+        };
+        int x0 = point(t0, axis0, edge0, 0), y0 = point(t0, axis0, edge0, 1);
+        int x1 = point(t1, axis1, edge1, 0), y1 = point(t1, axis1, edge1, 1);
+        
+        uint32_t packed = pack(color);
+        int dx = std::abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+        int dy = -std::abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+        int err = dx + dy;
+        
+        while (true) {
+            if (x0 >= clip.x0 && x0 < clip.x1 && y0 >= clip.y0 && y0 < clip.y1) {
+                span(x0, x0 + 1, y0, packed);
+            }
+            if (x0 == x1 && y0 == y1) break;
+            int e2 = 2 * err;
+            if (e2 >= dy) { err += dy; x0 += sx; }
+            if (e2 <= dx) { err += dx; y0 += sy; }
+        }
     }
     
-    void draw_rectangle(const Rectangle& rect, const Color& color) {
-        // Draw filled rectangle
+    // Built-in 3x5 bitmap font, scaled to roughly font_size pixels tall
+    void draw_text(const std::string& text, const Vector2D& position, const Color& color,
+                   int font_size, const Clip& clip) {
+        static const uint16_t GLYPHS[64] = {
+            0x0000, 0x2482, 0x5A00, 0x6282, 0x6282, 0x52A5, 0x6282, 0x2400,
+            0x1491, 0x4494, 0x0AA8, 0x05D0, 0x0014, 0x01C0, 0x0002, 0x12A4,
+            0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7249,
+            0x7BEF, 0x7BCF, 0x0410, 0x6282, 0x1511, 0x0E38, 0x4454, 0x6282,
+            0x6282, 0x2BED, 0x6BAE, 0x3923, 0x6B6E, 0x79A7, 0x79A4, 0x396B,
+            0x5BED, 0x7497, 0x126A, 0x5BAD, 0x4927, 0x5FED, 0x6B6D, 0x2B6A,
+            0x6BA4, 0x2B73, 0x6BAD, 0x388E, 0x7492, 0x5B6F, 0x5B6A, 0x5BFD,
+            0x5AAD, 0x5A92, 0x72A7, 0x6282, 0x6282, 0x6282, 0x6282, 0x0007,
+        };
+        
+        int scale = std::max(1, font_size / 6);
+        float pen_x = position.x;
+        for (char c : text) {
+            if (c >= 'a' && c <= 'z') c = static_cast<char>(c - 'a' + 'A');
+            uint16_t glyph = (c >= 32 && c < 96) ? GLYPHS[c - 32] : GLYPHS['?' - 32];
+            for (int row = 0; row < 5; ++row) {
+                int bits = (glyph >> (12 - row * 3)) & 7;
+                for (int col = 0; col < 3; ++col) {
+                    if (bits & (4 >> col)) {
+                        fill_rect(Rectangle(pen_x + col * scale, position.y + row * scale, scale, scale),
+                                  color, clip);
+                    }
+                }
+            }
+            pen_x += 4 * scale;
+        }
     }
     
-    void draw_circle(const Vector2D& center, float radius, const Color& color) {
-        // Draw filled circle
+    // Row-major RGBA8 copy of the visible area
+    std::vector<uint8_t> to_rgba() const {
+        std::vector<uint8_t> result(static_cast<size_t>(frame_width) * frame_height * 4);
+        for (int y = 0; y < frame_height; ++y) {
+            for (int tx = 0; tx < tile_columns; ++tx) {
+                int x0 = tx * TILE_SIZE;
+                int count = std::min(TILE_SIZE, frame_width - x0);
+                std::memcpy(&result[(static_cast<size_t>(y) * frame_width + x0) * 4],
+                            &pixels[offset(x0, y)], count * 4);
+            }
+        }
+        return result;
     }
     
-    void draw_line(const Vector2D& start, const Vector2D& end, const Color& color) {
-        // Draw line
+    bool save_ppm(const std::string& path) const {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) return false;
+        file << "P6\n" << frame_width << " " << frame_height << "\n255\n";
+        
+        std::vector<uint8_t> rgba = to_rgba();
+        std::vector<uint8_t> rgb(rgba.size() / 4 * 3);
+        for (size_t i = 0, j = 0; i < rgba.size(); i += 4, j += 3) {
+            rgb[j] = rgba[i];
+            rgb[j + 1] = rgba[i + 1];
+            rgb[j + 2] = rgba[i + 2];
+        }
+        file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+        return static_cast<bool>(file);
     }
     
-    void draw_text(const std::string& text, const Vector2D& position, 
-                   const Color& color, int font_size = 12) {
-        // Draw text
+    // Uncompressed (stored-block) PNG: no zlib dependency, fast to write
+    bool save_png(const std::string& path) const {
+        std::vector<uint8_t> rgba = to_rgba();
+        size_t stride = static_cast<size_t>(frame_width) * 4;
+        std::vector<uint8_t> raw;
+        raw.reserve((stride + 1) * frame_height);
+        for (int y = 0; y < frame_height; ++y) {
+            raw.push_back(0); // filter: none
+            raw.insert(raw.end(), rgba.begin() + y * stride, rgba.begin() + (y + 1) * stride);
+        }
+        
+        std::vector<uint8_t> zlib = {0x78, 0x01};
+        for (size_t pos = 0; pos < raw.size() || pos == 0; ) {
+            size_t len = std::min<size_t>(65535, raw.size() - pos);
+            bool last = pos + len == raw.size();
+            zlib.push_back(last ? 1 : 0);
+            zlib.push_back(len & 0xFF);
+            zlib.push_back(len >> 8);
+            zlib.push_back(~len & 0xFF);
+            zlib.push_back((~len >> 8) & 0xFF);
+            zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+            pos += len;
+            if (last) break;
+        }
+        uint32_t adler = adler32(raw.data(), raw.size());
+        for (int shift = 24; shift >= 0; shift -= 8) zlib.push_back((adler >> shift) & 0xFF);
+        
+        std::vector<uint8_t> header(13);
+        put_be32(&header[0], frame_width);
+        put_be32(&header[4], frame_height);
+        header[8] = 8;  // bit depth
+        header[9] = 6;  // RGBA
+        
+        std::ofstream file(path, std::ios::binary);
+        if (!file) return false;
+        static const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        file.write(reinterpret_cast<const char*>(SIGNATURE), 8);
+        write_chunk(file, "IHDR", header);
+        write_chunk(file, "IDAT", zlib);
+        write_chunk(file, "IEND", {});
+        return static_cast<bool>(file);
     }
     
-    void present() {
-        // Present the rendered frame
+    // Fills [x0, x1) on row y, splitting the span at tile boundaries.
+    // Opaque colors are stored directly, translucent ones are blended.
+    void span(int x0, int x1, int y, uint32_t color) {
+        int ty = y / TILE_SIZE;
+        int row = (y % TILE_SIZE) * TILE_SIZE;
+        uint32_t alpha = color >> 24;
+        if (alpha == 0) return;
+        
+        while (x0 < x1) {
+            int tx = x0 / TILE_SIZE;
+            int end = std::min(x1, (tx + 1) * TILE_SIZE);
+            uint32_t* dst = tile(tx, ty) + row + (x0 % TILE_SIZE);
+            if (alpha == 255) fill_opaque(dst, end - x0, color);
+            else fill_blend(dst, end - x0, color);
+            x0 = end;
+        }
     }
     
-    void close() {
-        is_open = false;
+    // Checksums shared by the PNG writer and Inflate
+    static uint32_t adler32(const uint8_t* data, size_t size) {
+        uint32_t a = 1, b = 0;
+        while (size > 0) {
+            size_t block = std::min<size_t>(size, 5552);
+            for (size_t i = 0; i < block; ++i) {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+            data += block;
+            size -= block;
+        }
+        return (b << 16) | a;
     }
     
-    void add_sprite(std::shared_ptr<Sprite> sprite) {
-        sprites.push_back(sprite);
+    static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0xFFFFFFFFu) {
+        static const auto table = [] {
+            std::vector<uint32_t> t(256);
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[n] = c;
+            }
+            return t;
+        }();
+        for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return crc;
     }
     
-    void remove_sprite(std::shared_ptr<Sprite> sprite) {
-        sprites.erase(std::remove(sprites.begin(), sprites.end(), sprite), sprites.end());
+private:
+    int frame_width = 0;
+    int frame_height = 0;
+    int tile_columns = 0;
+    int tile_rows = 0;
+    std::vector<uint32_t> pixels;
+    
+    size_t offset(int x, int y) const {
+        size_t tile_index = static_cast<size_t>(y / TILE_SIZE) * tile_columns + x / TILE_SIZE;
+        return tile_index * TILE_SIZE * TILE_SIZE + (y % TILE_SIZE) * TILE_SIZE + (x % TILE_SIZE);
     }
     
-    bool should_close() const {
-        return !is_open;
+    static uint32_t modulate(uint32_t texel, uint32_t tint) {
+        if (tint == 0xFFFFFFFFu) return texel;
+        uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            uint32_t v = ((texel >> shift) & 0xFF) * ((tint >> shift) & 0xFF) + 128;
+            out |= ((v + (v >> 8)) >> 8) << shift;
+        }
+        return out;
     }
     
-    void poll_events() {
-        // Handle window events, input, etc.
+    static void fill_opaque(uint32_t* dst, int count, uint32_t color) {
+        int i = 0;
+#if defined(__SSE2__)
+        __m128i value = _mm_set1_epi32(static_cast<int>(color));
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), value);
+        }
+#endif
+        for (; i < count; ++i) dst[i] = color;
     }
     
-    void set_vsync(bool enabled) {
-        // Enable/disable vertical sync
+    // Source-over with the source alpha applied to every channel
+    // (destination alpha accumulates coverage): out = (s*a + d*(255-a)) / 255
+    static void fill_blend(uint32_t* dst, int count, uint32_t color) {
+        uint32_t a = color >> 24;
+        uint32_t source = color | 0xFF000000u;
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        __m128i src16 = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(source)), zero);
+        __m128i premul = _mm_add_epi16(_mm_mullo_epi16(src16, _mm_set1_epi16(static_cast<short>(a))),
+                                       _mm_set1_epi16(128));
+        __m128i inverse = _mm_set1_epi16(static_cast<short>(255 - a));
+        for (; i + 4 <= count; i += 4) {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i*>(dst + i));
+            __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inverse), premul);
+            __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inverse), premul);
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; i < count; ++i) {
+            uint32_t d = dst[i];
+            uint32_t out = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                uint32_t v = ((source >> shift) & 0xFF) * a + ((d >> shift) & 0xFF) * (255 - a) + 128;
+                out |= ((v + (v >> 8)) >> 8) << shift;
+            }
+            dst[i] = out;
+        }
     }
     
-    void set_fullscreen(bool fullscreen) {
-        // Toggle fullscreen mode
+    static void put_be32(uint8_t* out, uint32_t value) {
+        out[0] = value >> 24;
+        out[1] = (value >> 16) & 0xFF;
+        out[2] = (value >> 8) & 0xFF;
+        out[3] = value & 0xFF;
+    }
+    
+    static void write_chunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data) {
+        uint8_t length[4];
+        put_be32(length, static_cast<uint32_t>(data.size()));
+        file.write(reinterpret_cast<const char*>(length), 4);
+        file.write(type, 4);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        
+        uint32_t crc = crc32(reinterpret_cast<const uint8_t*>(type), 4);
+        crc = crc32(data.data(), data.size(), crc) ^ 0xFFFFFFFFu;
+        uint8_t trailer[4];
+        put_be32(trailer, crc);
+        file.write(reinterpret_cast<const char*>(trailer), 4);
     }
 };
 
-// Audio system
-class AudioSystem {
+// zlib/DEFLATE decoder (RFC 1950/1951) for PNG image data. Huffman codes
+// up to 9 bits resolve through a lookup table; longer codes fall back to
+// canonical bit-by-bit decoding.
+class Inflate {
 public:
-    static void play_sound(const std::string& path, float volume = 1.0f) {
-        // Play sound effect
+    // Decodes a zlib stream; throws on malformed input or when the output
+    // would exceed max_size (0 for no limit)
+    static std::vector<uint8_t> zlib(const uint8_t* data, size_t size, size_t max_size = 0) {
+        if (size < 6 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20)) {
+            throw std::runtime_error("Invalid zlib stream");
+        }
+        std::vector<uint8_t> out;
+        // DEFLATE expands at most 1032:1, so a short stream cannot make
+        // a large max_size allocate
+        out.reserve(std::min(max_size, size * 1032));
+        size_t used = raw(data + 2, size - 2, out, max_size ? max_size : SIZE_MAX);
+        
+        const uint8_t* trailer = data + 2 + used;
+        if (2 + used + 4 > size) throw std::runtime_error("Truncated zlib stream");
+        uint32_t expected = uint32_t(trailer[0]) << 24 | trailer[1] << 16 | trailer[2] << 8 | trailer[3];
+        if (Framebuffer::adler32(out.data(), out.size()) != expected) {
+            throw std::runtime_error("zlib checksum mismatch");
+        }
+        return out;
     }
     
-    static void play_music(const std::string& path, bool loop = true, float volume = 1.0f) {
-        // Play background music
+    // Decodes raw DEFLATE blocks, appending to out but never past max_size
+    // bytes in total; returns bytes consumed
+    static size_t raw(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t max_size = SIZE_MAX) {
+        static const uint16_t LENGTH_BASE[29] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t LENGTH_EXTRA[29] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const uint16_t DISTANCE_BASE[30] = {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        static const uint8_t DISTANCE_EXTRA[30] = {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        
+        Bits bits{data, size};
+        Huffman literals, distances;
+        bool last = false;
+        while (!last) {
+            last = bits.get(1);
+            uint32_t type = bits.get(2);
+            if (type == 0) {
+                bits.align();
+                uint32_t length = bits.get(16);
+                uint32_t check = bits.get(16);
+                if ((length ^ 0xFFFF) != check) throw std::runtime_error("Corrupt stored block");
+                if (length > max_size - out.size()) throw std::runtime_error("Deflate output too large");
+                for (uint32_t i = 0; i < length; ++i) out.push_back(static_cast<uint8_t>(bits.get(8)));
+            } else if (type == 1) {
+                uint8_t lengths[288 + 30];
+                std::fill(lengths, lengths + 144, 8);
+                std::fill(lengths + 144, lengths + 256, 9);
+                std::fill(lengths + 256, lengths + 280, 7);
+                std::fill(lengths + 280, lengths + 288, 8);
+                std::fill(lengths + 288, lengths + 318, 5);
+                literals.build(lengths, 288);
+                distances.build(lengths + 288, 30);
+            } else if (type == 2) {
+                read_dynamic(bits, literals, distances);
+            } else {
+                throw std::runtime_error("Invalid deflate block type");
+            }
+            
+            if (type != 0) {
+                while (true) {
+                    // Past the end the bit reader feeds zeros, which can
+                    // decode as an endless run of symbols
+                    if (bits.overrun()) throw std::runtime_error("Truncated deflate stream");
+                    int symbol = literals.decode(bits);
+                    if (symbol < 256) {
+                        if (out.size() == max_size) throw std::runtime_error("Deflate output too large");
+                        out.push_back(static_cast<uint8_t>(symbol));
+                        continue;
+                    }
+                    if (symbol == 256) break;
+                    symbol -= 257;
+                    if (symbol >= 29) throw std::runtime_error("Invalid deflate length");
+                    size_t length = LENGTH_BASE[symbol] + bits.get(LENGTH_EXTRA[symbol]);
+                    int code = distances.decode(bits);
+                    if (code >= 30) throw std::runtime_error("Invalid deflate distance");
+                    size_t distance = DISTANCE_BASE[code] + bits.get(DISTANCE_EXTRA[code]);
+                    if (distance > out.size()) throw std::runtime_error("Deflate distance too far back");
+                    if (length > max_size - out.size()) throw std::runtime_error("Deflate output too large");
+                    
+                    size_t from = out.size() - distance;
+                    out.resize(out.size() + length);
+                    uint8_t* dst = out.data() + out.size() - length;
+                    const uint8_t* src = out.data() + from;
+                    for (size_t i = 0; i < length; ++i) dst[i] = src[i];
+                }
+            }
+            if (bits.overrun()) throw std::runtime_error("Truncated deflate stream");
+        }
+        return bits.consumed();
     }
     
-    static void stop_music() {
-        // Stop background music
-    }
+private:
+    struct Bits {
+        const uint8_t* data;
+        size_t size;
+        size_t pos = 0;
+        uint64_t buffer = 0;
+        int count = 0;
+        
+        void refill() {
+            while (count <= 56) {
+                uint64_t byte = pos < size ? data[pos] : 0;
+                pos++;
+                buffer |= byte << count;
+                count += 8;
+            }
+        }
+        
+        uint32_t peek(int n) {
+            if (count < n) refill();
+            return static_cast<uint32_t>(buffer & ((uint64_t(1) << n) - 1));
+        }
+        
+        void drop(int n) {
+            buffer >>= n;
+            count -= n;
+        }
+        
+        uint32_t get(int n) {
+            if (n == 0) return 0;
+            uint32_t value = peek(n);
+            drop(n);
+            return value;
+        }
+        
+        void align() { drop(count % 8); }
+        size_t consumed() const { return (pos * 8 - count + 7) / 8; }
+        bool overrun() const { return pos * 8 - count > size * 8; }
+    };
     
-    static void set_master_volume(float volume) {
-        // Set master volume
+    struct Huffman {
+        static constexpr int FAST_BITS = 9;
+        uint16_t counts[16];
+        uint16_t symbols[288];
+        uint16_t fast[1 << FAST_BITS];   // symbol | length << 9, 0 if longer
+        
+        void build(const uint8_t* lengths, int n) {
+            std::fill(counts, counts + 16, 0);
+            for (int i = 0; i < n; ++i) counts[lengths[i]]++;
+            counts[0] = 0;
+            
+            int left = 1;
+            for (int len = 1; len < 16; ++len) {
+                left = (left << 1) - counts[len];
+                if (left < 0) throw std::runtime_error("Over-subscribed Huffman code");
+            }
+            
+            uint16_t offsets[16];
+            offsets[1] = 0;
+            for (int len = 1; len < 15; ++len) offsets[len + 1] = offsets[len] + counts[len];
+            for (int i = 0; i < n; ++i) {
+                if (lengths[i]) symbols[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+            }
+            
+            std::fill(fast, fast + (1 << FAST_BITS), 0);
+            uint32_t code = 0;
+            int index = 0;
+            for (int len = 1; len <= FAST_BITS; ++len) {
+                for (int k = 0; k < counts[len]; ++k, ++index, ++code) {
+                    uint32_t reversed = 0;
+                    for (int b = 0; b < len; ++b) reversed |= ((code >> b) & 1) << (len - 1 - b);
+                    for (uint32_t fill = reversed; fill < (1u << FAST_BITS); fill += 1u << len) {
+                        fast[fill] = static_cast<uint16_t>(symbols[index] | len << 9);
+                    }
+                }
+                code <<= 1;
+            }
+        }
+        
+        int decode(Bits& bits) const {
+            uint16_t entry = fast[bits.peek(FAST_BITS)];
+            if (entry) {
+                bits.drop(entry >> 9);
+                return entry & 0x1FF;
+            }
+            
+            int code = 0, first = 0, index = 0;
+            for (int len = 1; len < 16; ++len) {
+                code |= bits.get(1);
+                int count = counts[len];
+                if (code - first < count) return symbols[index + code - first];
+                index += count;
+                first = (first + count) << 1;
+                code <<= 1;
+            }
+            throw std::runtime_error("Invalid Huffman code");
+        }
+    };
+    
+    static void read_dynamic(Bits& bits, Huffman& literals, Huffman& distances) {
+        static const uint8_t ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        int literal_count = bits.get(5) + 257;
+        int distance_count = bits.get(5) + 1;
+        int code_count = bits.get(4) + 4;
+        if (literal_count > 286 || distance_count > 30) throw std::runtime_error("Invalid dynamic block");
+        
+        uint8_t lengths[288 + 32] = {0};
+        for (int i = 0; i < code_count; ++i) lengths[ORDER[i]] = static_cast<uint8_t>(bits.get(3));
+        Huffman code_lengths;
+        code_lengths.build(lengths, 19);
+        
+        std::fill(lengths, lengths + 19, 0);
+        int total = literal_count + distance_count;
+        for (int i = 0; i < total;) {
+            int symbol = code_lengths.decode(bits);
+            if (symbol < 16) {
+                lengths[i++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+            uint8_t value = 0;
+            int repeat;
+            if (symbol == 16) {
+                if (i == 0) throw std::runtime_error("Invalid length repeat");
+                value = lengths[i - 1];
+                repeat = 3 + bits.get(2);
+            } else if (symbol == 17) {
+                repeat = 3 + bits.get(3);
+            } else {
+                repeat = 11 + bits.get(7);
+            }
+            if (i + repeat > total) throw std::runtime_error("Invalid length repeat");
+            while (repeat--) lengths[i++] = value;
+        }
+        if (lengths[256] == 0) throw std::runtime_error("Missing end-of-block code");
+        
+        literals.build(lengths, literal_count);
+        distances.build(lengths + literal_count, distance_count);
     }
 };
 
-// Timer and animation system
-class Timer {
+// Decoded image as packed RGBA8 (same layout as Framebuffer pixels),
+// row-major
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> pixels;
+};
+
+// PPM (P3/P5/P6), BMP (8/24/32-bit uncompressed) and PNG (non-interlaced,
+// all color types) decoding; the format is picked from the file's magic
+// bytes
+class ImageDecoder {
 public:
-    float duration;
-    float elapsed;
-    bool running;
-    std::function<void()> callback;
+    // Largest width or height accepted, so pixel and row sizes cannot
+    // overflow and a small header cannot demand a huge allocation
+    static constexpr int MAX_DIMENSION = 16384;
     
-    Timer(float duration, std::function<void()> callback = nullptr)
-        : duration(duration), elapsed(0), running(false), callback(callback) {}
+    static Image load(const std::string& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) throw std::runtime_error("Could not open image: " + path);
+        std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(data.data()), data.size());
+        try {
+            return decode(data.data(), data.size());
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error(path + ": " + e.what());
+        }
+    }
     
-    void start() {
-        running = true;
-        elapsed = 0;
+    static Image decode(const uint8_t* data, size_t size) {
+        if (size >= 8 && std::memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0) return decode_png(data, size);
+        if (size >= 2 && data[0] == 'B' && data[1] == 'M') return decode_bmp(data, size);
+        if (size >= 2 && data[0] == 'P' && (data[1] == '3' || data[1] == '5' || data[1] == '6')) {
+            return decode_ppm(data, size);
+        }
+        throw std::runtime_error("Unrecognized image format");
     }
     
-    void stop() {
-        running = false;
+    static Image decode_ppm(const uint8_t* data, size_t size) {
+        size_t pos = 2;
+        auto number = [&]() {
+            while (pos < size) {
+                if (data[pos] == '#') {
+                    while (pos < size && data[pos] != '\n') pos++;
+                } else if (std::isspace(data[pos])) {
+                    pos++;
+                } else {
+                    break;
+                }
+            }
+            if (pos >= size || !std::isdigit(data[pos])) throw std::runtime_error("Malformed PPM header");
+            int value = 0;
+            while (pos < size && std::isdigit(data[pos])) value = value * 10 + (data[pos++] - '0');
+            return value;
+        };
+        
+        char kind = static_cast<char>(data[1]);
+        Image image;
+        image.width = number();
+        image.height = number();
+        check_dimensions(image.width, image.height);
+        int max_value = number();
+        if (max_value <= 0 || max_value > 65535) throw std::runtime_error("Invalid PPM max value");
+        pos++; // single whitespace before binary data
+        
+        int channels = kind == '5' ? 1 : 3;
+        int sample_bytes = max_value > 255 ? 2 : 1;
+        size_t samples = static_cast<size_t>(image.width) * image.height * channels;
+        if (kind != '3' && size - std::min(pos, size) < samples * sample_bytes) {
+            throw std::runtime_error("Truncated PPM data");
+        }
+        
+        auto sample = [&]() -> uint32_t {
+            int value;
+            if (kind == '3') {
+                value = number();
+            } else if (sample_bytes == 2) {
+                value = data[pos] << 8 | data[pos + 1];
+                pos += 2;
+            } else {
+                value = data[pos++];
+            }
+            return static_cast<uint32_t>(std::min(value, max_value) * 255 / max_value);
+        };
+        
+        image.pixels.resize(static_cast<size_t>(image.width) * image.height);
+        for (auto& pixel : image.pixels) {
+            uint32_t r = sample();
+            uint32_t g = channels == 3 ? sample() : r;
+            uint32_t b = channels == 3 ? sample() : r;
+            pixel = r | g << 8 | b << 16 | 0xFF000000u;
+        }
+        return image;
     }
     
-    void update(float delta_time) {
-        if (!running) return;
+    static Image decode_bmp(const uint8_t* data, size_t size) {
+        if (size < 54) throw std::runtime_error("Truncated BMP header");
+        auto u16 = [&](size_t at) { return static_cast<uint32_t>(data[at] | data[at + 1] << 8); };
+        auto u32 = [&](size_t at) { return u16(at) | u16(at + 2) << 16; };
         
-        elapsed += delta_time;
-        if (elapsed >= duration) {
-            running = false;
-            if (callback) callback();
+        uint32_t pixel_offset = u32(10);
+        uint32_t header_size = u32(14);
+        int32_t width = static_cast<int32_t>(u32(18));
+        int32_t height = static_cast<int32_t>(u32(22));
+        uint32_t depth = u16(28);
+        uint32_t compression = u32(30);
+        if (compression != 0 && !(compression == 3 && depth == 32)) {
+            throw std::runtime_error("Compressed BMP is not supported");
+        }
+        if (depth != 8 && depth != 24 && depth != 32) throw std::runtime_error("Unsupported BMP bit depth");
+        if (width <= 0 || height == 0 || height == INT32_MIN) throw std::runtime_error("Invalid BMP dimensions");
+        
+        bool top_down = height < 0;
+        Image image;
+        image.width = width;
+        image.height = top_down ? -height : height;
+        check_dimensions(image.width, image.height);
+        size_t stride = (static_cast<size_t>(width) * depth / 8 + 3) & ~size_t(3);
+        if (pixel_offset + stride * image.height > size) throw std::runtime_error("Truncated BMP data");
+        
+        std::vector<uint32_t> palette;
+        if (depth == 8) {
+            uint32_t colors = u32(46) ? u32(46) : 256;
+            if (colors > 256) throw std::runtime_error("Invalid BMP palette size");
+            size_t at = size_t(14) + header_size;
+            if (at > size || size_t(colors) * 4 > size - at) throw std::runtime_error("Truncated BMP palette");
+            for (uint32_t i = 0; i < colors; ++i, at += 4) {
+                palette.push_back(data[at + 2] | data[at + 1] << 8 | data[at] << 16 | 0xFF000000u);
+            }
+            palette.resize(256, 0xFF000000u);
+        }
+        
+        image.pixels.resize(static_cast<size_t>(image.width) * image.height);
+        bool any_alpha = false;
+        for (int y = 0; y < image.height; ++y) {
+            const uint8_t* row = data + pixel_offset + stride * (top_down ? y : image.height - 1 - y);
+            uint32_t* out = &image.pixels[static_cast<size_t>(y) * image.width];
+            for (int x = 0; x < image.width; ++x) {
+                if (depth == 8) {
+                    out[x] = palette[row[x]];
+                } else if (depth == 24) {
+                    const uint8_t* p = row + x * 3;
+                    out[x] = p[2] | p[1] << 8 | p[0] << 16 | 0xFF000000u;
+                } else {
+                    const uint8_t* p = row + x * 4;
+                    out[x] = p[2] | p[1] << 8 | p[0] << 16 | uint32_t(p[3]) << 24;
+                    any_alpha |= p[3] != 0;
+                }
+            }
         }
+        // Many writers leave the fourth byte zero; treat that as opaque
+        if (depth == 32 && !any_alpha) {
+            for (auto& pixel : image.pixels) pixel |= 0xFF000000u;
+        }
+        return image;
     }
     
-    float progress() const {
-        return elapsed / duration;
+    static Image decode_png(const uint8_t* data, size_t size) {
+        auto be32 = [](const uint8_t* p) { return uint32_t(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3]; };
+        
+        Image image;
+        int depth = 0, color_type = 0;
+        std::vector<uint8_t> idat;
+        std::vector<uint32_t> palette;
+        int transparent[3] = {-1, -1, -1};
+        for (size_t pos = 8; pos + 12 <= size;) {
+            uint32_t length = be32(data + pos);
+            const uint8_t* type = data + pos + 4;
+            const uint8_t* body = data + pos + 8;
+            if (pos + 12 + length > size) throw std::runtime_error("Truncated PNG chunk");
+            
+            if (std::memcmp(type, "IHDR", 4) == 0) {
+                if (length < 13) throw std::runtime_error("Truncated PNG header");
+                uint32_t width = be32(body), height = be32(body + 4);
+                if (width > uint32_t(MAX_DIMENSION) || height > uint32_t(MAX_DIMENSION)) {
+                    throw std::runtime_error("Image dimensions too large");
+                }
+                image.width = static_cast<int>(width);
+                image.height = static_cast<int>(height);
+                depth = body[8];
+                color_type = body[9];
+                if (body[12] != 0) throw std::runtime_error("Interlaced PNG is not supported");
+            } else if (std::memcmp(type, "PLTE", 4) == 0) {
+                for (uint32_t i = 0; i + 2 < length; i += 3) {
+                    palette.push_back(body[i] | body[i + 1] << 8 | body[i + 2] << 16 | 0xFF000000u);
+                }
+            } else if (std::memcmp(type, "tRNS", 4) == 0) {
+                if (color_type == 3) {
+                    for (uint32_t i = 0; i < length && i < palette.size(); ++i) {
+                        palette[i] = (palette[i] & 0x00FFFFFFu) | uint32_t(body[i]) << 24;
+                    }
+                } else {
+                    for (uint32_t i = 0; i * 2 + 1 < length && i < 3; ++i) transparent[i] = body[i * 2] << 8 | body[i * 2 + 1];
+                }
+            } else if (std::memcmp(type, "IDAT", 4) == 0) {
+                idat.insert(idat.end(), body, body + length);
+            } else if (std::memcmp(type, "IEND", 4) == 0) {
+                break;
+            }
+            pos += 12 + length;
+        }
+        
+        // Channels and the allowed bit depths (as a mask of depth bits)
+        // per color type, from the PNG specification's IHDR table
+        static const int CHANNELS[7] = {1, 0, 3, 1, 2, 0, 4};
+        static const int DEPTHS[7] = {1 | 2 | 4 | 8 | 16, 0, 8 | 16, 1 | 2 | 4 | 8, 8 | 16, 0, 8 | 16};
+        if (image.width <= 0 || image.height <= 0 || color_type > 6 || CHANNELS[color_type] == 0) {
+            throw std::runtime_error("Invalid PNG header");
+        }
+        if (depth == 0 || (depth & (depth - 1)) != 0 || (DEPTHS[color_type] & depth) == 0) {
+            throw std::runtime_error("Invalid PNG bit depth for color type");
+        }
+        if (color_type == 3 && palette.empty()) throw std::runtime_error("PNG palette missing");
+        
+        int channels = CHANNELS[color_type];
+        size_t bits_per_pixel = static_cast<size_t>(channels) * depth;
+        size_t stride = (bits_per_pixel * image.width + 7) / 8;
+        size_t bpp = std::max<size_t>(1, bits_per_pixel / 8);
+        std::vector<uint8_t> raw = Inflate::zlib(idat.data(), idat.size(), (stride + 1) * image.height);
+        if (raw.size() < (stride + 1) * image.height) throw std::runtime_error("Truncated PNG image data");
+        unfilter(raw.data(), stride, bpp, image.height);
+        
+        image.pixels.resize(static_cast<size_t>(image.width) * image.height);
+        int max_sample = (1 << depth) - 1;
+        for (int y = 0; y < image.height; ++y) {
+            const uint8_t* row = raw.data() + y * (stride + 1) + 1;
+            uint32_t* out = &image.pixels[static_cast<size_t>(y) * image.width];
+            auto sample = [&](size_t index) -> int {
+                if (depth == 8) return row[index];
+                if (depth == 16) return row[index * 2] << 8 | row[index * 2 + 1];
+                size_t bit = index * depth;
+                return (row[bit / 8] >> (8 - depth - bit % 8)) & max_sample;
+            };
+            auto scale = [&](int v) { return static_cast<uint32_t>(v * 255 / max_sample); };
+            
+            for (int x = 0; x < image.width; ++x) {
+                size_t i = static_cast<size_t>(x) * channels;
+                switch (color_type) {
+                    case 0: {
+                        int g = sample(i);
+                        uint32_t a = g == transparent[0] ? 0 : 255;
+                        out[x] = scale(g) * 0x010101u | a << 24;
+                        break;
+                    }
+                    case 2: {
+                        int r = sample(i), g = sample(i + 1), b = sample(i + 2);
+                        uint32_t a = (r == transparent[0] && g == transparent[1] && b == transparent[2]) ? 0 : 255;
+                        out[x] = scale(r) | scale(g) << 8 | scale(b) << 16 | a << 24;
+                        break;
+                    }
+                    case 3: {
+                        size_t index = static_cast<size_t>(sample(i));
+                        out[x] = index < palette.size() ? palette[index] : 0xFF000000u;
+                        break;
+                    }
+                    case 4:
+                        out[x] = scale(sample(i)) * 0x010101u | scale(sample(i + 1)) << 24;
+                        break;
+                    default:
+                        out[x] = scale(sample(i)) | scale(sample(i + 1)) << 8 | scale(sample(i + 2)) << 16 |
+                                 scale(sample(i + 3)) << 24;
+                        break;
+                }
+            }
+        }
+        return image;
     }
     
-    bool is_finished() const {
-        return elapsed >= duration;
+private:
+    static void check_dimensions(int width, int height) {
+        if (width > MAX_DIMENSION || height > MAX_DIMENSION) throw std::runtime_error("Image dimensions too large");
+    }
+    
+    // Reverses PNG scanline filters in place; each row keeps its leading
+    // filter byte
+    static void unfilter(uint8_t* data, size_t stride, size_t bpp, int height) {
+        const uint8_t* previous = nullptr;
+        for (int y = 0; y < height; ++y) {
+            uint8_t filter = data[0];
+            uint8_t* row = data + 1;
+            for (size_t i = 0; i < stride; ++i) {
+                int left = i >= bpp ? row[i - bpp] : 0;
+                int up = previous ? previous[i] : 0;
+                int up_left = previous && i >= bpp ? previous[i - bpp] : 0;
+                switch (filter) {
+                    case 0: break;
+                    case 1: row[i] += left; break;
+                    case 2: row[i] += up; break;
+                    case 3: row[i] += (left + up) >> 1; break;
+                    case 4: {
+                        int p = left + up - up_left;
+                        int pa = std::abs(p - left), pb = std::abs(p - up), pc = std::abs(p - up_left);
+                        row[i] += (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : up_left);
+                        break;
+                    }
+                    default: throw std::runtime_error("Invalid PNG filter type");
+                }
+            }
+            previous = row;
+            data += stride + 1;
+        }
     }
 };
 
-// Physics utilities
-class Physics {
+// Shelf-packed texture atlas. Each page is split into horizontal shelves;
+// an image goes on the existing shelf that wastes the least height, or
+// opens a new shelf, or a new page. Images larger than a page get a page
+// of their own.
+class TextureAtlas {
 public:
-    static bool check_collision_circle_circle(
-        const Vector2D& pos1, float radius1,
-        const Vector2D& pos2, float radius2) {
-        return pos1.distance(pos2) < (radius1 + radius2);
-    }
+    explicit TextureAtlas(int page_size = 1024) : page_size(page_size) {}
     
-    static bool check_collision_rect_rect(
-        const Rectangle& rect1, const Rectangle& rect2) {
+    // Throws when the placement would not fit AtlasRegion's 16-bit fields
+    AtlasRegion insert(const Image& image) {
+        int w = image.width, h = image.height;
+        if (w > UINT16_MAX || h > UINT16_MAX) throw std::runtime_error("Image too large for the texture atlas");
+        if (pages.size() > UINT16_MAX) throw std::runtime_error("Texture atlas is out of pages");
+        if (w > page_size || h > page_size) {
+            pages.push_back(Page{w, h, std::vector<uint32_t>(static_cast<size_t>(w) * h), {}, h});
+            return copy(image, static_cast<uint16_t>(pages.size() - 1), 0, 0);
+        }
+        
+        for (size_t p = 0; p < pages.size(); ++p) {
+            Page& page = pages[p];
+            Shelf* best = nullptr;
+            for (auto& shelf : page.shelves) {
+                if (shelf.height >= h && page.width - shelf.next_x >= w &&
+                    (!best || shelf.height < best->height)) {
+                    best = &shelf;
+                }
+            }
+            if (!best && page.height - page.next_y >= h && page.width >= w) {
+                page.shelves.push_back(Shelf{page.next_y, h, 0});
+                page.next_y += h;
+                best = &page.shelves.back();
+            }
+            if (best) {
+                int x = best->next_x;
+                best->next_x += w;
+                return copy(image, static_cast<uint16_t>(p), x, best->y);
+            }
+        }
+        
+        pages.push_back(Page{page_size, page_size,
+                             std::vector<uint32_t>(static_cast<size_t>(page_size) * page_size), {}, 0});
+        return insert(image);
+    }
+    
+    size_t page_count() const { return pages.size(); }
+    int page_width(size_t page) const { return pages[page].width; }
+    int page_height(size_t page) const { return pages[page].height; }
+    const uint32_t* page_pixels(size_t page) const { return pages[page].pixels.data(); }
+    
+private:
+    struct Shelf {
+        int y, height, next_x;
+    };
+    
+    struct Page {
+        int width, height;
+        std::vector<uint32_t> pixels;
+        std::vector<Shelf> shelves;
+        int next_y;
+    };
+    
+    int page_size;
+    std::vector<Page> pages;
+    
+    AtlasRegion copy(const Image& image, uint16_t page, int x, int y) {
+        Page& target = pages[page];
+        for (int row = 0; row < image.height; ++row) {
+            std::memcpy(&target.pixels[static_cast<size_t>(y + row) * target.width + x],
+                        &image.pixels[static_cast<size_t>(row) * image.width], image.width * 4);
+        }
+        return AtlasRegion{page, static_cast<uint16_t>(x), static_cast<uint16_t>(y),
+                           static_cast<uint16_t>(image.width), static_cast<uint16_t>(image.height)};
+    }
+};
+
+struct TextureHandle {
+    uint32_t id = 0;    // 0 means no texture
+    
+    bool valid() const { return id != 0; }
+};
+
+// Sprite class for game objects
+class Sprite {
+public:
+    Vector2D position;
+    Vector2D velocity;
+    Vector2D scale;
+    float rotation;
+    Color tint;
+    Rectangle bounds;
+    std::string texture_path;
+    TextureHandle texture;      // resolved from texture_path by AssetManager
+    bool visible;
+    int layer;
+    
+    // Position in the owning Window's layer bucket; maintained by Window
+    int bucket_layer = 0;
+    size_t bucket_slot = SIZE_MAX;
+    
+    Sprite(const std::string& texture = "", float x = 0, float y = 0)
+        : position(x, y), velocity(0, 0), scale(1, 1), rotation(0),
+          tint(Color::WHITE()), texture_path(texture), visible(true), layer(0) {
+        update_bounds();
+    }
+    
+    void update(float delta_time) {
+        position = position + velocity * delta_time;
+        update_bounds();
+    }
+    
+    void update_bounds() {
+        bounds = Rectangle(position.x, position.y, 32 * scale.x, 32 * scale.y);
+    }
+    
+    bool collides_with(const Sprite& other) const {
+        return bounds.intersects(other.bounds);
+    }
+    
+    void move_to(float x, float y) {
+        position = Vector2D(x, y);
+        update_bounds();
+    }
+    
+    void move_by(float dx, float dy) {
+        position = position + Vector2D(dx, dy);
+        update_bounds();
+    }
+};
+
+// Stable reference to a sprite in a SpriteWorld; the generation detects
+// handles whose sprite has been destroyed
+struct SpriteHandle {
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+    
+    bool operator==(const SpriteHandle& other) const {
+        return slot == other.slot && generation == other.generation;
+    }
+    bool operator!=(const SpriteHandle& other) const { return !(*this == other); }
+};
+
+// Decodes each texture path once and packs it into a shared atlas. load()
+// returns a handle immediately and queues the decode on a background
+// thread; update() runs once per frame on the game thread and copies
+// finished images into the atlas within an upload budget, so a burst of
+// loads never stalls a frame. Sprites refer to textures by handle.
+class AssetManager {
+public:
+    enum class State : uint8_t { PENDING, READY, FAILED };
+    
+    explicit AssetManager(int page_size = 1024) : texture_atlas(page_size), decoded(256) {
+        entries.emplace_back(); // id 0 is "no texture"
+        loader = std::thread([this]() { loader_loop(); });
+    }
+    
+    AssetManager(const AssetManager&) = delete;
+    AssetManager& operator=(const AssetManager&) = delete;
+    
+    ~AssetManager() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        loader.join();
+    }
+    
+    TextureHandle load(const std::string& path) {
+        if (path.empty()) return TextureHandle{};
+        auto found = by_path.find(path);
+        if (found != by_path.end()) return TextureHandle{found->second};
+        
+        uint32_t id = static_cast<uint32_t>(entries.size());
+        entries.push_back(Entry{path, State::PENDING, AtlasRegion{}, ""});
+        by_path.emplace(path, id);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back(Request{id, path});
+            outstanding++;
+        }
+        wake.notify_one();
+        return TextureHandle{id};
+    }
+    
+    // Decodes and uploads on the calling thread; a queued background
+    // decode of the same path is discarded when it arrives
+    TextureHandle load_now(const std::string& path) {
+        TextureHandle handle = load(path);
+        if (!handle.valid() || entries[handle.id].state != State::PENDING) return handle;
+        try {
+            upload(handle.id, ImageDecoder::load(path));
+        } catch (const std::exception& e) {
+            fail(handle.id, e.what());
+        }
+        return handle;
+    }
+    
+    // Resolves the sprite's texture_path to a handle
+    void bind(Sprite& sprite) {
+        sprite.texture = load(sprite.texture_path);
+    }
+    
+    // Uploads decoded images until budget_bytes of pixels have been copied
+    // (at least one image per call); returns how many were uploaded
+    size_t update(size_t budget_bytes = 4 << 20) {
+        size_t uploaded = 0, spent = 0;
+        Decoded item;
+        while (spent < budget_bytes && decoded.try_pop(item)) {
+            if (item.image) {
+                spent += item.image->pixels.size() * 4;
+                if (entries[item.id].state == State::PENDING) {
+                    upload(item.id, *item.image);
+                    uploaded++;
+                }
+            } else if (entries[item.id].state == State::PENDING) {
+                fail(item.id, item.error);
+            }
+        }
+        return uploaded;
+    }
+    
+    // Blocks until every queued load has been decoded and uploaded
+    void finish() {
+        while (true) {
+            update(SIZE_MAX);
+            std::unique_lock<std::mutex> lock(mutex);
+            if (outstanding == 0) break;
+            loaded.wait(lock, [this]() { return outstanding == 0 || decoded.size() != 0; });
+        }
+        update(SIZE_MAX);
+    }
+    
+    State state(TextureHandle handle) const {
+        return handle.id < entries.size() ? entries[handle.id].state : State::FAILED;
+    }
+    
+    const std::string& error(TextureHandle handle) const { return entries[handle.id].error; }
+    const std::string& path(TextureHandle handle) const { return entries[handle.id].path; }
+    
+    // Atlas placement once READY, otherwise nullptr
+    const AtlasRegion* region(TextureHandle handle) const {
+        if (handle.id == 0 || handle.id >= entries.size() || entries[handle.id].state != State::READY) {
+            return nullptr;
+        }
+        return &entries[handle.id].region;
+    }
+    
+    const TextureAtlas& atlas() const { return texture_atlas; }
+    size_t texture_count() const { return entries.size() - 1; }
+    
+private:
+    struct Entry {
+        std::string path;
+        State state;
+        AtlasRegion region;
+        std::string error;
+    };
+    
+    struct Request {
+        uint32_t id;
+        std::string path;
+    };
+    
+    struct Decoded {
+        uint32_t id = 0;
+        std::shared_ptr<Image> image;   // null on failure
+        std::string error;
+    };
+    
+    TextureAtlas texture_atlas;
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, uint32_t> by_path;
+    
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable loaded;     // signalled as outstanding drops
+    std::deque<Request> requests;
+    size_t outstanding = 0;     // requested but not yet pushed to decoded
+    bool stopping = false;
+    SpscQueue<Decoded> decoded;
+    std::thread loader;
+    
+    void upload(uint32_t id, const Image& image) {
+        try {
+            entries[id].region = texture_atlas.insert(image);
+            entries[id].state = State::READY;
+        } catch (const std::exception& e) {
+            fail(id, e.what());
+        }
+    }
+    
+    void fail(uint32_t id, const std::string& message) {
+        entries[id].state = State::FAILED;
+        entries[id].error = message;
+    }
+    
+    void loader_loop() {
+        while (true) {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || !requests.empty(); });
+                if (stopping) return;
+                request = std::move(requests.front());
+                requests.pop_front();
+            }
+            
+            Decoded item;
+            item.id = request.id;
+            try {
+                item.image = std::make_shared<Image>(ImageDecoder::load(request.path));
+            } catch (const std::exception& e) {
+                item.error = e.what();
+            }
+            while (!decoded.try_push(item)) {
+                std::this_thread::yield();
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping) return;
+            }
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                outstanding--;
+            }
+            loaded.notify_all();
+        }
+    }
+};
+
+// Structure-of-arrays sprite storage. Per-frame fields live in parallel
+// dense arrays indexed 0..size()-1 so update() streams through memory
+// instead of chasing shared_ptrs. Removal swaps the last sprite into the
+// hole; handles map to dense indices through a slot table.
+class SpriteWorld {
+public:
+    static constexpr float BASE_SIZE = 32.0f; // same footprint as Sprite::update_bounds
+    
+    std::vector<float> x, y;
+    std::vector<float> vx, vy;
+    std::vector<float> scale_x, scale_y;
+    std::vector<float> rotation;
+    std::vector<float> bounds_x, bounds_y, bounds_w, bounds_h;
+    std::vector<uint32_t> tint;     // Framebuffer::pack()ed RGBA8
+    std::vector<uint8_t> visible;
+    
+    size_t size() const { return x.size(); }
+    
+    SpriteHandle create(float px, float py, int layer = 0) {
+        uint32_t slot;
+        if (!free_slots.empty()) {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        } else {
+            slot = static_cast<uint32_t>(slot_dense.size());
+            slot_dense.push_back(0);
+            slot_generation.push_back(0);
+            slot_layer.push_back(0);
+            slot_layer_pos.push_back(0);
+        }
+        
+        slot_dense[slot] = static_cast<uint32_t>(size());
+        dense_slot.push_back(slot);
+        x.push_back(px);
+        y.push_back(py);
+        vx.push_back(0);
+        vy.push_back(0);
+        scale_x.push_back(1);
+        scale_y.push_back(1);
+        rotation.push_back(0);
+        bounds_x.push_back(px);
+        bounds_y.push_back(py);
+        bounds_w.push_back(BASE_SIZE);
+        bounds_h.push_back(BASE_SIZE);
+        tint.push_back(0xFFFFFFFFu);
+        visible.push_back(1);
+        
+        add_to_layer(slot, layer);
+        return SpriteHandle{slot, slot_generation[slot]};
+    }
+    
+    void destroy(SpriteHandle handle) {
+        if (!alive(handle)) return;
+        uint32_t slot = handle.slot;
+        uint32_t hole = slot_dense[slot];
+        uint32_t last = static_cast<uint32_t>(size() - 1);
+        
+        if (hole != last) {
+            move_dense(last, hole);
+            slot_dense[dense_slot[hole]] = hole;
+        }
+        pop_dense();
+        
+        remove_from_layer(slot);
+        slot_generation[slot]++;
+        free_slots.push_back(slot);
+    }
+    
+    bool alive(SpriteHandle handle) const {
+        return handle.slot < slot_generation.size() && slot_generation[handle.slot] == handle.generation &&
+               slot_dense[handle.slot] < size() && dense_slot[slot_dense[handle.slot]] == handle.slot;
+    }
+    
+    // Dense array index of a live sprite
+    size_t index(SpriteHandle handle) const {
+        if (!alive(handle)) throw std::runtime_error("Stale sprite handle");
+        return slot_dense[handle.slot];
+    }
+    
+    SpriteHandle handle(size_t index) const {
+        uint32_t slot = dense_slot[index];
+        return SpriteHandle{slot, slot_generation[slot]};
+    }
+    
+    size_t dense_index(uint32_t slot) const { return slot_dense[slot]; }
+    
+    int layer(SpriteHandle handle) const { return slot_layer[handle.slot]; }
+    
+    void set_layer(SpriteHandle handle, int layer) {
+        if (!alive(handle) || slot_layer[handle.slot] == layer) return;
+        remove_from_layer(handle.slot);
+        add_to_layer(handle.slot, layer);
+    }
+    
+    void set_tint(SpriteHandle handle, const Color& color) {
+        tint[index(handle)] = Framebuffer::pack(color);
+    }
+    
+    // Slots per layer, in draw order
+    const std::map<int, std::vector<uint32_t>>& layer_slots() const { return layers; }
+    
+    // Integrates positions and recomputes bounds for every sprite
+    void update(float delta_time) {
+        size_t n = size();
+        size_t i = 0;
+#if defined(__AVX__)
+        const __m256 dt8 = _mm256_set1_ps(delta_time);
+        const __m256 base8 = _mm256_set1_ps(BASE_SIZE);
+        for (; i + 8 <= n; i += 8) {
+            __m256 px = _mm256_add_ps(_mm256_loadu_ps(&x[i]), _mm256_mul_ps(_mm256_loadu_ps(&vx[i]), dt8));
+            __m256 py = _mm256_add_ps(_mm256_loadu_ps(&y[i]), _mm256_mul_ps(_mm256_loadu_ps(&vy[i]), dt8));
+            _mm256_storeu_ps(&x[i], px);
+            _mm256_storeu_ps(&y[i], py);
+            _mm256_storeu_ps(&bounds_x[i], px);
+            _mm256_storeu_ps(&bounds_y[i], py);
+            _mm256_storeu_ps(&bounds_w[i], _mm256_mul_ps(_mm256_loadu_ps(&scale_x[i]), base8));
+            _mm256_storeu_ps(&bounds_h[i], _mm256_mul_ps(_mm256_loadu_ps(&scale_y[i]), base8));
+        }
+#endif
+#if defined(__SSE2__)
+        const __m128 dt4 = _mm_set1_ps(delta_time);
+        const __m128 base4 = _mm_set1_ps(BASE_SIZE);
+        for (; i + 4 <= n; i += 4) {
+            __m128 px = _mm_add_ps(_mm_loadu_ps(&x[i]), _mm_mul_ps(_mm_loadu_ps(&vx[i]), dt4));
+            __m128 py = _mm_add_ps(_mm_loadu_ps(&y[i]), _mm_mul_ps(_mm_loadu_ps(&vy[i]), dt4));
+            _mm_storeu_ps(&x[i], px);
+            _mm_storeu_ps(&y[i], py);
+            _mm_storeu_ps(&bounds_x[i], px);
+            _mm_storeu_ps(&bounds_y[i], py);
+            _mm_storeu_ps(&bounds_w[i], _mm_mul_ps(_mm_loadu_ps(&scale_x[i]), base4));
+            _mm_storeu_ps(&bounds_h[i], _mm_mul_ps(_mm_loadu_ps(&scale_y[i]), base4));
+        }
+#endif
+        for (; i < n; ++i) {
+            x[i] += vx[i] * delta_time;
+            y[i] += vy[i] * delta_time;
+            bounds_x[i] = x[i];
+            bounds_y[i] = y[i];
+            bounds_w[i] = scale_x[i] * BASE_SIZE;
+            bounds_h[i] = scale_y[i] * BASE_SIZE;
+        }
+    }
+    
+    // Call after writing positions or scales directly
+    void update_bounds() {
+        update(0.0f);
+    }
+    
+    // Same, for one sprite by dense index
+    void update_bounds(size_t i) {
+        bounds_x[i] = x[i];
+        bounds_y[i] = y[i];
+        bounds_w[i] = scale_x[i] * BASE_SIZE;
+        bounds_h[i] = scale_y[i] * BASE_SIZE;
+    }
+    
+    Rectangle bounds(size_t i) const {
+        return Rectangle(bounds_x[i], bounds_y[i], bounds_w[i], bounds_h[i]);
+    }
+    
+private:
+    std::vector<uint32_t> slot_dense;
+    std::vector<uint32_t> slot_generation;
+    std::vector<int> slot_layer;
+    std::vector<uint32_t> slot_layer_pos;
+    std::vector<uint32_t> dense_slot;
+    std::vector<uint32_t> free_slots;
+    std::map<int, std::vector<uint32_t>> layers;
+    
+    void add_to_layer(uint32_t slot, int layer) {
+        auto& bucket = layers[layer];
+        slot_layer[slot] = layer;
+        slot_layer_pos[slot] = static_cast<uint32_t>(bucket.size());
+        bucket.push_back(slot);
+    }
+    
+    void remove_from_layer(uint32_t slot) {
+        auto it = layers.find(slot_layer[slot]);
+        auto& bucket = it->second;
+        uint32_t pos = slot_layer_pos[slot];
+        bucket[pos] = bucket.back();
+        slot_layer_pos[bucket[pos]] = pos;
+        bucket.pop_back();
+        if (bucket.empty()) layers.erase(it);
+    }
+    
+    void move_dense(size_t from, size_t to) {
+        x[to] = x[from]; y[to] = y[from];
+        vx[to] = vx[from]; vy[to] = vy[from];
+        scale_x[to] = scale_x[from]; scale_y[to] = scale_y[from];
+        rotation[to] = rotation[from];
+        bounds_x[to] = bounds_x[from]; bounds_y[to] = bounds_y[from];
+        bounds_w[to] = bounds_w[from]; bounds_h[to] = bounds_h[from];
+        tint[to] = tint[from];
+        visible[to] = visible[from];
+        dense_slot[to] = dense_slot[from];
+    }
+    
+    void pop_dense() {
+        x.pop_back(); y.pop_back();
+        vx.pop_back(); vy.pop_back();
+        scale_x.pop_back(); scale_y.pop_back();
+        rotation.pop_back();
+        bounds_x.pop_back(); bounds_y.pop_back();
+        bounds_w.pop_back(); bounds_h.pop_back();
+        tint.pop_back();
+        visible.pop_back();
+        dense_slot.pop_back();
+    }
+};
+
+// Uniform-grid spatial hash broadphase over axis-aligned boxes. Boxes are
+// inserted with caller-chosen ids, then build() counting-sorts (cell, box)
+// entries into a flat bucket table, so a rebuild per frame allocates
+// nothing once capacities have grown. Cell size should be about the size
+// of a typical object.
+class SpatialHash {
+public:
+    explicit SpatialHash(float cell_size = 64.0f)
+        : cell_size(cell_size), inverse_cell(1.0f / cell_size) {}
+    
+    void clear() {
+        boxes.clear();
+        ids.clear();
+        built = false;
+    }
+    
+    void insert(uint32_t id, const Rectangle& bounds) {
+        ids.push_back(id);
+        boxes.push_back(bounds);
+        built = false;
+    }
+    
+    size_t size() const { return boxes.size(); }
+    
+    void build() {
+        size_t total = 0;
+        float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+        for (const auto& box : boxes) {
+            CellRange r = cells(box);
+            total += static_cast<size_t>(r.x1 - r.x0 + 1) * (r.y1 - r.y0 + 1);
+            min_x = std::min(min_x, box.x);
+            min_y = std::min(min_y, box.y);
+            max_x = std::max(max_x, box.x + box.width);
+            max_y = std::max(max_y, box.y + box.height);
+        }
+        extent = Rectangle(min_x, min_y, max_x - min_x, max_y - min_y);
+        
+        size_t bucket_count = 16;
+        while (bucket_count < total * 2) bucket_count <<= 1;
+        bucket_mask = bucket_count - 1;
+        bucket_start.assign(bucket_count + 1, 0);
+        entries.resize(total);
+        
+        for_each_entry([&](int cx, int cy, uint32_t) { bucket_start[bucket(cx, cy) + 1]++; });
+        for (size_t b = 0; b < bucket_count; ++b) bucket_start[b + 1] += bucket_start[b];
+        
+        cursor.assign(bucket_start.begin(), bucket_start.end() - 1);
+        for_each_entry([&](int cx, int cy, uint32_t index) {
+            entries[cursor[bucket(cx, cy)]++] = Entry{cx, cy, index};
+        });
+        
+        stamps.assign(boxes.size(), 0);
+        stamp = 0;
+        built = true;
+    }
+    
+    // Every overlapping pair exactly once, as (smaller id, larger id). A
+    // pair is reported only from the cell holding the minimum corner of
+    // the two boxes' intersection, which needs no dedup set.
+    std::vector<std::pair<uint32_t, uint32_t>> candidate_pairs() {
+        if (!built) build();
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        for (size_t b = 0; b + 1 < bucket_start.size(); ++b) {
+            for (uint32_t i = bucket_start[b]; i < bucket_start[b + 1]; ++i) {
+                const Entry& e = entries[i];
+                const Rectangle& a = boxes[e.index];
+                for (uint32_t j = i + 1; j < bucket_start[b + 1]; ++j) {
+                    const Entry& f = entries[j];
+                    if (f.cx != e.cx || f.cy != e.cy) continue;
+                    const Rectangle& c = boxes[f.index];
+                    if (!a.intersects(c)) continue;
+                    if (cell_of(std::max(a.x, c.x)) != e.cx || cell_of(std::max(a.y, c.y)) != e.cy) continue;
+                    
+                    uint32_t id_a = ids[e.index], id_b = ids[f.index];
+                    pairs.emplace_back(std::min(id_a, id_b), std::max(id_a, id_b));
+                }
+            }
+        }
+        return pairs;
+    }
+    
+    std::vector<uint32_t> query_region(const Rectangle& region) {
+        if (!built) build();
+        std::vector<uint32_t> result;
+        uint32_t mark = next_stamp();
+        CellRange r = cells(region);
+        for (int cy = r.y0; cy <= r.y1; ++cy) {
+            for (int cx = r.x0; cx <= r.x1; ++cx) {
+                visit_cell(cx, cy, [&](uint32_t index) {
+                    if (stamps[index] == mark) return;
+                    stamps[index] = mark;
+                    if (boxes[index].intersects(region)) result.push_back(ids[index]);
+                });
+            }
+        }
+        return result;
+    }
+    
+    // Ids of boxes hit by the ray within max_distance, nearest first.
+    // Cells are walked with a 2D DDA so only cells on the ray are visited,
+    // and only over the stretch of the ray inside the boxes' extent.
+    std::vector<uint32_t> query_ray(const Vector2D& origin, const Vector2D& direction, float max_distance) {
+        if (!built) build();
+        if (boxes.empty() || std::isnan(max_distance)) return {};
+        if (!std::isfinite(origin.x) || !std::isfinite(origin.y) ||
+            !std::isfinite(direction.x) || !std::isfinite(direction.y)) return {};
+        std::vector<std::pair<float, uint32_t>> hits;
+        Vector2D dir = direction.normalized();
+        if (dir.x == 0 && dir.y == 0) return {};
+        
+        float enter, leave;
+        if (!ray_span(extent, origin, dir, enter, leave) || enter > max_distance) return {};
+        max_distance = std::min(max_distance, leave);
+        
+        // Start at the cell where the ray enters the extent
+        uint32_t mark = next_stamp();
+        CellRange range = cells(extent);
+        int cx = std::clamp(cell_of(origin.x + dir.x * enter), range.x0, range.x1);
+        int cy = std::clamp(cell_of(origin.y + dir.y * enter), range.y0, range.y1);
+        int step_x = dir.x > 0 ? 1 : -1, step_y = dir.y > 0 ? 1 : -1;
+        float delta_x = dir.x != 0 ? std::abs(cell_size / dir.x) : INFINITY;
+        float delta_y = dir.y != 0 ? std::abs(cell_size / dir.y) : INFINITY;
+        float next_x = dir.x != 0 ? ((cx + (step_x > 0 ? 1 : 0)) * cell_size - origin.x) / dir.x : INFINITY;
+        float next_y = dir.y != 0 ? ((cy + (step_y > 0 ? 1 : 0)) * cell_size - origin.y) / dir.y : INFINITY;
+        
+        float t = enter;
+        while (t <= max_distance && cx >= range.x0 && cx <= range.x1 && cy >= range.y0 && cy <= range.y1) {
+            visit_cell(cx, cy, [&](uint32_t index) {
+                if (stamps[index] == mark) return;
+                stamps[index] = mark;
+                float distance;
+                if (ray_hits(boxes[index], origin, dir, distance) && distance <= max_distance) {
+                    hits.emplace_back(distance, ids[index]);
+                }
+            });
+            
+            if (next_x < next_y) {
+                t = next_x;
+                next_x += delta_x;
+                cx += step_x;
+            } else {
+                t = next_y;
+                next_y += delta_y;
+                cy += step_y;
+            }
+        }
+        
+        std::sort(hits.begin(), hits.end());
+        std::vector<uint32_t> result;
+        for (const auto& hit : hits) result.push_back(hit.second);
+        return result;
+    }
+    
+    // Slab test; distance is 0 when the origin is inside the box
+    static bool ray_hits(const Rectangle& box, const Vector2D& origin, const Vector2D& dir, float& distance) {
+        float leave;
+        return ray_span(box, origin, dir, distance, leave);
+    }
+    
+private:
+    struct Entry {
+        int32_t cx, cy;
+        uint32_t index;
+    };
+    
+    struct CellRange {
+        int x0, y0, x1, y1;
+    };
+    
+    float cell_size;
+    float inverse_cell;
+    std::vector<Rectangle> boxes;
+    std::vector<uint32_t> ids;
+    std::vector<uint32_t> bucket_start;
+    std::vector<uint32_t> cursor;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> stamps;
+    Rectangle extent;
+    uint32_t stamp = 0;
+    size_t bucket_mask = 0;
+    bool built = false;
+    
+    // Distances along the ray where it enters and leaves the box
+    static bool ray_span(const Rectangle& box, const Vector2D& origin, const Vector2D& dir,
+                         float& enter, float& leave) {
+        float t_min = 0, t_max = INFINITY;
+        const float lo[2] = {box.x, box.y};
+        const float hi[2] = {box.x + box.width, box.y + box.height};
+        const float o[2] = {origin.x, origin.y};
+        const float d[2] = {dir.x, dir.y};
+        for (int axis = 0; axis < 2; ++axis) {
+            if (d[axis] == 0) {
+                if (o[axis] < lo[axis] || o[axis] > hi[axis]) return false;
+                continue;
+            }
+            float t1 = (lo[axis] - o[axis]) / d[axis];
+            float t2 = (hi[axis] - o[axis]) / d[axis];
+            if (t1 > t2) std::swap(t1, t2);
+            t_min = std::max(t_min, t1);
+            t_max = std::min(t_max, t2);
+            if (t_min > t_max) return false;
+        }
+        enter = t_min;
+        leave = t_max;
+        return true;
+    }
+    
+    int cell_of(float v) const { return static_cast<int>(std::floor(v * inverse_cell)); }
+    
+    CellRange cells(const Rectangle& b) const {
+        return {cell_of(b.x), cell_of(b.y), cell_of(b.x + b.width), cell_of(b.y + b.height)};
+    }
+    
+    size_t bucket(int cx, int cy) const {
+        uint32_t h = static_cast<uint32_t>(cx) * 73856093u ^ static_cast<uint32_t>(cy) * 19349663u;
+        return h & bucket_mask;
+    }
+    
+    uint32_t next_stamp() {
+        if (++stamp == 0) {
+            std::fill(stamps.begin(), stamps.end(), 0);
+            stamp = 1;
+        }
+        return stamp;
+    }
+    
+    template<typename F>
+    void for_each_entry(F&& fn) const {
+        for (uint32_t i = 0; i < boxes.size(); ++i) {
+            CellRange r = cells(boxes[i]);
+            for (int cy = r.y0; cy <= r.y1; ++cy) {
+                for (int cx = r.x0; cx <= r.x1; ++cx) fn(cx, cy, i);
+            }
+        }
+    }
+    
+    template<typename F>
+    void visit_cell(int cx, int cy, F&& fn) const {
+        size_t b = bucket(cx, cy);
+        for (uint32_t i = bucket_start[b]; i < bucket_start[b + 1]; ++i) {
+            if (entries[i].cx == cx && entries[i].cy == cy) fn(entries[i].index);
+        }
+    }
+};
+
+// Sort-and-sweep broadphase along x; ids are indices into the box list.
+// The order from the previous update is kept, so the insertion sort is
+// close to linear when objects move coherently between frames.
+class SweepAndPrune {
+public:
+    void update(const std::vector<Rectangle>& new_boxes) {
+        boxes = new_boxes;
+        if (order.size() != boxes.size()) {
+            order.resize(boxes.size());
+            for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+        }
+        
+        for (size_t i = 1; i < order.size(); ++i) {
+            uint32_t value = order[i];
+            float key = boxes[value].x;
+            size_t j = i;
+            while (j > 0 && boxes[order[j - 1]].x > key) {
+                order[j] = order[j - 1];
+                --j;
+            }
+            order[j] = value;
+        }
+    }
+    
+    std::vector<std::pair<uint32_t, uint32_t>> candidate_pairs() const {
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        for (size_t i = 0; i < order.size(); ++i) {
+            const Rectangle& a = boxes[order[i]];
+            float right = a.x + a.width;
+            for (size_t j = i + 1; j < order.size() && boxes[order[j]].x < right; ++j) {
+                if (a.intersects(boxes[order[j]])) {
+                    pairs.emplace_back(std::min(order[i], order[j]), std::max(order[i], order[j]));
+                }
+            }
+        }
+        return pairs;
+    }
+    
+    std::vector<uint32_t> query_region(const Rectangle& region) const {
+        std::vector<uint32_t> result;
+        float right = region.x + region.width;
+        for (size_t i = 0; i < order.size() && boxes[order[i]].x < right; ++i) {
+            if (boxes[order[i]].intersects(region)) result.push_back(order[i]);
+        }
+        return result;
+    }
+    
+private:
+    std::vector<Rectangle> boxes;
+    std::vector<uint32_t> order;
+};
+
+// Input handling system
+enum class KeyCode : uint16_t {
+    A, B, C, D, E, F, G, H, I, J, K, L, M, N, O, P, Q, R, S, T, U, V, W, X, Y, Z,
+    NUM_0, NUM_1, NUM_2, NUM_3, NUM_4, NUM_5, NUM_6, NUM_7, NUM_8, NUM_9,
+    SPACE, ENTER, ESCAPE, TAB, BACKSPACE,
+    LEFT, RIGHT, UP, DOWN,
+    SHIFT, CONTROL, ALT,
+    F1, F2, F3, F4, F5, F6, F7, F8, F9, F10, F11, F12,
+    COUNT,
+    UNKNOWN = COUNT
+};
+
+struct InputEvent {
+    enum class Type : uint8_t { KEY_DOWN, KEY_UP, MOUSE_MOVE, MOUSE_DOWN, MOUSE_UP };
+    
+    Type type = Type::KEY_DOWN;
+    uint16_t code = 0;      // KeyCode or MouseButton
+    float x = 0, y = 0;     // mouse position for mouse events
+};
+
+// Key and mouse state as flat bitsets. Platform code posts InputEvents
+// from any single thread; update() runs once per frame on the game thread,
+// drains the queue, and computes pressed/released edges so queries are a
+// bit test. Recording captures each frame's events for exact replay.
+class Input {
+public:
+    enum class KeyState { UP, DOWN, PRESSED, RELEASED };
+    enum class MouseButton { LEFT, RIGHT, MIDDLE };
+    
+    static constexpr size_t KEY_COUNT = static_cast<size_t>(KeyCode::COUNT);
+    static constexpr size_t BUTTON_COUNT = 3;
+    
+    struct RecordedEvent {
+        uint64_t frame;
+        InputEvent event;
+    };
+    
+    static inline Vector2D mouse_position;
+    static inline uint64_t frame = 0;
+    
+    // Producer side; returns false if the queue is full and the event was
+    // dropped
+    static bool post(const InputEvent& event) {
+        return events.try_push(event);
+    }
+    
+    static void update() {
+        previous_keys = keys;
+        previous_buttons = buttons;
+        
+        InputEvent event;
+        if (replaying) {
+            while (replay_position < replay.size() && replay[replay_position].frame <= frame) {
+                apply(replay[replay_position++].event);
+            }
+            while (events.try_pop(event)) {}
+        } else {
+            while (events.try_pop(event)) {
+                apply(event);
+                if (recording) recorded.push_back(RecordedEvent{frame, event});
+            }
+        }
+        frame++;
+    }
+    
+    static bool is_key_down(KeyCode key) { return test(keys, key); }
+    static bool is_key_pressed(KeyCode key) { return test(keys, key) && !test(previous_keys, key); }
+    static bool is_key_released(KeyCode key) { return !test(keys, key) && test(previous_keys, key); }
+    
+    static KeyState get_key_state(KeyCode key) {
+        bool now = test(keys, key), before = test(previous_keys, key);
+        if (now) return before ? KeyState::DOWN : KeyState::PRESSED;
+        return before ? KeyState::RELEASED : KeyState::UP;
+    }
+    
+    // Name-based queries resolve the name without allocating; prefer the
+    // KeyCode overloads in hot paths
+    static bool is_key_down(std::string_view key) { return is_key_down(key_code(key)); }
+    static bool is_key_pressed(std::string_view key) { return is_key_pressed(key_code(key)); }
+    static bool is_key_released(std::string_view key) { return is_key_released(key_code(key)); }
+    
+    static bool is_mouse_down(MouseButton button) {
+        return buttons.test(static_cast<size_t>(button));
+    }
+    
+    static bool is_mouse_pressed(MouseButton button) {
+        size_t bit = static_cast<size_t>(button);
+        return buttons.test(bit) && !previous_buttons.test(bit);
+    }
+    
+    static Vector2D get_mouse_position() {
+        return mouse_position;
+    }
+    
+    // Case-insensitive; names are lowercased into a stack buffer and looked
+    // up in a sorted table
+    static KeyCode key_code(std::string_view name) {
+        static constexpr std::pair<std::string_view, KeyCode> NAMES[] = {
+            {"alt", KeyCode::ALT}, {"backspace", KeyCode::BACKSPACE}, {"control", KeyCode::CONTROL},
+            {"ctrl", KeyCode::CONTROL}, {"down", KeyCode::DOWN}, {"enter", KeyCode::ENTER},
+            {"esc", KeyCode::ESCAPE}, {"escape", KeyCode::ESCAPE}, {"left", KeyCode::LEFT},
+            {"return", KeyCode::ENTER}, {"right", KeyCode::RIGHT}, {"shift", KeyCode::SHIFT},
+            {"space", KeyCode::SPACE}, {"tab", KeyCode::TAB}, {"up", KeyCode::UP}
+        };
+        
+        char buffer[16];
+        if (name.empty() || name.size() > sizeof(buffer)) return KeyCode::UNKNOWN;
+        for (size_t i = 0; i < name.size(); ++i) {
+            buffer[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(name[i])));
+        }
+        std::string_view lower(buffer, name.size());
+        
+        if (lower.size() == 1) {
+            char c = lower[0];
+            if (c >= 'a' && c <= 'z') return static_cast<KeyCode>(c - 'a');
+            if (c >= '0' && c <= '9') return static_cast<KeyCode>(static_cast<int>(KeyCode::NUM_0) + (c - '0'));
+            if (c == ' ') return KeyCode::SPACE;
+            return KeyCode::UNKNOWN;
+        }
+        if (lower[0] == 'f' && lower.size() <= 3) {
+            int n = 0;
+            for (char c : lower.substr(1)) {
+                if (c < '0' || c > '9') return KeyCode::UNKNOWN;
+                n = n * 10 + (c - '0');
+            }
+            if (n >= 1 && n <= 12) return static_cast<KeyCode>(static_cast<int>(KeyCode::F1) + n - 1);
+            return KeyCode::UNKNOWN;
+        }
+        auto it = std::lower_bound(std::begin(NAMES), std::end(NAMES), lower,
+                                   [](const auto& entry, std::string_view key) { return entry.first < key; });
+        return it != std::end(NAMES) && it->first == lower ? it->second : KeyCode::UNKNOWN;
+    }
+    
+    // Clears key and mouse state (and queued events), e.g. between replays
+    static void reset() {
+        keys.reset();
+        previous_keys.reset();
+        buttons.reset();
+        previous_buttons.reset();
+        InputEvent event;
+        while (events.try_pop(event)) {}
+        frame = 0;
+    }
+    
+    static void start_recording() {
+        recorded.clear();
+        recording = true;
+    }
+    
+    static std::vector<RecordedEvent> stop_recording() {
+        recording = false;
+        return std::move(recorded);
+    }
+    
+    // Feeds the recorded events back frame by frame in place of live
+    // input; frames count from the next update()
+    static void start_replay(std::vector<RecordedEvent> events_to_replay) {
+        reset();
+        replay = std::move(events_to_replay);
+        replay_position = 0;
+        replaying = true;
+    }
+    
+    static void stop_replay() { replaying = false; }
+    static bool is_replaying() { return replaying && replay_position < replay.size(); }
+    
+    // Events are written field by field into zeroed records, so struct
+    // padding never carries stale memory into the file
+    static bool save_recording(const std::string& path, const std::vector<RecordedEvent>& events_to_save) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) return false;
+        uint64_t count = events_to_save.size();
+        std::vector<char> records(count * sizeof(RecordedEvent), 0);
+        for (size_t i = 0; i < events_to_save.size(); ++i) {
+            const RecordedEvent& source = events_to_save[i];
+            char* record = records.data() + i * sizeof(RecordedEvent);
+            char* event = record + offsetof(RecordedEvent, event);
+            std::memcpy(record + offsetof(RecordedEvent, frame), &source.frame, sizeof(source.frame));
+            std::memcpy(event + offsetof(InputEvent, type), &source.event.type, sizeof(source.event.type));
+            std::memcpy(event + offsetof(InputEvent, code), &source.event.code, sizeof(source.event.code));
+            std::memcpy(event + offsetof(InputEvent, x), &source.event.x, sizeof(source.event.x));
+            std::memcpy(event + offsetof(InputEvent, y), &source.event.y, sizeof(source.event.y));
+        }
+        file.write("RPIN", 4);
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        file.write(records.data(), records.size());
+        return static_cast<bool>(file);
+    }
+    
+    static std::vector<RecordedEvent> load_recording(const std::string& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        char magic[4];
+        uint64_t count = 0;
+        uint64_t size = file ? static_cast<uint64_t>(file.tellg()) : 0;
+        file.seekg(0);
+        if (!file.read(magic, 4) || std::memcmp(magic, "RPIN", 4) != 0 ||
+            !file.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+            throw std::runtime_error("Not an input recording: " + path);
+        }
+        // Check the count against the file before allocating for it
+        if (count > (size - 4 - sizeof(count)) / sizeof(RecordedEvent)) {
+            throw std::runtime_error("Truncated input recording: " + path);
+        }
+        std::vector<RecordedEvent> result(count);
+        if (!file.read(reinterpret_cast<char*>(result.data()), count * sizeof(RecordedEvent))) {
+            throw std::runtime_error("Truncated input recording: " + path);
+        }
+        return result;
+    }
+    
+private:
+    static inline std::bitset<KEY_COUNT> keys, previous_keys;
+    static inline std::bitset<BUTTON_COUNT> buttons, previous_buttons;
+    static inline SpscQueue<InputEvent> events{1024};
+    static inline bool recording = false, replaying = false;
+    static inline std::vector<RecordedEvent> recorded, replay;
+    static inline size_t replay_position = 0;
+    
+    static bool test(const std::bitset<KEY_COUNT>& bits, KeyCode key) {
+        return key < KeyCode::COUNT && bits.test(static_cast<size_t>(key));
+    }
+    
+    static void apply(const InputEvent& event) {
+        switch (event.type) {
+            case InputEvent::Type::KEY_DOWN:
+            case InputEvent::Type::KEY_UP:
+                if (event.code < KEY_COUNT) keys.set(event.code, event.type == InputEvent::Type::KEY_DOWN);
+                break;
+            case InputEvent::Type::MOUSE_DOWN:
+            case InputEvent::Type::MOUSE_UP:
+                if (event.code < BUTTON_COUNT) buttons.set(event.code, event.type == InputEvent::Type::MOUSE_DOWN);
+                mouse_position = Vector2D(event.x, event.y);
+                break;
+            case InputEvent::Type::MOUSE_MOVE:
+                mouse_position = Vector2D(event.x, event.y);
+                break;
+        }
+    }
+};
+
+// Window class for graphics rendering
+class Window {
+public:
+    std::string title;
+    int width, height;
+    Color background_color;
+    bool is_open;
+    Framebuffer framebuffer;
+    uint64_t frame_count = 0;
+    
+    Window(const std::string& title = "Replit Game", int w = 800, int h = 600)
+        : title(title), width(w), height(h), background_color(Color::BLACK()), is_open(true),
+          framebuffer(w, h) {}
+    
+    // Sprites record their slot in the owning window, so a window cannot
+    // be copied, and releases its sprites when destroyed
+    Window(const Window&) = delete;
+    Window& operator=(const Window&) = delete;
+    
+    ~Window() {
+        for (auto& [layer, bucket] : layers) {
+            for (auto& sprite : bucket) sprite->bucket_slot = SIZE_MAX;
+        }
+    }
+    
+    void clear() {
+        framebuffer.clear(background_color);
+    }
+    
+    // Tile-binned render: visible sprites are binned, in layer order, to
+    // every framebuffer tile their bounds overlap; tiles are then cleared
+    // and rasterized independently on the worker pool.
+    void render() {
+        // Layer order comes from the buckets; only sprites whose layer
+        // changed since the last frame are moved
+        while (!bin_sprites()) {}
+        
+        WorkerPool::shared().run(tile_bins.size(), [this](size_t index) {
+            int tx = static_cast<int>(index % framebuffer.tiles_x());
+            int ty = static_cast<int>(index / framebuffer.tiles_x());
+            Framebuffer::Clip clip = framebuffer.tile_bounds(tx, ty);
+            
+            framebuffer.clear(background_color, clip);
+            for (const DrawItem& item : tile_bins[index]) {
+                if (item.sprite) {
+                    draw_sprite(*item.sprite, clip);
+                } else {
+                    framebuffer.fill_rect(item.world->bounds(item.index), item.world->tint[item.index], clip);
+                }
+            }
+        });
+        
+        present();
+    }
+    
+    void draw_sprite(const Sprite& sprite) {
+        draw_sprite(sprite, framebuffer.bounds());
+    }
+    
+    // Textured once the sprite's texture is resident in the attached
+    // AssetManager's atlas, a tinted rectangle until then
+    void draw_sprite(const Sprite& sprite, const Framebuffer::Clip& clip) {
+        const AtlasRegion* region = assets ? assets->region(sprite.texture) : nullptr;
+        if (region) {
+            const TextureAtlas& atlas = assets->atlas();
+            framebuffer.draw_image(atlas.page_pixels(region->page), atlas.page_width(region->page), *region,
+                                   sprite.bounds, Framebuffer::pack(sprite.tint), clip);
+        } else {
+            framebuffer.fill_rect(sprite.bounds, sprite.tint, clip);
+        }
+    }
+    
+    // Textures for draw_sprite; call assets->update() on the game thread
+    // between frames, never during render()
+    void set_assets(std::shared_ptr<AssetManager> manager) {
+        assets = std::move(manager);
+    }
+    
+    void draw_rectangle(const Rectangle& rect, const Color& color) {
+        framebuffer.fill_rect(rect, color, framebuffer.bounds());
+    }
+    
+    void draw_circle(const Vector2D& center, float radius, const Color& color) {
+        framebuffer.fill_circle(center, radius, color, framebuffer.bounds());
+    }
+    
+    void draw_line(const Vector2D& start, const Vector2D& end, const Color& color) {
+        framebuffer.draw_line(start, end, color, framebuffer.bounds());
+    }
+    
+    void draw_text(const std::string& text, const Vector2D& position, 
+                   const Color& color, int font_size = 12) {
+        framebuffer.draw_text(text, position, color, font_size, framebuffer.bounds());
+    }
+    
+    void present() {
+        frame_count++;
+        if (!capture_directory.empty()) {
+            std::string number = std::to_string(frame_count);
+            std::string path = capture_directory + "/frame_" +
+                               std::string(number.size() < 6 ? 6 - number.size() : 0, '0') + number;
+            if (capture_png) framebuffer.save_png(path + ".png");
+            else framebuffer.save_ppm(path + ".ppm");
+        }
+    }
+    
+    // Writes every presented frame to directory/frame_NNNNNN.{ppm,png};
+    // an empty directory turns capturing off
+    void capture_frames(const std::string& directory, bool png = false) {
+        capture_directory = directory;
+        capture_png = png;
+    }
+    
+    void close() {
+        is_open = false;
+    }
+    
+    // A sprite belongs to at most one window at a time; adding one that
+    // another window holds throws. Within a layer, draw order is insertion
+    // order until a sprite is removed (removal swaps the last sprite of
+    // that layer into the freed slot).
+    void add_sprite(std::shared_ptr<Sprite> sprite) {
+        if (contains(*sprite)) return;
+        if (sprite->bucket_slot != SIZE_MAX) throw std::runtime_error("Sprite already belongs to another window");
+        insert_into_bucket(std::move(sprite));
+    }
+    
+    void remove_sprite(std::shared_ptr<Sprite> sprite) {
+        if (contains(*sprite)) remove_from_bucket(*sprite);
+    }
+    
+    size_t sprite_count() const {
+        return total_sprites;
+    }
+    
+    // Sprites of an attached world are drawn together with the window's
+    // own sprites; within a layer, window sprites come first
+    void attach_world(std::shared_ptr<SpriteWorld> world) {
+        if (std::find(worlds.begin(), worlds.end(), world) == worlds.end()) worlds.push_back(world);
+    }
+    
+    void detach_world(const std::shared_ptr<SpriteWorld>& world) {
+        worlds.erase(std::remove(worlds.begin(), worlds.end(), world), worlds.end());
+    }
+    
+    // Broadphase over the window's sprites, rebuilt lazily once per
+    // presented frame (call update_broadphase() after moving sprites
+    // mid-frame)
+    void update_broadphase() {
+        broadphase.clear();
+        broadphase_sprites.clear();
+        for_each_sprite([this](const std::shared_ptr<Sprite>& sprite) {
+            broadphase.insert(static_cast<uint32_t>(broadphase_sprites.size()), sprite->bounds);
+            broadphase_sprites.push_back(sprite);
+        });
+        broadphase.build();
+        broadphase_frame = frame_count;
+        broadphase_dirty = false;
+    }
+    
+    std::vector<std::pair<std::shared_ptr<Sprite>, std::shared_ptr<Sprite>>> collision_pairs() {
+        ensure_broadphase();
+        std::vector<std::pair<std::shared_ptr<Sprite>, std::shared_ptr<Sprite>>> result;
+        for (const auto& [a, b] : broadphase.candidate_pairs()) {
+            result.emplace_back(broadphase_sprites[a], broadphase_sprites[b]);
+        }
+        return result;
+    }
+    
+    std::vector<std::shared_ptr<Sprite>> sprites_in_region(const Rectangle& region) {
+        ensure_broadphase();
+        std::vector<std::shared_ptr<Sprite>> result;
+        for (uint32_t id : broadphase.query_region(region)) result.push_back(broadphase_sprites[id]);
+        return result;
+    }
+    
+    // Sprites hit by the ray, nearest first
+    std::vector<std::shared_ptr<Sprite>> raycast(const Vector2D& origin, const Vector2D& direction,
+                                                 float max_distance) {
+        ensure_broadphase();
+        std::vector<std::shared_ptr<Sprite>> result;
+        for (uint32_t id : broadphase.query_ray(origin, direction, max_distance)) {
+            result.push_back(broadphase_sprites[id]);
+        }
+        return result;
+    }
+    
+    // Visits sprites in draw order
+    template<typename F>
+    void for_each_sprite(F&& fn) const {
+        for (const auto& [layer, bucket] : layers) {
+            for (const auto& sprite : bucket) fn(sprite);
+        }
+    }
+    
+    bool should_close() const {
+        return !is_open;
+    }
+    
+    void poll_events() {
+        // Handle window events, input, etc.
+    }
+    
+    void set_vsync(bool enabled) {
+        // Enable/disable vertical sync
+    }
+    
+    void set_fullscreen(bool fullscreen) {
+        // Toggle fullscreen mode
+    }
+    
+private:
+    std::string capture_directory;
+    bool capture_png = false;
+    std::map<int, std::vector<std::shared_ptr<Sprite>>> layers;
+    size_t total_sprites = 0;
+    std::vector<std::shared_ptr<SpriteWorld>> worlds;
+    std::shared_ptr<AssetManager> assets;
+    SpatialHash broadphase;
+    std::vector<std::shared_ptr<Sprite>> broadphase_sprites;
+    uint64_t broadphase_frame = 0;
+    bool broadphase_dirty = true;
+    
+    void ensure_broadphase() {
+        if (broadphase_dirty || broadphase_frame != frame_count) update_broadphase();
+    }
+    
+    // A window sprite, or sprite `index` of `world`
+    struct DrawItem {
+        const Sprite* sprite;
+        const SpriteWorld* world;
+        uint32_t index;
+    };
+    std::vector<std::vector<DrawItem>> tile_bins;
+    std::vector<std::shared_ptr<Sprite>> moved;
+    std::vector<int> draw_layers;
+    
+    bool contains(const Sprite& sprite) const {
+        auto it = layers.find(sprite.bucket_layer);
+        return it != layers.end() && sprite.bucket_slot < it->second.size() &&
+               it->second[sprite.bucket_slot].get() == &sprite;
+    }
+    
+    void insert_into_bucket(std::shared_ptr<Sprite> sprite) {
+        auto& bucket = layers[sprite->layer];
+        sprite->bucket_layer = sprite->layer;
+        sprite->bucket_slot = bucket.size();
+        bucket.push_back(std::move(sprite));
+        total_sprites++;
+        broadphase_dirty = true;
+    }
+    
+    void remove_from_bucket(Sprite& sprite) {
+        auto it = layers.find(sprite.bucket_layer);
+        auto& bucket = it->second;
+        if (sprite.bucket_slot != bucket.size() - 1) {
+            bucket[sprite.bucket_slot] = std::move(bucket.back());
+            bucket[sprite.bucket_slot]->bucket_slot = sprite.bucket_slot;
+        }
+        bucket.pop_back();
+        if (bucket.empty()) layers.erase(it);
+        sprite.bucket_slot = SIZE_MAX;
+        total_sprites--;
+        broadphase_dirty = true;
+    }
+    
+    // Returns false if some sprites had changed layer; they are re-bucketed
+    // and the caller bins again
+    bool bin_sprites() {
+        int tiles_x = framebuffer.tiles_x();
+        int tiles_y = framebuffer.tiles_y();
+        tile_bins.resize(static_cast<size_t>(tiles_x) * tiles_y);
+        for (auto& bin : tile_bins) bin.clear();
+        moved.clear();
+        
+        draw_layers.clear();
+        for (const auto& entry : layers) draw_layers.push_back(entry.first);
+        for (const auto& world : worlds) {
+            for (const auto& entry : world->layer_slots()) draw_layers.push_back(entry.first);
+        }
+        if (!worlds.empty()) {
+            std::sort(draw_layers.begin(), draw_layers.end());
+            draw_layers.erase(std::unique(draw_layers.begin(), draw_layers.end()), draw_layers.end());
+        }
+        
+        const float tile = static_cast<float>(Framebuffer::TILE_SIZE);
+        for (int layer : draw_layers) {
+            auto bucket = layers.find(layer);
+            if (bucket != layers.end()) {
+                for (const auto& entry : bucket->second) {
+                    const Sprite& sprite = *entry;
+                    if (sprite.layer != layer) {
+                        moved.push_back(entry);
+                        continue;
+                    }
+                    if (sprite.visible) {
+                        bin_item(DrawItem{&sprite, nullptr, 0}, sprite.bounds, tile, tiles_x, tiles_y);
+                    }
+                }
+            }
+            
+            for (const auto& world : worlds) {
+                auto slots = world->layer_slots().find(layer);
+                if (slots == world->layer_slots().end()) continue;
+                for (uint32_t slot : slots->second) {
+                    size_t i = world->dense_index(slot);
+                    if (world->visible[i]) {
+                        bin_item(DrawItem{nullptr, world.get(), static_cast<uint32_t>(i)},
+                                 world->bounds(i), tile, tiles_x, tiles_y);
+                    }
+                }
+            }
+        }
+        
+        if (moved.empty()) return true;
+        for (auto& sprite : moved) {
+            remove_from_bucket(*sprite);
+            insert_into_bucket(sprite);
+        }
+        moved.clear();
+        return false;
+    }
+    
+    void bin_item(const DrawItem& item, const Rectangle& b, float tile, int tiles_x, int tiles_y) {
+        if (b.width <= 0 || b.height <= 0) return;
+        
+        // Pixel centers are at +0.5, matching Framebuffer::fill_rect coverage
+        int tx0 = std::max(0, static_cast<int>(std::floor((b.x + 0.5f) / tile)));
+        int ty0 = std::max(0, static_cast<int>(std::floor((b.y + 0.5f) / tile)));
+        int tx1 = std::min(tiles_x - 1, static_cast<int>(std::floor((b.x + b.width + 0.5f) / tile)));
+        int ty1 = std::min(tiles_y - 1, static_cast<int>(std::floor((b.y + b.height + 0.5f) / tile)));
+        
+        for (int ty = ty0; ty <= ty1; ++ty) {
+            for (int tx = tx0; tx <= tx1; ++tx) {
+                tile_bins[static_cast<size_t>(ty) * tiles_x + tx].push_back(item);
+            }
+        }
+    }
+};
+
+// Decoded sound held as interleaved stereo float frames at the mixer's
+// sample rate, so voices mix with a plain multiply-add
+struct SoundBuffer {
+    int sample_rate = 0;
+    std::vector<float> samples;     // L, R, L, R, ...
+    
+    size_t frames() const { return samples.size() / 2; }
+};
+
+// RIFF/WAVE reading (PCM 8/16/24/32-bit and 32-bit float) and 16-bit PCM
+// writing
+class WavCodec {
+public:
+    // Limits on what decode() accepts, so a tiny hostile header cannot ask
+    // for an enormous resampled buffer
+    static constexpr uint32_t MIN_SAMPLE_RATE = 1000;
+    static constexpr uint32_t MAX_SAMPLE_RATE = 384000;
+    static constexpr size_t MAX_SECONDS = 600;
+    
+    // Mono is duplicated to both channels, channels past two are dropped,
+    // and the sample rate is converted linearly to target_rate
+    static SoundBuffer load(const std::string& path, int target_rate) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) throw std::runtime_error("Could not open sound: " + path);
+        std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(data.data()), data.size());
+        try {
+            return decode(data.data(), data.size(), target_rate);
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error(path + ": " + e.what());
+        }
+    }
+    
+    static SoundBuffer decode(const uint8_t* data, size_t size, int target_rate) {
+        auto u16 = [&](size_t at) { return static_cast<uint32_t>(data[at] | data[at + 1] << 8); };
+        auto u32 = [&](size_t at) { return u16(at) | u16(at + 2) << 16; };
+        if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0) {
+            throw std::runtime_error("Not a WAV file");
+        }
+        
+        uint32_t format = 0, channels = 0, rate = 0, bits = 0;
+        const uint8_t* samples = nullptr;
+        size_t sample_bytes = 0;
+        for (size_t pos = 12; pos + 8 <= size;) {
+            uint32_t length = u32(pos + 4);
+            size_t body = pos + 8;
+            if (std::memcmp(data + pos, "fmt ", 4) == 0 && body + 16 <= size) {
+                format = u16(body);
+                channels = u16(body + 2);
+                rate = u32(body + 4);
+                bits = u16(body + 14);
+                if (format == 0xFFFE && length >= 26 && body + 26 <= size) format = u16(body + 24);
+            } else if (std::memcmp(data + pos, "data", 4) == 0) {
+                samples = data + body;
+                sample_bytes = std::min<size_t>(length, size - body);
+            }
+            pos = body + length + (length & 1);
+        }
+        
+        bool pcm = format == 1 && (bits == 8 || bits == 16 || bits == 24 || bits == 32);
+        bool floating = format == 3 && bits == 32;
+        if (!samples || channels == 0 || rate == 0 || (!pcm && !floating)) {
+            throw std::runtime_error("Unsupported WAV encoding");
+        }
+        if (rate < MIN_SAMPLE_RATE || rate > MAX_SAMPLE_RATE) throw std::runtime_error("Unsupported WAV sample rate");
+        if (target_rate < static_cast<int>(MIN_SAMPLE_RATE) || target_rate > static_cast<int>(MAX_SAMPLE_RATE)) {
+            throw std::runtime_error("Unsupported output sample rate");
+        }
+        
+        size_t stride = channels * bits / 8;
+        size_t count = sample_bytes / stride;
+        if (count / rate >= MAX_SECONDS) throw std::runtime_error("WAV is too long");
+        std::vector<float> source(count * 2);
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t* frame = samples + i * stride;
+            float left = sample(frame, bits, floating);
+            float right = channels > 1 ? sample(frame + bits / 8, bits, floating) : left;
+            source[i * 2] = left;
+            source[i * 2 + 1] = right;
+        }
+        
+        SoundBuffer sound;
+        sound.sample_rate = target_rate;
+        if (static_cast<int>(rate) == target_rate || count < 2) {
+            sound.samples = std::move(source);
+            return sound;
+        }
+        
+        double step = static_cast<double>(rate) / target_rate;
+        size_t out_frames = static_cast<size_t>((count - 1) / step) + 1;
+        sound.samples.resize(out_frames * 2);
+        for (size_t i = 0; i < out_frames; ++i) {
+            double position = i * step;
+            size_t index = std::min(static_cast<size_t>(position), count - 2);
+            float t = static_cast<float>(position - index);
+            for (int c = 0; c < 2; ++c) {
+                float a = source[index * 2 + c], b = source[(index + 1) * 2 + c];
+                sound.samples[i * 2 + c] = a + (b - a) * t;
+            }
+        }
+        return sound;
+    }
+    
+    // 44-byte header for 16-bit stereo PCM; data_bytes can be patched later
+    static void write_header(std::ostream& out, int sample_rate, uint32_t data_bytes) {
+        uint8_t header[44];
+        auto put16 = [&](size_t at, uint32_t v) { header[at] = v & 0xFF; header[at + 1] = (v >> 8) & 0xFF; };
+        auto put32 = [&](size_t at, uint32_t v) { put16(at, v & 0xFFFF); put16(at + 2, v >> 16); };
+        std::memcpy(header, "RIFF", 4);
+        put32(4, 36 + data_bytes);
+        std::memcpy(header + 8, "WAVEfmt ", 8);
+        put32(16, 16);
+        put16(20, 1);
+        put16(22, 2);
+        put32(24, sample_rate);
+        put32(28, sample_rate * 4);
+        put16(32, 4);
+        put16(34, 16);
+        std::memcpy(header + 36, "data", 4);
+        put32(40, data_bytes);
+        out.write(reinterpret_cast<const char*>(header), 44);
+    }
+    
+private:
+    static float sample(const uint8_t* p, uint32_t bits, bool floating) {
+        if (floating) {
+            float value;
+            std::memcpy(&value, p, 4);
+            return value;
+        }
+        switch (bits) {
+            case 8: return (p[0] - 128) / 128.0f;
+            case 16: return static_cast<int16_t>(p[0] | p[1] << 8) / 32768.0f;
+            case 24: return static_cast<int32_t>(uint32_t(p[0]) << 8 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 24) / 2147483648.0f;
+            default: return static_cast<int32_t>(p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24) / 2147483648.0f;
+        }
+    }
+};
+
+// Where mixed audio goes: write receives interleaved stereo float frames
+// on the output thread, close runs once when the mixer shuts down
+struct AudioSink {
+    std::function<void(const float* frames, size_t count)> write;
+    std::function<void()> close;
+    
+    // Discards audio; for headless runs that only need timing
+    static AudioSink null() {
+        return AudioSink{[](const float*, size_t) {}, []() {}};
+    }
+    
+    // Records to a 16-bit stereo WAV file
+    static AudioSink wav_file(const std::string& path, int sample_rate) {
+        auto file = std::make_shared<std::ofstream>(path, std::ios::binary);
+        if (!*file) throw std::runtime_error("Could not create " + path);
+        WavCodec::write_header(*file, sample_rate, 0);
+        auto written = std::make_shared<uint32_t>(0);
+        auto pcm = std::make_shared<std::vector<int16_t>>();
+        
+        AudioSink sink;
+        sink.write = [file, written, pcm](const float* frames, size_t count) {
+            pcm->resize(count * 2);
+            for (size_t i = 0; i < count * 2; ++i) {
+                (*pcm)[i] = static_cast<int16_t>(std::lround(std::min(std::max(frames[i], -1.0f), 1.0f) * 32767.0f));
+            }
+            file->write(reinterpret_cast<const char*>(pcm->data()), pcm->size() * 2);
+            *written += static_cast<uint32_t>(pcm->size() * 2);
+        };
+        sink.close = [file, written, sample_rate]() {
+            file->seekp(0);
+            WavCodec::write_header(*file, sample_rate, *written);
+            file->close();
+        };
+        return sink;
+    }
+};
+
+// Software mixer. The game thread only pushes commands into a lock-free
+// queue (a full queue drops the command rather than waiting); a mixer
+// thread applies them, mixes voices in blocks with SIMD gain and
+// constant-power pan, and feeds an SPSC ring that an output thread drains
+// into the sink. In realtime mode the output thread consumes at the
+// sample rate like a device would; otherwise audio time is driven by the
+// game through advance(), so a headless recording lines up with game time
+// regardless of how fast frames run. play(path) decodes on a loader
+// thread and hands the finished voice straight to the mixer.
+class AudioMixer {
+public:
+    enum class Bus : uint8_t { SFX, MUSIC };
+    
+    struct Stats {
+        uint64_t frames_written;
+        uint64_t underruns;         // output blocks padded with silence
+        uint64_t dropped_commands;
+        uint32_t active_voices;
+    };
+    
+    explicit AudioMixer(AudioSink sink = AudioSink::null(), int sample_rate = 48000, bool realtime = true,
+                        size_t block_frames = 256, size_t ring_frames = 8192)
+        : sample_rate(sample_rate), block_frames(block_frames), realtime(realtime), sink(std::move(sink)),
+          commands(1024), loaded(256), ring(ring_frames * 2) {
+        mix_buffer.resize(block_frames * 2);
+        loader_thread = std::thread([this]() { loader_loop(); });
+        mixer_thread = std::thread([this]() { mix_loop(); });
+        output_thread = std::thread([this]() { output_loop(); });
+    }
+    
+    AudioMixer(const AudioMixer&) = delete;
+    AudioMixer& operator=(const AudioMixer&) = delete;
+    
+    ~AudioMixer() {
+        {
+            std::lock_guard<std::mutex> lock(load_mutex);
+            loader_stopping = true;
+        }
+        load_wake.notify_all();
+        loader_thread.join();
+        mixing.store(false);
+        mixer_thread.join();
+        outputting.store(false);
+        output_thread.join();
+        if (sink.close) sink.close();
+    }
+    
+    int rate() const { return sample_rate; }
+    
+    // Non-realtime mode: lets the mixer produce delta_time more seconds of
+    // audio. Commands sent before this call apply at or before the new
+    // end of the timeline (block granularity).
+    void advance(float delta_time) {
+        pending_time += delta_time;
+        uint64_t frames = static_cast<uint64_t>(pending_time * sample_rate);
+        pending_time -= static_cast<double>(frames) / sample_rate;
+        allowed_frames.fetch_add(frames, std::memory_order_release);
+    }
+    
+    // Decodes on the calling thread on first use; later calls share the
+    // cached samples
+    std::shared_ptr<const SoundBuffer> sound(const std::string& path) {
+        {
+            std::lock_guard<std::mutex> lock(load_mutex);
+            auto found = cache.find(path);
+            if (found != cache.end()) return found->second;
+        }
+        auto decoded = std::make_shared<const SoundBuffer>(WavCodec::load(path, sample_rate));
+        std::lock_guard<std::mutex> lock(load_mutex);
+        return cache.emplace(path, decoded).first->second;
+    }
+    
+    // Plays a file once the loader thread has decoded it; cached sounds
+    // start as soon as the mixer sees the command. Never throws: a file
+    // that fails to load is skipped and its reason kept for load_error().
+    // stop_bus() also drops sounds on that bus that are still loading.
+    void play(const std::string& path, float volume = 1.0f, float pan = 0.0f,
+              bool loop = false, Bus bus = Bus::SFX) {
+        Command command;
+        command.type = Command::PLAY;
+        command.voice = next_voice++;
+        command.volume = volume;
+        command.pan = pan;
+        command.loop = loop;
+        command.bus = bus;
+        command.serial = bus_serial[static_cast<int>(bus)];
+        {
+            std::lock_guard<std::mutex> lock(load_mutex);
+            auto found = cache.find(path);
+            if (found != cache.end()) command.sound = found->second;
+            else if (!load_errors.count(path)) load_requests.push_back(LoadRequest{path, command});
+        }
+        if (command.sound) send(command);
+        else load_wake.notify_one();
+    }
+    
+    // Why path failed to load, or empty if it has not failed
+    std::string load_error(const std::string& path) const {
+        std::lock_guard<std::mutex> lock(load_mutex);
+        auto found = load_errors.find(path);
+        return found != load_errors.end() ? found->second : std::string();
+    }
+    
+    // True while play(path) requests are still being decoded
+    bool loading() const {
+        std::lock_guard<std::mutex> lock(load_mutex);
+        return !load_requests.empty() || load_busy;
+    }
+    
+    // Returns a voice id for stop()/set_volume(), or 0 if the command
+    // queue was full
+    uint32_t play(std::shared_ptr<const SoundBuffer> buffer, float volume = 1.0f, float pan = 0.0f,
+                  bool loop = false, Bus bus = Bus::SFX) {
+        Command command;
+        command.type = Command::PLAY;
+        command.voice = next_voice++;
+        command.sound = std::move(buffer);
+        command.volume = volume;
+        command.pan = pan;
+        command.loop = loop;
+        command.bus = bus;
+        return send(command) ? command.voice : 0;
+    }
+    
+    void stop(uint32_t voice) {
+        Command command;
+        command.type = Command::STOP;
+        command.voice = voice;
+        send(command);
+    }
+    
+    void stop_bus(Bus bus) {
+        Command command;
+        command.type = Command::STOP_BUS;
+        command.bus = bus;
+        command.serial = ++bus_serial[static_cast<int>(bus)];
+        if (!send(command)) bus_serial[static_cast<int>(bus)]--;
+    }
+    
+    void set_volume(uint32_t voice, float volume, float pan = 0.0f) {
+        Command command;
+        command.type = Command::SET_VOLUME;
+        command.voice = voice;
+        command.volume = volume;
+        command.pan = pan;
+        send(command);
+    }
+    
+    void set_master_volume(float volume) {
+        Command command;
+        command.type = Command::SET_MASTER;
+        command.volume = volume;
+        send(command);
+    }
+    
+    Stats stats() const {
+        return Stats{frames_written.load(), underruns.load(), dropped_commands.load(), active_voices.load()};
+    }
+    
+    // Mixes count frames of voices into out (interleaved stereo):
+    // out += in * (left, right)
+    static void mix_into(float* out, const float* in, size_t count, float left, float right) {
+        size_t i = 0, n = count * 2;
+#if defined(__AVX__)
+        const __m256 gain8 = _mm256_setr_ps(left, right, left, right, left, right, left, right);
+        for (; i + 8 <= n; i += 8) {
+            __m256 sum = _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(_mm256_loadu_ps(in + i), gain8));
+            _mm256_storeu_ps(out + i, sum);
+        }
+#endif
+#if defined(__SSE2__)
+        const __m128 gain4 = _mm_setr_ps(left, right, left, right);
+        for (; i + 4 <= n; i += 4) {
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), gain4)));
+        }
+#endif
+        for (; i < n; i += 2) {
+            out[i] += in[i] * left;
+            out[i + 1] += in[i + 1] * right;
+        }
+    }
+    
+private:
+    struct Command {
+        enum Type : uint8_t { PLAY, STOP, STOP_BUS, SET_VOLUME, SET_MASTER };
+        Type type = PLAY;
+        Bus bus = Bus::SFX;
+        bool loop = false;
+        uint32_t voice = 0;
+        uint32_t serial = 0;        // stop_bus() count for the bus when sent
+        float volume = 1.0f;
+        float pan = 0.0f;
+        std::shared_ptr<const SoundBuffer> sound;
+    };
+    
+    struct LoadRequest {
+        std::string path;
+        Command command;
+    };
+    
+    struct Voice {
+        uint32_t id;
+        Bus bus;
+        bool loop;
+        size_t position;
+        float left, right;
+        std::shared_ptr<const SoundBuffer> sound;
+    };
+    
+    int sample_rate;
+    size_t block_frames;
+    bool realtime;
+    AudioSink sink;
+    
+    // Game thread
+    uint32_t next_voice = 1;
+    uint32_t bus_serial[2] = {0, 0};
+    double pending_time = 0;
+    
+    // Shared with the loader thread
+    mutable std::mutex load_mutex;
+    std::condition_variable load_wake;
+    std::unordered_map<std::string, std::shared_ptr<const SoundBuffer>> cache;
+    std::unordered_map<std::string, std::string> load_errors;
+    std::deque<LoadRequest> load_requests;
+    bool load_busy = false;
+    bool loader_stopping = false;
+    
+    // Mixer thread
+    std::vector<Voice> voices;
+    std::vector<Command> early;     // loaded plays whose stop_bus() is still queued
+    uint32_t applied_serial[2] = {0, 0};
+    std::vector<float> mix_buffer;
+    float master = 1.0f;
+    uint64_t mixed_frames = 0;
+    
+    SpscQueue<Command> commands;
+    SpscQueue<Command> loaded;      // loader thread -> mixer thread
+    SpscQueue<float> ring;
+    std::atomic<bool> mixing{true}, outputting{true};
+    std::atomic<uint64_t> frames_written{0}, underruns{0}, dropped_commands{0};
+    std::atomic<uint64_t> allowed_frames{0};
+    std::atomic<uint32_t> active_voices{0};
+    std::thread loader_thread, mixer_thread, output_thread;
+    
+    bool send(const Command& command) {
+        if (commands.try_push(command)) return true;
+        dropped_commands++;
+        return false;
+    }
+    
+    static void pan_gains(float volume, float pan, float& left, float& right) {
+        float angle = (std::min(std::max(pan, -1.0f), 1.0f) + 1.0f) * static_cast<float>(M_PI) / 4.0f;
+        left = volume * std::cos(angle);
+        right = volume * std::sin(angle);
+    }
+    
+    void apply(Command& command) {
+        switch (command.type) {
+            case Command::PLAY: {
+                if (!command.sound || command.sound->frames() == 0) break;
+                Voice voice{command.voice, command.bus, command.loop, 0, 0, 0, std::move(command.sound)};
+                pan_gains(command.volume, command.pan, voice.left, voice.right);
+                voices.push_back(std::move(voice));
+                break;
+            }
+            case Command::STOP:
+                voices.erase(std::remove_if(voices.begin(), voices.end(),
+                                            [&](const Voice& v) { return v.id == command.voice; }), voices.end());
+                break;
+            case Command::STOP_BUS:
+                applied_serial[static_cast<int>(command.bus)] = command.serial;
+                voices.erase(std::remove_if(voices.begin(), voices.end(),
+                                            [&](const Voice& v) { return v.bus == command.bus; }), voices.end());
+                break;
+            case Command::SET_VOLUME:
+                for (auto& voice : voices) {
+                    if (voice.id == command.voice) pan_gains(command.volume, command.pan, voice.left, voice.right);
+                }
+                break;
+            case Command::SET_MASTER:
+                master = command.volume;
+                break;
+        }
+    }
+    
+    void mix_block() {
+        std::fill(mix_buffer.begin(), mix_buffer.end(), 0.0f);
+        for (size_t v = 0; v < voices.size();) {
+            Voice& voice = voices[v];
+            size_t done = 0;
+            while (done < block_frames) {
+                size_t available = voice.sound->frames() - voice.position;
+                size_t count = std::min(available, block_frames - done);
+                mix_into(&mix_buffer[done * 2], &voice.sound->samples[voice.position * 2], count,
+                         voice.left, voice.right);
+                done += count;
+                voice.position += count;
+                if (voice.position < voice.sound->frames()) continue;
+                if (!voice.loop) break;
+                voice.position = 0;
+            }
+            
+            if (voice.position >= voice.sound->frames() && !voice.loop) {
+                voices[v] = std::move(voices.back());
+                voices.pop_back();
+            } else {
+                ++v;
+            }
+        }
+        
+        size_t i = 0, n = mix_buffer.size();
+#if defined(__SSE2__)
+        const __m128 gain = _mm_set1_ps(master), high = _mm_set1_ps(1.0f), low = _mm_set1_ps(-1.0f);
+        for (; i + 4 <= n; i += 4) {
+            __m128 value = _mm_mul_ps(_mm_loadu_ps(&mix_buffer[i]), gain);
+            _mm_storeu_ps(&mix_buffer[i], _mm_max_ps(low, _mm_min_ps(high, value)));
+        }
+#endif
+        for (; i < n; ++i) mix_buffer[i] = std::min(std::max(mix_buffer[i] * master, -1.0f), 1.0f);
+        active_voices.store(static_cast<uint32_t>(voices.size()));
+    }
+    
+    void mix_loop() {
+        auto pause = std::chrono::microseconds(static_cast<int64_t>(500000.0 * block_frames / sample_rate));
+        while (mixing.load()) {
+            // Read the allowance before draining commands so everything
+            // sent before an advance() is applied before its frames mix
+            bool can_mix = ring.capacity() - ring.size() >= mix_buffer.size() &&
+                           (realtime || mixed_frames + block_frames <= allowed_frames.load(std::memory_order_acquire));
+            Command command;
+            while (commands.try_pop(command)) apply(command);
+            start_loaded();
+            
+            if (!can_mix) {
+                std::this_thread::sleep_for(pause);
+                continue;
+            }
+            mix_block();
+            ring.push(mix_buffer.data(), mix_buffer.size());
+            mixed_frames += block_frames;
+        }
+    }
+    
+    // A loaded play goes ahead only if no stop_bus() on its bus was sent
+    // after it. Commands drain before this, but a stop sent just before
+    // the play can still be in the queue; such plays wait in `early`.
+    void start_loaded() {
+        Command command;
+        while (loaded.try_pop(command)) early.push_back(std::move(command));
+        for (size_t i = 0; i < early.size();) {
+            uint32_t ahead = early[i].serial - applied_serial[static_cast<int>(early[i].bus)];
+            if (ahead != 0 && ahead < UINT32_MAX / 2) {
+                ++i;
+                continue;
+            }
+            if (ahead == 0) apply(early[i]);
+            early[i] = std::move(early.back());
+            early.pop_back();
+        }
+    }
+    
+    void loader_loop() {
+        while (true) {
+            LoadRequest request;
+            {
+                std::unique_lock<std::mutex> lock(load_mutex);
+                load_busy = false;
+                load_wake.wait(lock, [this]() { return loader_stopping || !load_requests.empty(); });
+                if (loader_stopping) return;
+                request = std::move(load_requests.front());
+                load_requests.pop_front();
+                load_busy = true;
+                
+                auto found = cache.find(request.path);
+                if (found != cache.end()) request.command.sound = found->second;
+                else if (load_errors.count(request.path)) continue;
+            }
+            
+            if (!request.command.sound) {
+                std::shared_ptr<const SoundBuffer> sound;
+                std::string error;
+                try {
+                    sound = std::make_shared<const SoundBuffer>(WavCodec::load(request.path, sample_rate));
+                } catch (const std::exception& e) {
+                    error = e.what();
+                }
+                std::lock_guard<std::mutex> lock(load_mutex);
+                if (!sound) {
+                    load_errors.emplace(request.path, error);
+                    continue;
+                }
+                request.command.sound = cache.emplace(request.path, sound).first->second;
+            }
+            
+            while (!loaded.try_push(request.command)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                std::lock_guard<std::mutex> lock(load_mutex);
+                if (loader_stopping) return;
+            }
+        }
+    }
+    
+    void output_loop() {
+        std::vector<float> block(block_frames * 2);
+        auto period = std::chrono::nanoseconds(static_cast<int64_t>(1e9 * block_frames / sample_rate));
+        auto next = std::chrono::steady_clock::now();
+        while (true) {
+            bool running = outputting.load();
+            size_t got = ring.pop(block.data(), block.size());
+            if (got == 0 && !running) break;
+            
+            if (realtime) {
+                if (got < block.size() && running) {
+                    std::fill(block.begin() + got, block.end(), 0.0f);
+                    underruns++;
+                    got = block.size();
+                }
+                next += period;
+                std::this_thread::sleep_until(next);
+            } else if (got == 0) {
+                std::this_thread::sleep_for(period / 4);
+                continue;
+            }
+            
+            sink.write(block.data(), got / 2);
+            frames_written += got / 2;
+        }
+    }
+};
+
+// Audio system: script-facing front end over a shared AudioMixer. The
+// mixer starts on first use with a null sink; call start() first to
+// record to a WAV file instead.
+class AudioSystem {
+public:
+    // realtime = false records against game time; call advance() per frame
+    static void start(AudioSink sink, int sample_rate = 48000, bool realtime = true) {
+        instance.reset();
+        instance = std::make_unique<AudioMixer>(std::move(sink), sample_rate, realtime);
+    }
+    
+    // Stops mixing and closes the sink (finalizing a WAV recording)
+    static void shutdown() {
+        instance.reset();
+    }
+    
+    static void advance(float delta_time) {
+        if (instance) instance->advance(delta_time);
+    }
+    
+    static AudioMixer& mixer() {
+        if (!instance) instance = std::make_unique<AudioMixer>();
+        return *instance;
+    }
+    
+    // Files are decoded off the script thread and start once ready; a
+    // missing or bad file is skipped (see AudioMixer::load_error)
+    static void play_sound(const std::string& path, float volume = 1.0f) {
+        mixer().play(path, volume);
+    }
+    
+    static void play_music(const std::string& path, bool loop = true, float volume = 1.0f) {
+        AudioMixer& audio = mixer();
+        audio.stop_bus(AudioMixer::Bus::MUSIC);
+        audio.play(path, volume, 0.0f, loop, AudioMixer::Bus::MUSIC);
+    }
+    
+    static void stop_music() {
+        if (instance) instance->stop_bus(AudioMixer::Bus::MUSIC);
+    }
+    
+    static void set_master_volume(float volume) {
+        mixer().set_master_volume(volume);
+    }
+    
+private:
+    static inline std::unique_ptr<AudioMixer> instance;
+};
+
+// Timer and animation system
+class Timer {
+public:
+    float duration;
+    float elapsed;
+    bool running;
+    std::function<void()> callback;
+    
+    Timer(float duration, std::function<void()> callback = nullptr)
+        : duration(duration), elapsed(0), running(false), callback(callback) {}
+    
+    void start() {
+        running = true;
+        elapsed = 0;
+    }
+    
+    void stop() {
+        running = false;
+    }
+    
+    void update(float delta_time) {
+        if (!running) return;
+        
+        elapsed += delta_time;
+        if (elapsed >= duration) {
+            running = false;
+            if (callback) callback();
+        }
+    }
+    
+    float progress() const {
+        return elapsed / duration;
+    }
+    
+    bool is_finished() const {
+        return elapsed >= duration;
+    }
+};
+
+struct TimerHandle {
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+// Hierarchical timing wheel: LEVELS wheels of 64 slots each, holding
+// intrusive doubly linked lists of timers. Insert and cancel are O(1), and
+// advance() only touches slots holding due timers plus one cascade per 64
+// ticks, so idle timers cost nothing per frame. Drive it once per frame
+// with advance(delta_time), or from an event loop via ticks_until_next().
+class TimerWheel {
+public:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 6;
+    static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+    
+    explicit TimerWheel(float tick_seconds = 0.001f) : tick_seconds(tick_seconds) {
+        heads.fill(NIL);
+        occupied.fill(0);
+    }
+    
+    // Runs callback after delay seconds (at least one tick), then every
+    // interval seconds if interval > 0
+    TimerHandle schedule(float delay, std::function<void()> callback, float interval = 0) {
+        uint32_t index;
+        if (free_head != NIL) {
+            index = free_head;
+            free_head = nodes[index].next;
+        } else {
+            index = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+        
+        Node& node = nodes[index];
+        node.callback = std::move(callback);
+        node.expiry = current + to_ticks(delay);
+        node.interval = interval > 0 ? to_ticks(interval) : 0;
+        node.live = true;
+        link(index);
+        count++;
+        return TimerHandle{index, node.generation};
+    }
+    
+    bool cancel(TimerHandle handle) {
+        if (!active(handle)) return false;
+        unlink(handle.slot);
+        release(handle.slot);
+        return true;
+    }
+    
+    bool active(TimerHandle handle) const {
+        return handle.slot < nodes.size() && nodes[handle.slot].live &&
+               nodes[handle.slot].generation == handle.generation;
+    }
+    
+    // Seconds until the timer fires, or -1 if it is not active
+    float remaining(TimerHandle handle) const {
+        if (!active(handle)) return -1;
+        return (nodes[handle.slot].expiry - current) * tick_seconds;
+    }
+    
+    size_t size() const { return count; }
+    uint64_t now() const { return current; }
+    
+    void advance(float delta_time) {
+        carry += delta_time;
+        uint64_t ticks = static_cast<uint64_t>(carry / tick_seconds);
+        carry -= ticks * tick_seconds;
+        advance_ticks(ticks);
+    }
+    
+    void advance_ticks(uint64_t ticks) {
+        uint64_t target = current + ticks;
+        while (current < target) {
+            if (count == 0) {
+                current = target;
+                break;
+            }
+            
+            // Skip straight to the next occupied level-0 slot or the next
+            // cascade boundary, whichever comes first
+            uint64_t t = current + 1;
+            if ((t & (SLOTS - 1)) != 0) {
+                uint64_t stop = std::min(target, (t | (SLOTS - 1)));
+                uint64_t pending = occupied[0] >> (t & (SLOTS - 1));
+                if (pending == 0) {
+                    current = stop;
+                    continue;
+                }
+                t += __builtin_ctzll(pending);
+                if (t > stop) {
+                    current = stop;
+                    continue;
+                }
+            }
+            current = t;
+            process(t);
+        }
+    }
+    
+    // Lower bound on ticks until the next timer fires (0 if none pending),
+    // for event loops that want to sleep between expiries
+    uint64_t ticks_until_next() const {
+        if (count == 0) return 0;
+        uint64_t t = current + 1;
+        // Higher levels cascade into level 0 at t and may fire right away
+        if ((t & (SLOTS - 1)) == 0) {
+            for (int level = 1; level < LEVELS; ++level) {
+                if (occupied[level]) return 1;
+            }
+        }
+        uint64_t pending = occupied[0] >> (t & (SLOTS - 1));
+        if (pending) return 1 + __builtin_ctzll(pending);
+        return ((t | (SLOTS - 1)) + 1) - current;
+    }
+    
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+    
+    struct Node {
+        std::function<void()> callback;
+        uint64_t expiry = 0;
+        uint64_t interval = 0;
+        uint32_t prev = NIL, next = NIL;
+        uint32_t bucket = 0;
+        uint32_t generation = 0;
+        bool live = false;
+    };
+    
+    float tick_seconds;
+    float carry = 0;
+    uint64_t current = 0;
+    size_t count = 0;
+    std::vector<Node> nodes;
+    uint32_t free_head = NIL;
+    std::array<uint32_t, LEVELS * SLOTS> heads;
+    std::array<uint64_t, LEVELS> occupied;
+    
+    uint64_t to_ticks(float seconds) const {
+        return std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(seconds / tick_seconds)));
+    }
+    
+    // Picks the level by distance to expiry; timers beyond the top level
+    // park in its farthest slot and are re-placed when it cascades
+    void link(uint32_t index) {
+        Node& node = nodes[index];
+        uint64_t delta = node.expiry > current ? node.expiry - current : 0;
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) level++;
+        uint64_t when = node.expiry;
+        if (delta >= (uint64_t(1) << (SLOT_BITS * LEVELS))) {
+            when = current + (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+        }
+        uint32_t slot = static_cast<uint32_t>((when >> (SLOT_BITS * level)) & (SLOTS - 1));
+        
+        node.bucket = level * SLOTS + slot;
+        node.prev = NIL;
+        node.next = heads[node.bucket];
+        if (node.next != NIL) nodes[node.next].prev = index;
+        heads[node.bucket] = index;
+        occupied[level] |= uint64_t(1) << slot;
+    }
+    
+    void unlink(uint32_t index) {
+        Node& node = nodes[index];
+        if (node.prev != NIL) {
+            nodes[node.prev].next = node.next;
+        } else {
+            heads[node.bucket] = node.next;
+        }
+        if (node.next != NIL) nodes[node.next].prev = node.prev;
+        if (heads[node.bucket] == NIL) {
+            occupied[node.bucket / SLOTS] &= ~(uint64_t(1) << (node.bucket % SLOTS));
+        }
+    }
+    
+    void release(uint32_t index) {
+        Node& node = nodes[index];
+        node.callback = nullptr;
+        node.live = false;
+        node.generation++;
+        node.next = free_head;
+        free_head = index;
+        count--;
+    }
+    
+    // Cascades higher levels whose lower bits rolled over at tick t, then
+    // fires everything in t's level-0 slot
+    void process(uint64_t t) {
+        int top = 0;
+        while (top < LEVELS - 1 && (t & ((uint64_t(1) << (SLOT_BITS * (top + 1))) - 1)) == 0) top++;
+        for (int level = top; level >= 1; --level) {
+            uint32_t bucket = level * SLOTS + static_cast<uint32_t>((t >> (SLOT_BITS * level)) & (SLOTS - 1));
+            while (heads[bucket] != NIL) {
+                uint32_t index = heads[bucket];
+                unlink(index);
+                link(index);
+            }
+        }
+        
+        uint32_t bucket = static_cast<uint32_t>(t & (SLOTS - 1));
+        while (heads[bucket] != NIL) {
+            uint32_t index = heads[bucket];
+            unlink(index);
+            Node& node = nodes[index];
+            if (node.interval) {
+                // Run from a local so the callback may cancel its own timer
+                // or schedule others without invalidating itself
+                node.expiry = t + node.interval;
+                link(index);
+                uint32_t generation = node.generation;
+                std::function<void()> callback = std::move(node.callback);
+                if (callback) callback();
+                if (nodes[index].live && nodes[index].generation == generation) {
+                    nodes[index].callback = std::move(callback);
+                }
+            } else {
+                std::function<void()> callback = std::move(node.callback);
+                release(index);
+                if (callback) callback();
+            }
+        }
+    }
+};
+
+enum class Ease : uint8_t {
+    LINEAR,
+    QUAD_IN, QUAD_OUT, QUAD_IN_OUT,
+    CUBIC_IN, CUBIC_OUT, CUBIC_IN_OUT,
+    SINE_IN_OUT,
+    BACK_OUT,
+    ELASTIC_OUT,
+    BOUNCE_OUT
+};
+
+// Easing curves over t in [0, 1]
+class Easing {
+public:
+    static float apply(Ease ease, float t) {
+        switch (ease) {
+            case Ease::LINEAR: return t;
+            case Ease::QUAD_IN: return t * t;
+            case Ease::QUAD_OUT: return t * (2 - t);
+            case Ease::QUAD_IN_OUT: return t < 0.5f ? 2 * t * t : -1 + (4 - 2 * t) * t;
+            case Ease::CUBIC_IN: return t * t * t;
+            case Ease::CUBIC_OUT: {
+                float u = t - 1;
+                return u * u * u + 1;
+            }
+            case Ease::CUBIC_IN_OUT: {
+                if (t < 0.5f) return 4 * t * t * t;
+                float u = 2 * t - 2;
+                return 0.5f * u * u * u + 1;
+            }
+            case Ease::SINE_IN_OUT: return 0.5f * (1 - std::cos(static_cast<float>(M_PI) * t));
+            case Ease::BACK_OUT: {
+                const float c1 = 1.70158f, c3 = c1 + 1;
+                float u = t - 1;
+                return 1 + c3 * u * u * u + c1 * u * u;
+            }
+            case Ease::ELASTIC_OUT: {
+                if (t <= 0 || t >= 1) return t;
+                return std::pow(2.0f, -10 * t) * std::sin((t * 10 - 0.75f) * (2 * static_cast<float>(M_PI) / 3)) + 1;
+            }
+            case Ease::BOUNCE_OUT: {
+                const float n1 = 7.5625f, d1 = 2.75f;
+                if (t < 1 / d1) return n1 * t * t;
+                if (t < 2 / d1) { t -= 1.5f / d1; return n1 * t * t + 0.75f; }
+                if (t < 2.5f / d1) { t -= 2.25f / d1; return n1 * t * t + 0.9375f; }
+                t -= 2.625f / d1;
+                return n1 * t * t + 0.984375f;
+            }
+        }
+        return t;
+    }
+};
+
+enum class TweenField : uint8_t { X, Y, SCALE_X, SCALE_Y, ROTATION };
+
+struct TweenHandle {
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+// Tweens over SpriteWorld fields. Tracks are stored as parallel arrays and
+// update() evaluates all of them in one pass: progress for every track is
+// computed in a flat loop, then eased values are scattered into the
+// world's SoA fields. Tracks whose sprite was destroyed are dropped.
+class TweenSystem {
+public:
+    explicit TweenSystem(std::shared_ptr<SpriteWorld> world) : world(std::move(world)) {}
+    
+    size_t size() const { return target.size(); }
+    
+    // Tweens from the field's value when the delay elapses to `to`
+    TweenHandle to(SpriteHandle sprite, TweenField field, float to, float duration,
+                   Ease ease = Ease::LINEAR, float delay = 0) {
+        return from_to(sprite, field, NAN, to, duration, ease, delay);
+    }
+    
+    TweenHandle from_to(SpriteHandle sprite, TweenField field, float from, float to, float duration,
+                        Ease ease = Ease::LINEAR, float delay = 0) {
+        uint32_t slot;
+        if (!free_slots.empty()) {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        } else {
+            slot = static_cast<uint32_t>(slot_dense.size());
+            slot_dense.push_back(0);
+            slot_generation.push_back(0);
+        }
+        
+        slot_dense[slot] = static_cast<uint32_t>(size());
+        dense_slot.push_back(slot);
+        target.push_back(sprite);
+        fields.push_back(field);
+        eases.push_back(ease);
+        start.push_back(from);
+        end.push_back(to);
+        elapsed.push_back(-delay);
+        durations.push_back(std::max(duration, 1e-6f));
+        repeats.push_back(0);
+        yoyo.push_back(0);
+        completions.emplace_back();
+        return TweenHandle{slot, slot_generation[slot]};
+    }
+    
+    // Plays the tween count more times (-1 forever), reversing each time
+    // if alternate is set
+    void set_repeat(TweenHandle handle, int count, bool alternate = false) {
+        if (!active(handle)) return;
+        repeats[slot_dense[handle.slot]] = count;
+        yoyo[slot_dense[handle.slot]] = alternate;
+    }
+    
+    void on_complete(TweenHandle handle, std::function<void()> callback) {
+        if (active(handle)) completions[slot_dense[handle.slot]] = std::move(callback);
+    }
+    
+    bool active(TweenHandle handle) const {
+        return handle.slot < slot_generation.size() && slot_generation[handle.slot] == handle.generation &&
+               slot_dense[handle.slot] < size() && dense_slot[slot_dense[handle.slot]] == handle.slot;
+    }
+    
+    void cancel(TweenHandle handle) {
+        if (active(handle)) remove(slot_dense[handle.slot]);
+    }
+    
+    void cancel_all(SpriteHandle sprite) {
+        for (size_t i = size(); i-- > 0;) {
+            if (target[i] == sprite) remove(i);
+        }
+    }
+    
+    void update(float delta_time) {
+        size_t n = size();
+        if (n == 0) return;
+        
+        progress.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            elapsed[i] += delta_time;
+            progress[i] = std::min(std::max(elapsed[i] / durations[i], 0.0f), 1.0f);
+        }
+        
+        finished.clear();
+        touched.clear();
+        for (size_t i = 0; i < n; ++i) {
+            if (!world->alive(target[i])) {
+                finished.push_back(static_cast<uint32_t>(i));
+                continue;
+            }
+            if (elapsed[i] < 0) continue;
+            
+            uint32_t sprite = static_cast<uint32_t>(world->dense_index(target[i].slot));
+            float& value = (world.get()->*FIELDS[static_cast<int>(fields[i])])[sprite];
+            touched.push_back(sprite);
+            if (std::isnan(start[i])) start[i] = value;
+            value = start[i] + (end[i] - start[i]) * Easing::apply(eases[i], progress[i]);
+            
+            if (elapsed[i] < durations[i]) continue;
+            if (repeats[i] == 0) {
+                finished.push_back(static_cast<uint32_t>(i));
+                continue;
+            }
+            if (repeats[i] > 0) repeats[i]--;
+            elapsed[i] = std::fmod(elapsed[i] - durations[i], durations[i]);
+            if (yoyo[i]) std::swap(start[i], end[i]);
+        }
+        // Only tweened sprites changed; several tracks may share one
+        for (uint32_t sprite : touched) world->update_bounds(sprite);
+        
+        // Removal runs back to front so swapped-in tracks are already done
+        callbacks.clear();
+        for (size_t k = finished.size(); k-- > 0;) {
+            uint32_t i = finished[k];
+            if (completions[i]) callbacks.push_back(std::move(completions[i]));
+            remove(i);
+        }
+        for (auto& callback : callbacks) callback();
+    }
+    
+private:
+    static constexpr std::vector<float> SpriteWorld::*FIELDS[] = {
+        &SpriteWorld::x, &SpriteWorld::y, &SpriteWorld::scale_x, &SpriteWorld::scale_y, &SpriteWorld::rotation
+    };
+    
+    std::shared_ptr<SpriteWorld> world;
+    std::vector<SpriteHandle> target;
+    std::vector<TweenField> fields;
+    std::vector<Ease> eases;
+    std::vector<float> start, end;
+    std::vector<float> elapsed;     // negative while the delay runs
+    std::vector<float> durations;
+    std::vector<int> repeats;
+    std::vector<uint8_t> yoyo;
+    std::vector<std::function<void()>> completions;
+    std::vector<float> progress;
+    std::vector<uint32_t> finished;
+    std::vector<uint32_t> touched;     // dense sprite indices written this update
+    std::vector<std::function<void()>> callbacks;
+    
+    std::vector<uint32_t> slot_dense, dense_slot, slot_generation, free_slots;
+    
+    void remove(size_t hole) {
+        size_t last = size() - 1;
+        uint32_t slot = dense_slot[hole];
+        if (hole != last) {
+            dense_slot[hole] = dense_slot[last];
+            slot_dense[dense_slot[hole]] = static_cast<uint32_t>(hole);
+            target[hole] = target[last];
+            fields[hole] = fields[last];
+            eases[hole] = eases[last];
+            start[hole] = start[last];
+            end[hole] = end[last];
+            elapsed[hole] = elapsed[last];
+            durations[hole] = durations[last];
+            repeats[hole] = repeats[last];
+            yoyo[hole] = yoyo[last];
+            completions[hole] = std::move(completions[last]);
+        }
+        dense_slot.pop_back();
+        target.pop_back();
+        fields.pop_back();
+        eases.pop_back();
+        start.pop_back();
+        end.pop_back();
+        elapsed.pop_back();
+        durations.pop_back();
+        repeats.pop_back();
+        yoyo.pop_back();
+        completions.pop_back();
+        
+        slot_generation[slot]++;
+        free_slots.push_back(slot);
+    }
+};
+
+// Physics utilities
+class Physics {
+public:
+    static bool check_collision_circle_circle(
+        const Vector2D& pos1, float radius1,
+        const Vector2D& pos2, float radius2) {
+        return pos1.distance(pos2) < (radius1 + radius2);
+    }
+    
+    static bool check_collision_rect_rect(
+        const Rectangle& rect1, const Rectangle& rect2) {
         return rect1.intersects(rect2);
     }
     
@@ -332,4 +3851,239 @@ public:
     }
 };
 
+// Axis-aligned rigid bodies stepped natively with a fixed timestep. Body
+// state is kept as parallel arrays; a body with mass 0 is static. Each
+// fixed step integrates, finds contacts through a SpatialHash, groups
+// dynamic bodies touching each other into islands with union-find and
+// solves the islands in parallel on the WorkerPool. A static body can
+// touch several islands, so the solver only ever reads its state; each
+// dynamic body belongs to one island and is written only by that solve.
+class PhysicsWorld {
+public:
+    Vector2D gravity;
+    float fixed_step;
+    int max_steps = 8;          // cap per step() call so a stall cannot spiral
+    int iterations = 4;         // solver passes over each island's contacts
+    size_t parallel_threshold = 256; // contacts below which islands solve serially
+    
+    std::vector<float> x, y, vx, vy, width, height;
+    std::vector<float> inverse_mass, restitution;
+    
+    explicit PhysicsWorld(const Vector2D& gravity = Vector2D(0, 980), float fixed_step = 1.0f / 60.0f,
+                          float cell_size = 64.0f)
+        : gravity(gravity), fixed_step(fixed_step), broadphase(cell_size) {}
+    
+    size_t size() const { return x.size(); }
+    
+    size_t add_body(const Rectangle& box, float mass = 1.0f, float bounce = 0.0f) {
+        x.push_back(box.x);
+        y.push_back(box.y);
+        vx.push_back(0);
+        vy.push_back(0);
+        width.push_back(box.width);
+        height.push_back(box.height);
+        inverse_mass.push_back(mass > 0 ? 1.0f / mass : 0.0f);
+        restitution.push_back(bounce);
+        sprites.push_back(nullptr);
+        return x.size() - 1;
+    }
+    
+    // Body starts from the sprite's bounds and velocity. After that the
+    // link is one-way: step() writes the body's state back to the sprite,
+    // but later edits to the sprite are not read back into the body
+    size_t add_body(const std::shared_ptr<Sprite>& sprite, float mass = 1.0f, float bounce = 0.0f) {
+        size_t body = add_body(sprite->bounds, mass, bounce);
+        vx[body] = sprite->velocity.x;
+        vy[body] = sprite->velocity.y;
+        sprites[body] = sprite;
+        return body;
+    }
+    
+    // Swaps the last body into this index
+    void remove_body(size_t body) {
+        size_t last = x.size() - 1;
+        for (auto* field : {&x, &y, &vx, &vy, &width, &height, &inverse_mass, &restitution}) {
+            (*field)[body] = (*field)[last];
+            field->pop_back();
+        }
+        sprites[body] = std::move(sprites[last]);
+        sprites.pop_back();
+    }
+    
+    Rectangle bounds(size_t body) const { return Rectangle(x[body], y[body], width[body], height[body]); }
+    
+    // Advances by delta_time in whole fixed steps and returns how many ran;
+    // the remainder carries over (see alpha() for render interpolation)
+    int step(float delta_time) {
+        accumulator += delta_time;
+        int steps = 0;
+        while (accumulator >= fixed_step && steps < max_steps) {
+            fixed_update();
+            accumulator -= fixed_step;
+            steps++;
+        }
+        if (steps == max_steps) accumulator = std::min(accumulator, fixed_step);
+        
+        for (size_t i = 0; i < sprites.size(); ++i) {
+            if (!sprites[i]) continue;
+            sprites[i]->position = Vector2D(x[i], y[i]);
+            sprites[i]->velocity = Vector2D(vx[i], vy[i]);
+            sprites[i]->update_bounds();
+        }
+        return steps;
+    }
+    
+    float alpha() const { return accumulator / fixed_step; }
+    
+    // Contacts found during the last fixed step, as body index pairs
+    const std::vector<std::pair<uint32_t, uint32_t>>& contacts() const { return pairs; }
+    
+    void fixed_update() {
+        size_t n = x.size();
+        float gx = gravity.x * fixed_step, gy = gravity.y * fixed_step;
+        previous_x = x;
+        previous_y = y;
+        for (size_t i = 0; i < n; ++i) {
+            if (inverse_mass[i] == 0) continue;
+            vx[i] += gx;
+            vy[i] += gy;
+            x[i] += vx[i] * fixed_step;
+            y[i] += vy[i] * fixed_step;
+        }
+        
+        broadphase.clear();
+        for (size_t i = 0; i < n; ++i) broadphase.insert(static_cast<uint32_t>(i), bounds(i));
+        pairs = broadphase.candidate_pairs();
+        build_islands();
+        
+        auto solve = [this](size_t island) {
+            for (int pass = 0; pass < iterations; ++pass) {
+                for (uint32_t c = island_start[island]; c < island_start[island + 1]; ++c) {
+                    resolve(pairs[island_contacts[c]].first, pairs[island_contacts[c]].second);
+                }
+            }
+        };
+        size_t islands = island_start.empty() ? 0 : island_start.size() - 1;
+        if (pairs.size() >= parallel_threshold) {
+            WorkerPool::shared().run(islands, solve);
+        } else {
+            for (size_t island = 0; island < islands; ++island) solve(island);
+        }
+    }
+    
+private:
+    SpatialHash broadphase;
+    std::vector<std::shared_ptr<Sprite>> sprites;
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    std::vector<float> previous_x, previous_y;
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> island_of;
+    std::vector<uint32_t> island_start;
+    std::vector<uint32_t> island_contacts;
+    float accumulator = 0;
+    
+    uint32_t find(uint32_t i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+    
+    // Buckets contacts by the island of their dynamic body
+    void build_islands() {
+        size_t n = x.size();
+        parent.resize(n);
+        for (uint32_t i = 0; i < n; ++i) parent[i] = i;
+        for (const auto& [a, b] : pairs) {
+            if (inverse_mass[a] == 0 || inverse_mass[b] == 0) continue;
+            uint32_t ra = find(a), rb = find(b);
+            if (ra != rb) parent[ra] = rb;
+        }
+        
+        island_of.assign(n, UINT32_MAX);
+        island_start.assign(1, 0);
+        std::vector<uint32_t> contact_island(pairs.size(), UINT32_MAX);
+        for (size_t c = 0; c < pairs.size(); ++c) {
+            uint32_t body = inverse_mass[pairs[c].first] != 0 ? pairs[c].first : pairs[c].second;
+            if (inverse_mass[body] == 0) continue;
+            uint32_t root = find(body);
+            if (island_of[root] == UINT32_MAX) {
+                island_of[root] = static_cast<uint32_t>(island_start.size() - 1);
+                island_start.push_back(0);
+            }
+            contact_island[c] = island_of[root];
+            island_start[island_of[root] + 1]++;
+        }
+        for (size_t i = 1; i < island_start.size(); ++i) island_start[i] += island_start[i - 1];
+        
+        // Contacts against statics go last in each island, so the static
+        // body has the final word in every solver pass
+        island_contacts.resize(island_start.back());
+        std::vector<uint32_t> cursor(island_start.begin(), island_start.end() - 1);
+        for (int statics = 0; statics < 2; ++statics) {
+            for (uint32_t c = 0; c < pairs.size(); ++c) {
+                bool against_static = inverse_mass[pairs[c].first] == 0 || inverse_mass[pairs[c].second] == 0;
+                if (contact_island[c] != UINT32_MAX && against_static == (statics == 1)) {
+                    island_contacts[cursor[contact_island[c]]++] = c;
+                }
+            }
+        }
+    }
+    
+    // Separates along the axis the bodies were apart on before this step
+    // (least penetration when ambiguous), then applies a restitution
+    // impulse if they are still approaching. Using the pre-step axis keeps
+    // deep contacts, such as a heavy stack on the floor, from being pushed
+    // out sideways.
+    void resolve(uint32_t a, uint32_t b) {
+        // Distance b must move along +x / -x (+y / -y) to clear a
+        float right = x[a] + width[a] - x[b], left = x[b] + width[b] - x[a];
+        float down = y[a] + height[a] - y[b], up = y[b] + height[b] - y[a];
+        float depth_x = std::min(right, left), depth_y = std::min(down, up);
+        if (depth_x <= 0 || depth_y <= 0) return;
+        
+        float total = inverse_mass[a] + inverse_mass[b];
+        if (total == 0) return;
+        
+        bool was_x = std::min(previous_x[a] + width[a] - previous_x[b], previous_x[b] + width[b] - previous_x[a]) <= 0;
+        bool was_y = std::min(previous_y[a] + height[a] - previous_y[b], previous_y[b] + height[b] - previous_y[a]) <= 0;
+        bool along_x = was_x != was_y ? was_x : depth_x < depth_y;
+        
+        float nx = 0, ny = 0, depth;
+        if (along_x) {
+            nx = right < left ? 1.0f : -1.0f;
+            depth = depth_x;
+        } else {
+            ny = down < up ? 1.0f : -1.0f;
+            depth = depth_y;
+        }
+        
+        // Statics are shared between islands solving in parallel, so
+        // they must not be written even with a zero change
+        float share_a = inverse_mass[a] / total, share_b = inverse_mass[b] / total;
+        if (inverse_mass[a] != 0) {
+            x[a] -= nx * depth * share_a;
+            y[a] -= ny * depth * share_a;
+        }
+        if (inverse_mass[b] != 0) {
+            x[b] += nx * depth * share_b;
+            y[b] += ny * depth * share_b;
+        }
+        
+        float approach = (vx[b] - vx[a]) * nx + (vy[b] - vy[a]) * ny;
+        if (approach >= 0) return;
+        float e = std::min(restitution[a], restitution[b]);
+        float impulse = -(1 + e) * approach / total;
+        if (inverse_mass[a] != 0) {
+            vx[a] -= impulse * nx * inverse_mass[a];
+            vy[a] -= impulse * ny * inverse_mass[a];
+        }
+        if (inverse_mass[b] != 0) {
+            vx[b] += impulse * nx * inverse_mass[b];
+            vy[b] += impulse * ny * inverse_mass[b];
+        }
+    }
+};
+
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <memory>
 #include <variant>
@@ -8,6 +10,9 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <array>
+#include <map>
+#include <chrono>
 
 namespace replit {
 
@@ -20,8 +25,8 @@ enum class TokenType {
     CONST, VAR, LET, FN, LAMBDA, ASYNC, AWAIT,
     IF, ELSE, ELIF, SWITCH, CASE, DEFAULT,
     WHILE, FOR, FOREACH, LOOP, BREAK, CONTINUE,
-    RETURN, YIELD, THROW, TRY, CATCH, FINALLY,
-    TRUE, FALSE, NULL_TOK, UNDEFINED,
+    RETURN, YIELD, THROW, TRY, CATCH, FINALLY, PRINT,
+    TRUE, FALSE, NULL_TOK, NIL, UNDEFINED,
     
     // Types
     INT, FLOAT, DOUBLE, BOOL, STRING_TYPE, CHAR_TYPE,
@@ -70,8 +75,12 @@ class Window;
 class Sprite;
 class Vector2D;
 class Color;
+class DataFrame;
+class Matrix;
 
-using Value = std::variant<
+// A struct rather than an alias so the variant can name Value in its
+// collection alternatives
+struct Value : std::variant<
     double, float, int64_t, 
     std::string, char, bool, std::nullptr_t,
     std::shared_ptr<ReplitObject>,
@@ -81,28 +90,145 @@ using Value = std::variant<
     std::shared_ptr<Sprite>,
     std::shared_ptr<Vector2D>,
     std::shared_ptr<Color>,
+    std::shared_ptr<DataFrame>,
+    std::shared_ptr<Matrix>,    // reserved; scripts cannot create one yet
     std::vector<Value>,
     std::unordered_map<std::string, Value>
->;
+> {
+    using variant::variant;
+    using variant::operator=;
+};
 
 enum class OpCode {
     OP_CONSTANT, OP_ADD, OP_SUBTRACT, OP_MULTIPLY, OP_DIVIDE,
     OP_NEGATE, OP_NOT, OP_EQUAL, OP_GREATER, OP_LESS,
     OP_PRINT, OP_POP, OP_DEFINE_GLOBAL, OP_GET_GLOBAL,
     OP_SET_GLOBAL, OP_JUMP_IF_FALSE, OP_JUMP, OP_LOOP,
-    OP_CALL, OP_RETURN, OP_HALT
+    OP_CALL, OP_RETURN, OP_HALT,
+    
+    // Quickened forms. Only the VM writes these, in place of the generic
+    // instruction once it has seen the operand types they assume.
+    OP_ADD_NUM, OP_ADD_STR, OP_SUBTRACT_NUM, OP_MULTIPLY_NUM, OP_DIVIDE_NUM,
+    OP_EQUAL_NUM, OP_GREATER_NUM, OP_LESS_NUM,
+    
+    // Superinstructions emitted by the Parser: OP_CONSTANT fused with the
+    // instruction that consumes it. The operand is the constant index.
+    OP_ADD_CONSTANT, OP_SUBTRACT_CONSTANT, OP_MULTIPLY_CONSTANT, OP_DIVIDE_CONSTANT,
+    OP_EQUAL_CONSTANT, OP_GREATER_CONSTANT, OP_LESS_CONSTANT, OP_PRINT_CONSTANT,
+    
+    // Locals, addressed by stack slot relative to the start of the run
+    OP_GET_LOCAL, OP_SET_LOCAL,
+    
+    // Superinstructions: a *_CONSTANT compare fused with the
+    // OP_JUMP_IF_FALSE that tests it. The operands are the constant index
+    // and the jump offset; the result stays on the stack as the jump's does.
+    OP_EQUAL_CONSTANT_JUMP, OP_GREATER_CONSTANT_JUMP, OP_LESS_CONSTANT_JUMP
 };
 
+const char* opcode_name(uint8_t op);
+// Maps a quickened opcode back to the instruction the compiler emitted
+OpCode generic_opcode(OpCode op);
+// The operation a superinstruction applies after pushing its constant;
+// other opcodes map to themselves
+OpCode unfused_opcode(OpCode op);
+// The compare a compare-and-branch runs before its jump; other opcodes
+// map to themselves
+OpCode unbranched_opcode(OpCode op);
+// Operand bytes following the opcode
+int opcode_operand_bytes(uint8_t op);
+
+class JitCode;
+
 class Chunk {
 public:
     std::vector<uint8_t> code;
     std::vector<int> lines;
     std::vector<Value> constants;
     
+    // Tiering state: runs from the start, and the compiled form once the
+    // VM's threshold is reached (jit_failed marks chunks not worth retrying)
+    uint32_t executions = 0;
+    std::shared_ptr<JitCode> jit;
+    bool jit_failed = false;
+    // Type misses in quickened instructions; past a limit the chunk stops
+    // quickening so polymorphic sites do not flip back and forth
+    uint32_t quicken_misses = 0;
+    // Backward branches taken per loop header offset, and the compiled
+    // entries for loops that got hot (nullptr records a failed compile)
+    std::vector<uint32_t> backedges;
+    std::unordered_map<uint32_t, std::shared_ptr<JitCode>> loop_jit;
+    // Instructions per loop body by header offset (0 until first needed),
+    // charged per iteration against an instruction budget
+    std::vector<uint32_t> loop_costs;
+    
+    uint32_t backedge_count(size_t loop_start) const {
+        return loop_start < backedges.size() ? backedges[loop_start] : 0;
+    }
+    
     void write(uint8_t byte, int line);
     int add_constant(Value value);
 };
 
+// Checks bytecode that did not come from the Parser before the VM runs
+// it: known opcodes, jumps onto instruction starts inside the chunk,
+// constant and local indices in range, no stack underflow and the same
+// stack depth on every path into an instruction. Throws std::runtime_error.
+void verify_chunk(const Chunk& chunk);
+
+// Unboxed stack slot used by compiled code. Numbers keep their IEEE bits,
+// bools are 0/1 and nil has no payload.
+struct JitSlot {
+    uint64_t tag;
+    uint64_t bits;
+};
+
+// Baseline template JIT for x86-64. Each opcode is copied in as a fixed
+// machine-code template over a slot array whose depth is known at compile
+// time, so there is no dispatch and no stack pointer. Arithmetic and
+// comparisons are specialised for numbers; operands whose type is not known
+// statically are guarded, as are all slots at branch targets. Every exit -
+// a failed guard, an opcode without a template, a branch leaving the
+// compiled region, or OP_RETURN - reports the bytecode offset and slot
+// depth at which the interpreter resumes.
+class JitCode {
+public:
+    enum Tag : uint64_t { NUMBER = 0, BOOL = 1, NIL = 2 };
+    using Entry = uint32_t (*)(JitSlot* slots, uint32_t* depth);
+    
+    // Returns nullptr on unsupported platforms or when the chunk does not
+    // start with anything the JIT can run
+    static std::unique_ptr<JitCode> compile(const Chunk& chunk);
+    // Compiles the loop [loop_start, loop_end) for entry from its header
+    // with entry_depth values already on the stack. Loops containing an
+    // instruction without a template are rejected, since every iteration
+    // would bounce back to the interpreter.
+    static std::unique_ptr<JitCode> compile_loop(const Chunk& chunk, size_t loop_start,
+                                                 size_t loop_end, size_t entry_depth);
+    static bool supported();
+    
+    ~JitCode();
+    JitCode(const JitCode&) = delete;
+    JitCode& operator=(const JitCode&) = delete;
+    
+    uint32_t enter(JitSlot* slots, uint32_t* depth) const { return entry(slots, depth); }
+    size_t slots_needed() const { return max_depth; }
+    size_t entry_slots() const { return entry_depth; }
+    size_t code_size() const { return length; }
+    
+private:
+    JitCode() = default;
+    
+    void* memory = nullptr;
+    size_t mapped = 0;
+    size_t length = 0;
+    size_t max_depth = 0;
+    size_t entry_depth = 0;
+    Entry entry = nullptr;
+    
+    static std::unique_ptr<JitCode> compile_region(const Chunk& chunk, size_t start, size_t end,
+                                                   size_t entry_depth, bool strict);
+};
+
 class Lexer {
 private:
     std::string source;
@@ -134,9 +260,29 @@ private:
     std::vector<Token> tokens;
     size_t current = 0;
     Chunk* compiling_chunk = nullptr;
+    // Offsets of the last OP_CONSTANT and of the last superinstruction,
+    // and the lowest offset a fusion may start at (no jump may land inside
+    // a superinstruction)
+    size_t last_constant = SIZE_MAX;
+    size_t last_fused = SIZE_MAX;
+    size_t fusion_barrier = 0;
     bool had_error = false;
     bool panic_mode = false;
     
+    // Locals are resolved at compile time. A local's index is its stack
+    // slot, so declarations fill consecutive slots and a closed scope's
+    // slots are reused by the next one: frames stay dense and small enough
+    // for the JIT to address every local at a fixed offset.
+    struct Local {
+        std::string name;
+        int depth;  // -1 until the initializer has been compiled
+        int line;
+        bool read;
+    };
+    std::vector<Local> locals;
+    int scope_depth = 0;
+    std::vector<std::string> warning_messages;
+    
     Token previous();
     Token peek();
     bool check(TokenType type);
@@ -145,6 +291,7 @@ private:
     void consume(TokenType type, const std::string& message);
     void error_at(Token token, const std::string& message);
     void error(const std::string& message);
+    void warning(int line, const std::string& message);
     void synchronize();
     
     void emit_byte(uint8_t byte);
@@ -152,8 +299,24 @@ private:
     void emit_return();
     uint8_t make_constant(Value value);
     void emit_constant(Value value);
+    // Emits op, fused into the preceding OP_CONSTANT when possible
+    void emit_fused(OpCode op);
+    // Emits a jump; OP_JUMP_IF_FALSE is fused into a preceding *_CONSTANT
+    // compare when possible
+    size_t emit_jump(OpCode op);
+    void patch_jump(size_t offset);
+    size_t mark_loop_start();
+    void emit_loop(size_t loop_start);
+    
+    void begin_scope();
+    void end_scope();
+    void declare_local(const Token& name);
+    int resolve_local(const Token& name);
+    uint8_t identifier_constant(const Token& name);
+    void named_variable(const Token& name, bool assign);
     
     void expression();
+    void assignment();
     void or_expression();
     void and_expression();
     void equality();
@@ -163,6 +326,11 @@ private:
     void unary();
     void primary();
     void statement();
+    void skip_newlines();
+    void block();
+    void if_statement();
+    void while_statement();
+    void for_statement();
     void print_statement();
     void expression_statement();
     void declaration();
@@ -170,9 +338,130 @@ private:
     
 public:
     bool compile(const std::vector<Token>& tokens, Chunk* chunk);
+    // Diagnostics that do not fail compilation, such as unread locals
+    const std::vector<std::string>& warnings() const { return warning_messages; }
+};
+
+// Opt-in VM profiler. While attached, the VM reports every instruction
+// through enter(), which counts executions and attributes elapsed cycles
+// to the previous opcode. A SIGPROF timer, armed on the first begin()
+// and kept running until destruction, records the offset of the executing
+// instruction into a ring; end() folds those offsets into source lines via
+// Chunk::lines.
+class Profiler {
+public:
+    explicit Profiler(int sample_hz = 1000);
+    ~Profiler();
+    
+    void begin(const Chunk& chunk);
+    void end();
+    
+    void enter(size_t offset, uint8_t op) {
+        uint64_t now = read_cycles();
+        if (last_op >= 0) {
+            cycles[last_op] += now - last_cycles;
+            pair_counts[(last_op << 8) | op]++;
+        }
+        counts[op]++;
+        last_cycles = now;
+        last_op = op;
+        current_offset.store(static_cast<uint32_t>(offset), std::memory_order_relaxed);
+    }
+    
+    uint64_t count(uint8_t op) const { return counts[op]; }
+    uint64_t cycle_count(uint8_t op) const { return cycles[op]; }
+    // Times `second` executed directly after `first`
+    uint64_t pair_count(uint8_t first, uint8_t second) const { return pair_counts[(first << 8) | second]; }
+    uint64_t sample_count() const { return total_samples; }
+    const std::map<int, uint64_t>& line_samples() const { return line_hits; }
+    
+    // Opcode table and hottest lines, as text
+    std::string report() const;
+    // One "root;line_N;OP_NAME count" row per sampled site, the input
+    // format of flamegraph.pl and speedscope
+    std::string folded(const std::string& root = "script") const;
+    bool write_folded(const std::string& path, const std::string& root = "script") const;
+    
+    static uint64_t read_cycles();
+    
+private:
+    int sample_hz;
+    std::array<uint64_t, 256> counts{};
+    std::array<uint64_t, 256> cycles{};
+    std::vector<uint64_t> pair_counts = std::vector<uint64_t>(256 * 256);
+    uint64_t last_cycles = 0;
+    int last_op = -1;
+    
+    static constexpr uint32_t SAMPLE_RING = 1 << 14;
+    std::atomic<uint32_t> current_offset{UINT32_MAX};
+    std::array<std::atomic<uint32_t>, SAMPLE_RING> sample_ring{};
+    std::atomic<uint32_t> ring_head{0};
+    uint32_t ring_tail = 0;
+    bool timer_armed = false;
+    const Chunk* active_chunk = nullptr;
+    
+    uint64_t total_samples = 0;
+    std::map<int, uint64_t> line_hits;
+    std::map<std::pair<int, uint8_t>, uint64_t> site_hits;
+    
+    static void on_signal(int);
+};
+
+// A saved VM state: globals and named compiled chunks in one image whose
+// tables refer to each other by offset and index, so it works wherever it
+// is mapped. Each distinct string is stored once. Opened images are mapped
+// read-only and private; nothing is decoded up front.
+class Snapshot {
+public:
+    // Throws std::runtime_error for values holding native objects
+    static void write(const std::string& path,
+                      const std::unordered_map<std::string, Value>& globals,
+                      const std::map<std::string, const Chunk*>& chunks = {});
+    // Throws std::runtime_error when the file is missing or not an image
+    static std::shared_ptr<const Snapshot> open(const std::string& path);
+    ~Snapshot();
+    
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+    
+    size_t global_count() const;
+    std::vector<std::string> global_names() const;
+    // Decodes one global; false when the image does not define it
+    bool find_global(const std::string& name, Value& value) const;
+    std::vector<std::string> chunk_names() const;
+    bool load_chunk(const std::string& name, Chunk& chunk) const;
+    
+private:
+    Snapshot() = default;
+    
+    void* memory = nullptr;
+    size_t mapped = 0;
+    
+    const uint8_t* base() const;
+    bool valid() const;
+    // Views into the mapping, valid for the snapshot's lifetime
+    std::string_view string_at(uint32_t index) const;
+    Value value_at(uint32_t index, int depth = 0) const;
+};
+
+// Bounds on a single run of untrusted code; zero leaves a bound unset.
+// Instructions are charged a loop body at a time on each backward branch.
+// The allocation budget bounds the string and global bytes the run holds
+// live beyond what the VM held when it started: copies onto the stack or
+// into variables are charged, and values popped or overwritten are
+// credited back.
+struct ExecutionLimits {
+    uint64_t max_instructions = 0;
+    size_t max_allocated_bytes = 0;
+    std::chrono::milliseconds timeout{0};
 };
 
 class VM {
+public:
+    enum class Limit {
+        NONE, INSTRUCTIONS, ALLOCATION, TIME
+    };
+    
 private:
     Chunk* chunk = nullptr;
     uint8_t* ip = nullptr;
@@ -187,15 +476,69 @@ private:
     bool values_equal(Value a, Value b);
     void runtime_error(const std::string& message);
     
+    Profiler* profiler = nullptr;
+    uint32_t jit_threshold = 16;
+    std::vector<JitSlot> jit_slots;
+    // Stack size when the current run started; compiled code owns the
+    // values above it
+    size_t stack_base = 0;
+    
+    bool run_compiled(const JitCode& code);
+    void enter_loop(size_t loop_start, size_t loop_end);
+    
+    ExecutionLimits limits;
+    bool limited = false;
+    Limit exceeded = Limit::NONE;
+    uint64_t instructions_charged = 0;
+    // Charged count at which the budget and the clock are next checked
+    uint64_t next_check = 0;
+    // Net bytes charged this run; negative once it has released values
+    // that were live before it started
+    int64_t live_bytes = 0;
+    std::chrono::steady_clock::time_point deadline;
+    
+    uint32_t loop_cost(size_t loop_start, size_t loop_end);
+    bool charge_instructions(uint64_t count);
+    bool charge_allocation(size_t bytes);
+    void credit_allocation(const Value& value);
+    void limit_error();
+    
+    std::shared_ptr<const Snapshot> snapshot;
+    Value* find_global(const std::string& name);
+    
 public:
     enum class InterpretResult {
-        OK, COMPILE_ERROR, RUNTIME_ERROR
+        OK, COMPILE_ERROR, RUNTIME_ERROR, LIMIT_EXCEEDED
     };
     
     VM();
     ~VM();
     InterpretResult interpret(const std::string& source);
     InterpretResult run();
+    // Executes an already-compiled chunk, e.g. one reused across runs
+    InterpretResult run(Chunk& compiled);
+    
+    // Instruments subsequent runs; pass nullptr to detach
+    void set_profiler(Profiler* attached) { profiler = attached; }
+    // Chunks are compiled after this many runs from the start, loops after
+    // 64 times as many iterations; 0 disables the JIT
+    void set_jit_threshold(uint32_t runs) { jit_threshold = runs; }
+    // Applies to every subsequent run. Limited runs stay in the interpreter,
+    // since compiled code does not come back to it to be checked.
+    void set_limits(const ExecutionLimits& bounds);
+    
+    // Writes every global, including ones still only in an attached image,
+    // and the given chunks
+    void save_snapshot(const std::string& path, const std::map<std::string, const Chunk*>& chunks = {}) const;
+    // Serves globals the VM does not define from the image, copying each
+    // into the VM on first use; definitions made afterwards take precedence
+    void attach_snapshot(std::shared_ptr<const Snapshot> image) { snapshot = std::move(image); }
+    // Which limit stopped the last run that returned LIMIT_EXCEEDED
+    Limit exceeded_limit() const { return exceeded; }
+    
+private:
+    template<bool Profiled>
+    InterpretResult execute();
 };
 
 class ReplitEngine {
@@ -203,8 +546,28 @@ public:
     VM vm;
     
     std::string run_code(const std::string& code);
+    // Source already compiled by this engine or found in the restored
+    // image is not compiled again
     bool run_file(const std::string& filename);
+    // Compiles without running, so the next snapshot carries the chunk
+    bool compile_file(const std::string& filename);
+    // Runs the file under the profiler, prints the report to stderr and
+    // writes folded stacks to folded_path
+    bool profile_file(const std::string& filename, const std::string& folded_path);
+    // Saves the globals built so far and the chunks of every file compiled
+    // to an image for later warm starts
+    bool save_snapshot(const std::string& path);
+    // Maps an image; its globals are loaded as scripts first use them, its
+    // chunks when a file with the same source is run
+    bool restore_snapshot(const std::string& path);
     void start_repl();
+    
+private:
+    // Keyed by a hash of the source, so an edited file is compiled afresh
+    std::map<std::string, Chunk> chunks;
+    std::shared_ptr<const Snapshot> restored;
+    
+    Chunk* chunk_for(const std::string& filename, const std::string& source);
 };
 
 }
\ No newline at end of file
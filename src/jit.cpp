@@ -0,0 +1,595 @@
+#include "replit_core.hpp"
+#include <cstring>
+#include <iostream>
+#include <map>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define REPLIT_JIT 1
+#endif
+
+namespace replit {
+
+void print_value(Value value);
+
+#if REPLIT_JIT
+
+namespace {
+
+// Called from compiled code for OP_PRINT; slots only ever hold numbers,
+// bools and nil
+void jit_print(const JitSlot* slot) {
+    if (slot->tag == JitCode::NUMBER) {
+        double number;
+        std::memcpy(&number, &slot->bits, sizeof(number));
+        print_value(number);
+    } else if (slot->tag == JitCode::BOOL) {
+        print_value(slot->bits != 0);
+    } else {
+        print_value(nullptr);
+    }
+    std::cout << std::endl;
+}
+
+// Static type of a slot during compilation
+enum class Known { NUMBER, BOOL, NIL, UNKNOWN };
+
+// Minimal x86-64 emitter. Slots are addressed as [rbx + disp32], the exit
+// depth is written through r12.
+class Emitter {
+public:
+    std::vector<uint8_t> code;
+    
+    void byte(uint8_t b) { code.push_back(b); }
+    void bytes(std::initializer_list<uint8_t> list) { code.insert(code.end(), list); }
+    
+    void imm32(uint32_t value) {
+        for (int i = 0; i < 4; ++i) byte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+    
+    void imm64(uint64_t value) {
+        for (int i = 0; i < 8; ++i) byte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+    
+    static uint32_t tag_disp(size_t slot) { return static_cast<uint32_t>(slot * sizeof(JitSlot)); }
+    static uint32_t bits_disp(size_t slot) { return tag_disp(slot) + 8; }
+    
+    // push rbx; push r12; sub rsp, 8; mov rbx, rdi; mov r12, rsi
+    void prologue() {
+        bytes({0x53, 0x41, 0x54, 0x48, 0x83, 0xEC, 0x08, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4});
+    }
+    
+    // mov dword [r12], depth; mov eax, offset; add rsp, 8; pop r12; pop rbx; ret
+    void exit(uint32_t offset, uint32_t depth) {
+        bytes({0x41, 0xC7, 0x04, 0x24});
+        imm32(depth);
+        byte(0xB8);
+        imm32(offset);
+        bytes({0x48, 0x83, 0xC4, 0x08, 0x41, 0x5C, 0x5B, 0xC3});
+    }
+    
+    // mov qword [rbx + tag], tag; mov rax, bits; mov [rbx + bits], rax
+    void store_slot(size_t slot, uint64_t tag, uint64_t bits) {
+        bytes({0x48, 0xC7, 0x83});
+        imm32(tag_disp(slot));
+        imm32(static_cast<uint32_t>(tag));
+        bytes({0x48, 0xB8});
+        imm64(bits);
+        bytes({0x48, 0x89, 0x83});
+        imm32(bits_disp(slot));
+    }
+    
+    void store_tag(size_t slot, uint64_t tag) {
+        bytes({0x48, 0xC7, 0x83});
+        imm32(tag_disp(slot));
+        imm32(static_cast<uint32_t>(tag));
+    }
+    
+    // cmp qword [rbx + disp], imm8; j<cc> <patched later>. Returns the
+    // rel32 position to patch.
+    size_t compare_jump(uint32_t disp, uint8_t imm, uint8_t condition) {
+        bytes({0x48, 0x83, 0xBB});
+        imm32(disp);
+        byte(imm);
+        bytes({0x0F, condition});
+        size_t patch = code.size();
+        imm32(0);
+        return patch;
+    }
+    
+    size_t guard_tag(size_t slot, uint64_t tag) {
+        return compare_jump(tag_disp(slot), static_cast<uint8_t>(tag), 0x85);
+    }
+    
+    // cmp qword [rbx + disp], imm8; jne over the next compare_jump
+    void compare_skip(uint32_t disp, uint8_t imm) {
+        bytes({0x48, 0x83, 0xBB});
+        imm32(disp);
+        byte(imm);
+        bytes({0x75, 14});
+    }
+    
+    // jmp <patched later>
+    size_t jump() {
+        byte(0xE9);
+        size_t patch = code.size();
+        imm32(0);
+        return patch;
+    }
+    
+    // movsd xmm0, [rbx + bits]
+    void load_xmm0(size_t slot) {
+        bytes({0xF2, 0x0F, 0x10, 0x83});
+        imm32(bits_disp(slot));
+    }
+    
+    // movsd [rbx + bits], xmm0
+    void store_xmm0(size_t slot) {
+        bytes({0xF2, 0x0F, 0x11, 0x83});
+        imm32(bits_disp(slot));
+    }
+    
+    // <op>sd xmm0, [rbx + bits] for addsd/subsd/mulsd/divsd
+    void arith_xmm0(uint8_t opcode, size_t slot) {
+        bytes({0xF2, 0x0F, opcode, 0x83});
+        imm32(bits_disp(slot));
+    }
+    
+    // ucomisd xmm0, [rbx + bits]
+    void compare_xmm0(size_t slot) {
+        bytes({0x66, 0x0F, 0x2E, 0x83});
+        imm32(bits_disp(slot));
+    }
+    
+    // mov rax, [rbx + bits a]; cmp rax, [rbx + bits b]
+    void compare_bits(size_t a, size_t b) {
+        bytes({0x48, 0x8B, 0x83});
+        imm32(bits_disp(a));
+        bytes({0x48, 0x3B, 0x83});
+        imm32(bits_disp(b));
+    }
+    
+    // movzx eax, al; mov [rbx + bits], rax
+    void store_al_as_bool(size_t slot) {
+        bytes({0x0F, 0xB6, 0xC0, 0x48, 0x89, 0x83});
+        imm32(bits_disp(slot));
+    }
+    
+    // btc qword [rbx + bits], 63
+    void flip_sign(size_t slot) {
+        bytes({0x48, 0x0F, 0xBA, 0xBB});
+        imm32(bits_disp(slot));
+        byte(63);
+    }
+    
+    // xor qword [rbx + bits], 1
+    void flip_bool(size_t slot) {
+        bytes({0x48, 0x83, 0xB3});
+        imm32(bits_disp(slot));
+        byte(1);
+    }
+    
+    // mov rax, [rbx + tag from]; mov rcx, [rbx + bits from];
+    // mov [rbx + tag to], rax; mov [rbx + bits to], rcx
+    void copy_slot(size_t from, size_t to) {
+        bytes({0x48, 0x8B, 0x83});
+        imm32(tag_disp(from));
+        bytes({0x48, 0x8B, 0x8B});
+        imm32(bits_disp(from));
+        bytes({0x48, 0x89, 0x83});
+        imm32(tag_disp(to));
+        bytes({0x48, 0x89, 0x8B});
+        imm32(bits_disp(to));
+    }
+    
+    // lea rdi, [rbx + tag]; mov rax, target; call rax
+    void call_with_slot(size_t slot, const void* target) {
+        bytes({0x48, 0x8D, 0xBB});
+        imm32(tag_disp(slot));
+        bytes({0x48, 0xB8});
+        imm64(reinterpret_cast<uint64_t>(target));
+        bytes({0xFF, 0xD0});
+    }
+    
+    void patch(size_t at, size_t target) {
+        uint32_t rel = static_cast<uint32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 4));
+        std::memcpy(&code[at], &rel, sizeof(rel));
+    }
+};
+
+struct PendingExit {
+    size_t patch;
+    uint32_t offset;
+    uint32_t depth;
+};
+
+}
+
+bool JitCode::supported() { return true; }
+
+std::unique_ptr<JitCode> JitCode::compile(const Chunk& chunk) {
+    return compile_region(chunk, 0, chunk.code.size(), 0, false);
+}
+
+std::unique_ptr<JitCode> JitCode::compile_loop(const Chunk& chunk, size_t loop_start,
+                                               size_t loop_end, size_t entry_depth) {
+    return compile_region(chunk, loop_start, std::min(loop_end, chunk.code.size()), entry_depth, true);
+}
+
+std::unique_ptr<JitCode> JitCode::compile_region(const Chunk& chunk, size_t start, size_t end,
+                                                 size_t entry_depth, bool strict) {
+    Emitter emit;
+    std::vector<PendingExit> exits;
+    std::vector<PendingExit> branches;
+    std::vector<Known> types(entry_depth, Known::UNKNOWN);
+    size_t max_depth = entry_depth;
+    size_t compiled_ops = 0;
+    
+    // Branch targets inside the region become labels. Their slot depth is
+    // recorded by the first edge reaching them and must agree with the rest.
+    std::map<size_t, size_t> labels;
+    std::map<size_t, size_t> label_depth;
+    auto branch_target = [&](size_t pc) -> size_t {
+        size_t next = pc + 1 + opcode_operand_bytes(chunk.code[pc]);
+        uint16_t distance = static_cast<uint16_t>((chunk.code[next - 2] << 8) | chunk.code[next - 1]);
+        if (static_cast<OpCode>(chunk.code[pc]) == OpCode::OP_LOOP) return next - distance;
+        return next + distance;
+    };
+    for (size_t pc = start; pc < end; pc += 1 + opcode_operand_bytes(chunk.code[pc])) {
+        OpCode op = static_cast<OpCode>(chunk.code[pc]);
+        bool jumps = op == OpCode::OP_JUMP || op == OpCode::OP_JUMP_IF_FALSE || op == OpCode::OP_LOOP ||
+                     unbranched_opcode(op) != op;
+        if (jumps && pc + opcode_operand_bytes(chunk.code[pc]) < end) {
+            size_t target = branch_target(pc);
+            if (target >= start && target < end) labels[target] = SIZE_MAX;
+        }
+    }
+    
+    // Exits resume at the start of the current instruction, with the depth
+    // it started from even if a fused constant was already stored
+    size_t resume_depth = 0;
+    auto exit_here = [&](uint32_t offset) {
+        exits.push_back({emit.jump(), offset, static_cast<uint32_t>(resume_depth)});
+    };
+    
+    // Guards a slot unless its type is already known; returns false when
+    // it is known to be something else, in which case the op must exit
+    auto require = [&](size_t slot, Known wanted, uint64_t tag, uint32_t offset) {
+        if (types[slot] == wanted) return true;
+        if (types[slot] != Known::UNKNOWN) return false;
+        exits.push_back({emit.guard_tag(slot, tag), offset, static_cast<uint32_t>(resume_depth)});
+        types[slot] = wanted;
+        return true;
+    };
+    
+    // Stores a constant into the next slot; false for constants that
+    // cannot be unboxed
+    auto push_constant = [&](uint8_t index) {
+        const Value& constant = chunk.constants[index];
+        size_t slot = types.size();
+        if (std::holds_alternative<double>(constant)) {
+            uint64_t bits;
+            double number = std::get<double>(constant);
+            std::memcpy(&bits, &number, sizeof(bits));
+            emit.store_slot(slot, NUMBER, bits);
+            types.push_back(Known::NUMBER);
+        } else if (std::holds_alternative<bool>(constant)) {
+            emit.store_slot(slot, BOOL, std::get<bool>(constant) ? 1 : 0);
+            types.push_back(Known::BOOL);
+        } else if (std::holds_alternative<std::nullptr_t>(constant)) {
+            emit.store_slot(slot, NIL, 0);
+            types.push_back(Known::NIL);
+        } else {
+            return false;
+        }
+        max_depth = std::max(max_depth, types.size());
+        return true;
+    };
+    
+    // Records the depth an edge brings to a label; false on a mismatch
+    auto reach = [&](size_t target, size_t depth) {
+        auto found = label_depth.find(target);
+        if (found == label_depth.end()) {
+            label_depth[target] = depth;
+            return true;
+        }
+        return found->second == depth;
+    };
+    
+    // Jumps to target, leaving the region through an exit when it is
+    // outside; patch is the rel32 of an already emitted jmp or jcc
+    auto branch_to = [&](size_t patch, size_t target) {
+        if (labels.count(target)) {
+            if (!reach(target, types.size())) return false;
+            branches.push_back({patch, static_cast<uint32_t>(target), 0});
+        } else {
+            exits.push_back({patch, static_cast<uint32_t>(target), static_cast<uint32_t>(types.size())});
+        }
+        return true;
+    };
+    
+    emit.prologue();
+    
+    size_t pc = start;
+    bool reachable = true;
+    while (pc < end) {
+        uint32_t offset = static_cast<uint32_t>(pc);
+        uint8_t raw = chunk.code[pc];
+        size_t length = 1 + opcode_operand_bytes(raw);
+        if (pc + length > end) break;
+        
+        auto label = labels.find(pc);
+        if (label != labels.end()) {
+            if (reachable && !reach(pc, types.size())) return nullptr;
+            auto depth = label_depth.find(pc);
+            if (depth != label_depth.end()) {
+                // Other edges may bring other types
+                reachable = true;
+                types.assign(depth->second, Known::UNKNOWN);
+                label->second = emit.code.size();
+            }
+        }
+        if (!reachable) {
+            pc += length;
+            continue;
+        }
+        resume_depth = types.size();
+        
+        // Quickened instructions compile like the generic ones; slots are
+        // typed here anyway. Fused instructions store their constant and
+        // then compile as the operation they fuse, and a compare-and-branch
+        // branches on the bool its compare leaves.
+        OpCode op = generic_opcode(static_cast<OpCode>(raw));
+        size_t fused_branch = unbranched_opcode(op) != op ? branch_target(pc) : SIZE_MAX;
+        op = unbranched_opcode(op);
+        bool open = true;
+        if (unfused_opcode(op) != op) {
+            if (push_constant(chunk.code[pc + 1])) {
+                op = unfused_opcode(op);
+            } else {
+                exit_here(offset);
+                open = false;
+            }
+        }
+        size_t depth = types.size();
+        
+        if (open) switch (op) {
+            case OpCode::OP_CONSTANT: {
+                if (!push_constant(chunk.code[pc + 1])) {
+                    exit_here(offset);
+                    open = false;
+                }
+                break;
+            }
+            case OpCode::OP_ADD:
+            case OpCode::OP_SUBTRACT:
+            case OpCode::OP_MULTIPLY:
+            case OpCode::OP_DIVIDE: {
+                if (depth < 2 || !require(depth - 2, Known::NUMBER, NUMBER, offset) ||
+                    !require(depth - 1, Known::NUMBER, NUMBER, offset)) {
+                    exit_here(offset);
+                    open = false;
+                    break;
+                }
+                static const uint8_t SSE_OPS[] = {0x58, 0x5C, 0x59, 0x5E};
+                int index = static_cast<int>(op) - static_cast<int>(OpCode::OP_ADD);
+                emit.load_xmm0(depth - 2);
+                emit.arith_xmm0(SSE_OPS[index], depth - 1);
+                emit.store_xmm0(depth - 2);
+                types.pop_back();
+                break;
+            }
+            case OpCode::OP_NEGATE: {
+                if (depth < 1 || !require(depth - 1, Known::NUMBER, NUMBER, offset)) {
+                    exit_here(offset);
+                    open = false;
+                    break;
+                }
+                emit.flip_sign(depth - 1);
+                break;
+            }
+            case OpCode::OP_NOT: {
+                if (depth < 1) { exit_here(offset); open = false; break; }
+                Known type = types[depth - 1];
+                if (type == Known::NUMBER || type == Known::NIL) {
+                    // Numbers are truthy and nil is falsey
+                    emit.store_slot(depth - 1, BOOL, type == Known::NIL ? 1 : 0);
+                } else if (require(depth - 1, Known::BOOL, BOOL, offset)) {
+                    emit.flip_bool(depth - 1);
+                } else {
+                    exit_here(offset);
+                    open = false;
+                    break;
+                }
+                types[depth - 1] = Known::BOOL;
+                break;
+            }
+            case OpCode::OP_EQUAL: {
+                if (depth < 2) { exit_here(offset); open = false; break; }
+                Known a = types[depth - 2];
+                Known b = types[depth - 1];
+                if (a != Known::UNKNOWN && b != Known::UNKNOWN && a != b) {
+                    // Different types never compare equal
+                    emit.store_slot(depth - 2, BOOL, 0);
+                } else if (a == Known::NIL && b == Known::NIL) {
+                    emit.store_slot(depth - 2, BOOL, 1);
+                } else if (a == Known::BOOL && b == Known::BOOL) {
+                    emit.compare_bits(depth - 2, depth - 1);
+                    emit.bytes({0x0F, 0x94, 0xC0});
+                    emit.store_al_as_bool(depth - 2);
+                    emit.store_tag(depth - 2, BOOL);
+                } else if (require(depth - 2, Known::NUMBER, NUMBER, offset) &&
+                           require(depth - 1, Known::NUMBER, NUMBER, offset)) {
+                    // sete al; setnp cl; and al, cl - NaN is unequal to itself
+                    emit.load_xmm0(depth - 2);
+                    emit.compare_xmm0(depth - 1);
+                    emit.bytes({0x0F, 0x94, 0xC0, 0x0F, 0x9B, 0xC1, 0x20, 0xC8});
+                    emit.store_al_as_bool(depth - 2);
+                    emit.store_tag(depth - 2, BOOL);
+                } else {
+                    exit_here(offset);
+                    open = false;
+                    break;
+                }
+                types.pop_back();
+                types.back() = Known::BOOL;
+                break;
+            }
+            case OpCode::OP_GREATER:
+            case OpCode::OP_LESS: {
+                if (depth < 2 || !require(depth - 2, Known::NUMBER, NUMBER, offset) ||
+                    !require(depth - 1, Known::NUMBER, NUMBER, offset)) {
+                    exit_here(offset);
+                    open = false;
+                    break;
+                }
+                // seta al; a < b is emitted as b > a, so NaN yields false
+                // for both like the interpreter
+                bool less = op == OpCode::OP_LESS;
+                emit.load_xmm0(less ? depth - 1 : depth - 2);
+                emit.compare_xmm0(less ? depth - 2 : depth - 1);
+                emit.bytes({0x0F, 0x97, 0xC0});
+                emit.store_al_as_bool(depth - 2);
+                emit.store_tag(depth - 2, BOOL);
+                types.pop_back();
+                types.back() = Known::BOOL;
+                break;
+            }
+            case OpCode::OP_PRINT: {
+                if (depth < 1) { exit_here(offset); open = false; break; }
+                emit.call_with_slot(depth - 1, reinterpret_cast<const void*>(&jit_print));
+                types.pop_back();
+                break;
+            }
+            case OpCode::OP_POP: {
+                if (depth < 1) { exit_here(offset); open = false; break; }
+                types.pop_back();
+                break;
+            }
+            case OpCode::OP_GET_LOCAL: {
+                // Local slots are the low slots of the same array, so
+                // their known types carry over to the copy
+                size_t slot = chunk.code[pc + 1];
+                if (slot >= depth) { exit_here(offset); open = false; break; }
+                emit.copy_slot(slot, depth);
+                types.push_back(types[slot]);
+                max_depth = std::max(max_depth, types.size());
+                break;
+            }
+            case OpCode::OP_SET_LOCAL: {
+                size_t slot = chunk.code[pc + 1];
+                if (slot + 1 >= depth) { exit_here(offset); open = false; break; }
+                emit.copy_slot(depth - 1, slot);
+                types[slot] = types[depth - 1];
+                break;
+            }
+            case OpCode::OP_JUMP:
+            case OpCode::OP_LOOP: {
+                if (!branch_to(emit.jump(), branch_target(pc))) return nullptr;
+                reachable = false;
+                break;
+            }
+            case OpCode::OP_JUMP_IF_FALSE: {
+                if (depth < 1) { exit_here(offset); open = false; break; }
+                size_t target = branch_target(pc);
+                Known type = types[depth - 1];
+                if (type == Known::NUMBER) {
+                    // Numbers are always truthy
+                } else if (type == Known::NIL) {
+                    if (!branch_to(emit.jump(), target)) return nullptr;
+                    reachable = false;
+                } else if (type == Known::BOOL) {
+                    if (!branch_to(emit.compare_jump(Emitter::bits_disp(depth - 1), 0, 0x84), target)) return nullptr;
+                } else {
+                    // nil, or a bool holding 0
+                    if (!branch_to(emit.compare_jump(Emitter::tag_disp(depth - 1), NIL, 0x84), target)) return nullptr;
+                    emit.compare_skip(Emitter::tag_disp(depth - 1), BOOL);
+                    if (!branch_to(emit.compare_jump(Emitter::bits_disp(depth - 1), 0, 0x84), target)) return nullptr;
+                }
+                break;
+            }
+            default:
+                // OP_RETURN and everything without a template is handed
+                // back to the interpreter
+                exit_here(offset);
+                open = false;
+                break;
+        }
+        
+        if (open && fused_branch != SIZE_MAX) {
+            size_t condition = types.size() - 1;
+            if (!branch_to(emit.compare_jump(Emitter::bits_disp(condition), 0, 0x84), fused_branch)) return nullptr;
+        }
+        
+        if (!open) {
+            if (strict) return nullptr;
+            reachable = false;
+        } else {
+            compiled_ops++;
+        }
+        pc += length;
+    }
+    if (reachable) {
+        resume_depth = types.size();
+        exit_here(static_cast<uint32_t>(pc));
+    }
+    
+    if (compiled_ops == 0) return nullptr;
+    
+    for (const PendingExit& branch : branches) {
+        size_t target = labels[branch.offset];
+        if (target == SIZE_MAX) return nullptr;
+        emit.patch(branch.patch, target);
+    }
+    
+    // Out-of-line exit stubs, one per distinct resume point
+    std::map<std::pair<uint32_t, uint32_t>, size_t> stubs;
+    for (const PendingExit& pending : exits) {
+        auto key = std::make_pair(pending.offset, pending.depth);
+        auto found = stubs.find(key);
+        if (found == stubs.end()) {
+            found = stubs.emplace(key, emit.code.size()).first;
+            emit.exit(pending.offset, pending.depth);
+        }
+        emit.patch(pending.patch, found->second);
+    }
+    
+    // Write the code, then flip the mapping to read+execute
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t mapped = (emit.code.size() + page - 1) / page * page;
+    void* memory = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    std::memcpy(memory, emit.code.data(), emit.code.size());
+    if (mprotect(memory, mapped, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, mapped);
+        return nullptr;
+    }
+    
+    std::unique_ptr<JitCode> compiled(new JitCode());
+    compiled->memory = memory;
+    compiled->mapped = mapped;
+    compiled->length = emit.code.size();
+    compiled->max_depth = max_depth;
+    compiled->entry_depth = entry_depth;
+    compiled->entry = reinterpret_cast<Entry>(memory);
+    return compiled;
+}
+
+JitCode::~JitCode() {
+    if (memory) munmap(memory, mapped);
+}
+
+#else
+
+bool JitCode::supported() { return false; }
+
+std::unique_ptr<JitCode> JitCode::compile(const Chunk&) { return nullptr; }
+
+std::unique_ptr<JitCode> JitCode::compile_loop(const Chunk&, size_t, size_t, size_t) { return nullptr; }
+
+JitCode::~JitCode() {}
+
+#endif
+
+}
\ No newline at end of file
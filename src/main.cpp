@@ -13,8 +13,39 @@ int main(int argc, char* argv[]) {
         if (!engine.run_file(filename)) {
             return 1;
         }
+    } else if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--profile") {
+        // Profile a file; folded stacks go to <filename>.folded by default
+        std::string filename = argv[2];
+        std::string folded = argc == 4 ? argv[3] : filename + ".folded";
+        if (!engine.profile_file(filename, folded)) {
+            return 1;
+        }
+    } else if (argc >= 4 && std::string(argv[1]) == "--snapshot") {
+        // Run a setup file, compile any further files, then save the
+        // globals built and the compiled chunks
+        if (!engine.run_file(argv[3])) {
+            return 1;
+        }
+        for (int i = 4; i < argc; ++i) {
+            if (!engine.compile_file(argv[i])) return 1;
+        }
+        if (!engine.save_snapshot(argv[2])) {
+            return 1;
+        }
+    } else if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--restore") {
+        // Start from a saved image, then run the file or the REPL
+        if (!engine.restore_snapshot(argv[2])) {
+            return 1;
+        }
+        if (argc == 3) {
+            engine.start_repl();
+        } else if (!engine.run_file(argv[3])) {
+            return 1;
+        }
     } else {
-        std::cerr << "Usage: " << argv[0] << " [filename]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [--profile] [filename] [folded_output]" << std::endl;
+        std::cerr << "       " << argv[0] << " --snapshot <image> <setup_file> [file...]" << std::endl;
+        std::cerr << "       " << argv[0] << " --restore <image> [filename]" << std::endl;
         return 1;
     }
     
@@ -65,6 +65,12 @@ void Parser::error(const std::string& message) {
     error_at(previous(), message);
 }
 
+void Parser::warning(int line, const std::string& message) {
+    std::string text = "[line " + std::to_string(line) + "] Warning: " + message;
+    std::cerr << text << std::endl;
+    warning_messages.push_back(text);
+}
+
 void Parser::synchronize() {
     panic_mode = false;
     
@@ -111,9 +117,165 @@ uint8_t Parser::make_constant(Value value) {
 }
 
 void Parser::emit_constant(Value value) {
+    last_constant = compiling_chunk->code.size();
     emit_bytes(static_cast<uint8_t>(OpCode::OP_CONSTANT), make_constant(value));
 }
 
+// Emits a jump with a placeholder 16-bit operand; returns the operand's
+// offset for patch_jump
+size_t Parser::emit_jump(OpCode op) {
+    std::vector<uint8_t>& code = compiling_chunk->code;
+    if (op == OpCode::OP_JUMP_IF_FALSE && last_fused != SIZE_MAX && last_fused + 2 == code.size() &&
+        last_fused >= fusion_barrier) {
+        switch (static_cast<OpCode>(code[last_fused])) {
+            case OpCode::OP_EQUAL_CONSTANT: op = OpCode::OP_EQUAL_CONSTANT_JUMP; break;
+            case OpCode::OP_GREATER_CONSTANT: op = OpCode::OP_GREATER_CONSTANT_JUMP; break;
+            case OpCode::OP_LESS_CONSTANT: op = OpCode::OP_LESS_CONSTANT_JUMP; break;
+            default: break;
+        }
+        if (op != OpCode::OP_JUMP_IF_FALSE) {
+            code[last_fused] = static_cast<uint8_t>(op);
+            last_fused = SIZE_MAX;
+            emit_byte(0xff);
+            emit_byte(0xff);
+            return code.size() - 2;
+        }
+    }
+    
+    emit_byte(static_cast<uint8_t>(op));
+    emit_byte(0xff);
+    emit_byte(0xff);
+    return compiling_chunk->code.size() - 2;
+}
+
+// Points the jump at the next instruction to be emitted
+void Parser::patch_jump(size_t offset) {
+    std::vector<uint8_t>& code = compiling_chunk->code;
+    size_t jump = code.size() - offset - 2;
+    if (jump > UINT16_MAX) {
+        error("Too much code to jump over");
+        return;
+    }
+    code[offset] = static_cast<uint8_t>((jump >> 8) & 0xff);
+    code[offset + 1] = static_cast<uint8_t>(jump & 0xff);
+    fusion_barrier = code.size();
+}
+
+// Records a backward jump target
+size_t Parser::mark_loop_start() {
+    fusion_barrier = compiling_chunk->code.size();
+    return fusion_barrier;
+}
+
+void Parser::emit_loop(size_t loop_start) {
+    emit_byte(static_cast<uint8_t>(OpCode::OP_LOOP));
+    size_t offset = compiling_chunk->code.size() - loop_start + 2;
+    if (offset > UINT16_MAX) error("Loop body too large");
+    emit_byte(static_cast<uint8_t>((offset >> 8) & 0xff));
+    emit_byte(static_cast<uint8_t>(offset & 0xff));
+}
+
+// Superinstructions chosen from opcode pair counts (see bench/sequence_miner.cpp)
+void Parser::emit_fused(OpCode op) {
+    OpCode fused;
+    switch (op) {
+        case OpCode::OP_ADD: fused = OpCode::OP_ADD_CONSTANT; break;
+        case OpCode::OP_SUBTRACT: fused = OpCode::OP_SUBTRACT_CONSTANT; break;
+        case OpCode::OP_MULTIPLY: fused = OpCode::OP_MULTIPLY_CONSTANT; break;
+        case OpCode::OP_DIVIDE: fused = OpCode::OP_DIVIDE_CONSTANT; break;
+        case OpCode::OP_EQUAL: fused = OpCode::OP_EQUAL_CONSTANT; break;
+        case OpCode::OP_GREATER: fused = OpCode::OP_GREATER_CONSTANT; break;
+        case OpCode::OP_LESS: fused = OpCode::OP_LESS_CONSTANT; break;
+        case OpCode::OP_PRINT: fused = OpCode::OP_PRINT_CONSTANT; break;
+        default:
+            emit_byte(static_cast<uint8_t>(op));
+            return;
+    }
+    
+    std::vector<uint8_t>& code = compiling_chunk->code;
+    if (last_constant != SIZE_MAX && last_constant + 2 == code.size() && last_constant >= fusion_barrier) {
+        code[last_constant] = static_cast<uint8_t>(fused);
+        last_fused = last_constant;
+        last_constant = SIZE_MAX;
+        return;
+    }
+    emit_byte(static_cast<uint8_t>(op));
+}
+
+void Parser::begin_scope() {
+    scope_depth++;
+}
+
+// Pops the scope's locals, reporting those that were never read. Names
+// starting with '_' are exempt.
+void Parser::end_scope() {
+    scope_depth--;
+    while (!locals.empty() && locals.back().depth > scope_depth) {
+        const Local& local = locals.back();
+        if (!local.read && local.name[0] != '_') {
+            warning(local.line, "Local variable '" + local.name + "' is never read");
+        }
+        emit_byte(static_cast<uint8_t>(OpCode::OP_POP));
+        locals.pop_back();
+    }
+}
+
+void Parser::declare_local(const Token& name) {
+    for (auto it = locals.rbegin(); it != locals.rend() && it->depth >= scope_depth; ++it) {
+        if (it->name == name.lexeme) {
+            error("Already a variable with this name in this scope");
+            return;
+        }
+    }
+    if (locals.size() > UINT8_MAX) {
+        error("Too many local variables in scope");
+        return;
+    }
+    locals.push_back({name.lexeme, -1, name.line, false});
+}
+
+// Slot of the innermost local with this name, or -1 for a global
+int Parser::resolve_local(const Token& name) {
+    for (size_t i = locals.size(); i-- > 0;) {
+        if (locals[i].name != name.lexeme) continue;
+        if (locals[i].depth == -1) error("Can't read local variable in its own initializer");
+        return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// Global names share one constant per chunk
+uint8_t Parser::identifier_constant(const Token& name) {
+    const std::vector<Value>& constants = compiling_chunk->constants;
+    for (size_t i = 0; i < constants.size() && i <= UINT8_MAX; ++i) {
+        const std::string* existing = std::get_if<std::string>(&constants[i]);
+        if (existing && *existing == name.lexeme) return static_cast<uint8_t>(i);
+    }
+    return make_constant(name.lexeme);
+}
+
+void Parser::named_variable(const Token& name, bool assign) {
+    int slot = resolve_local(name);
+    OpCode get_op = OpCode::OP_GET_GLOBAL;
+    OpCode set_op = OpCode::OP_SET_GLOBAL;
+    uint8_t operand;
+    if (slot >= 0) {
+        get_op = OpCode::OP_GET_LOCAL;
+        set_op = OpCode::OP_SET_LOCAL;
+        operand = static_cast<uint8_t>(slot);
+    } else {
+        operand = identifier_constant(name);
+    }
+    
+    if (assign) {
+        assignment();
+        emit_bytes(static_cast<uint8_t>(set_op), operand);
+    } else {
+        if (slot >= 0) locals[slot].read = true;
+        emit_bytes(static_cast<uint8_t>(get_op), operand);
+    }
+}
+
 void Parser::primary() {
     if (match(TokenType::TRUE)) {
         emit_constant(true);
@@ -144,6 +306,11 @@ void Parser::primary() {
         return;
     }
     
+    if (match(TokenType::IDENTIFIER)) {
+        named_variable(previous(), false);
+        return;
+    }
+    
     if (match(TokenType::LPAREN)) {
         expression();
         consume(TokenType::RPAREN, "Expected ')' after expression");
@@ -177,8 +344,8 @@ void Parser::factor() {
         unary();
         
         switch (operator_type) {
-            case TokenType::MULTIPLY: emit_byte(static_cast<uint8_t>(OpCode::OP_MULTIPLY)); break;
-            case TokenType::DIVIDE: emit_byte(static_cast<uint8_t>(OpCode::OP_DIVIDE)); break;
+            case TokenType::MULTIPLY: emit_fused(OpCode::OP_MULTIPLY); break;
+            case TokenType::DIVIDE: emit_fused(OpCode::OP_DIVIDE); break;
             default: break;
         }
     }
@@ -192,8 +359,8 @@ void Parser::term() {
         factor();
         
         switch (operator_type) {
-            case TokenType::PLUS: emit_byte(static_cast<uint8_t>(OpCode::OP_ADD)); break;
-            case TokenType::MINUS: emit_byte(static_cast<uint8_t>(OpCode::OP_SUBTRACT)); break;
+            case TokenType::PLUS: emit_fused(OpCode::OP_ADD); break;
+            case TokenType::MINUS: emit_fused(OpCode::OP_SUBTRACT); break;
             default: break;
         }
     }
@@ -208,13 +375,15 @@ void Parser::comparison() {
         term();
         
         switch (operator_type) {
-            case TokenType::GREATER: emit_byte(static_cast<uint8_t>(OpCode::OP_GREATER)); break;
+            case TokenType::GREATER: emit_fused(OpCode::OP_GREATER); break;
             case TokenType::GREATER_EQUAL: 
-                emit_bytes(static_cast<uint8_t>(OpCode::OP_LESS), static_cast<uint8_t>(OpCode::OP_NOT));
+                emit_fused(OpCode::OP_LESS);
+                emit_byte(static_cast<uint8_t>(OpCode::OP_NOT));
                 break;
-            case TokenType::LESS: emit_byte(static_cast<uint8_t>(OpCode::OP_LESS)); break;
+            case TokenType::LESS: emit_fused(OpCode::OP_LESS); break;
             case TokenType::LESS_EQUAL:
-                emit_bytes(static_cast<uint8_t>(OpCode::OP_GREATER), static_cast<uint8_t>(OpCode::OP_NOT));
+                emit_fused(OpCode::OP_GREATER);
+                emit_byte(static_cast<uint8_t>(OpCode::OP_NOT));
                 break;
             default: break;
         }
@@ -230,26 +399,56 @@ void Parser::equality() {
         
         switch (operator_type) {
             case TokenType::NOT_EQUAL:
-                emit_bytes(static_cast<uint8_t>(OpCode::OP_EQUAL), static_cast<uint8_t>(OpCode::OP_NOT));
+                emit_fused(OpCode::OP_EQUAL);
+                emit_byte(static_cast<uint8_t>(OpCode::OP_NOT));
                 break;
-            case TokenType::EQUAL: emit_byte(static_cast<uint8_t>(OpCode::OP_EQUAL)); break;
+            case TokenType::EQUAL: emit_fused(OpCode::OP_EQUAL); break;
             default: break;
         }
     }
 }
 
+// OP_JUMP_IF_FALSE leaves the condition on the stack, so it doubles as the
+// result when the right operand is skipped
 void Parser::and_expression() {
     equality();
-    // TODO: Implement short-circuit evaluation for AND
+    
+    while (match(TokenType::AND)) {
+        size_t end_jump = emit_jump(OpCode::OP_JUMP_IF_FALSE);
+        emit_byte(static_cast<uint8_t>(OpCode::OP_POP));
+        equality();
+        patch_jump(end_jump);
+    }
 }
 
 void Parser::or_expression() {
     and_expression();
-    // TODO: Implement short-circuit evaluation for OR
+    
+    while (match(TokenType::OR)) {
+        size_t else_jump = emit_jump(OpCode::OP_JUMP_IF_FALSE);
+        size_t end_jump = emit_jump(OpCode::OP_JUMP);
+        patch_jump(else_jump);
+        emit_byte(static_cast<uint8_t>(OpCode::OP_POP));
+        and_expression();
+        patch_jump(end_jump);
+    }
 }
 
-void Parser::expression() {
+// Assignment is right-associative and only binds to a bare name
+void Parser::assignment() {
+    if (check(TokenType::IDENTIFIER) && tokens[current + 1].type == TokenType::ASSIGN) {
+        Token name = advance();
+        advance();
+        named_variable(name, true);
+        return;
+    }
+    
     or_expression();
+    if (match(TokenType::ASSIGN)) error("Invalid assignment target");
+}
+
+void Parser::expression() {
+    assignment();
 }
 
 void Parser::expression_statement() {
@@ -261,19 +460,142 @@ void Parser::expression_statement() {
 void Parser::print_statement() {
     expression();
     consume(TokenType::SEMICOLON, "Expected ';' after value");
-    emit_byte(static_cast<uint8_t>(OpCode::OP_PRINT));
+    emit_fused(OpCode::OP_PRINT);
+}
+
+void Parser::skip_newlines() {
+    while (match(TokenType::NEWLINE)) {}
+}
+
+void Parser::block() {
+    while (!check(TokenType::RBRACE) && !check(TokenType::EOF_TOKEN)) {
+        if (match(TokenType::NEWLINE)) continue;
+        declaration();
+    }
+    consume(TokenType::RBRACE, "Expected '}' after block");
+}
+
+void Parser::if_statement() {
+    consume(TokenType::LPAREN, "Expected '(' after 'if'");
+    expression();
+    consume(TokenType::RPAREN, "Expected ')' after condition");
+    
+    size_t then_jump = emit_jump(OpCode::OP_JUMP_IF_FALSE);
+    emit_byte(static_cast<uint8_t>(OpCode::OP_POP));
+    skip_newlines();
+    statement();
+    
+    size_t else_jump = emit_jump(OpCode::OP_JUMP);
+    patch_jump(then_jump);
+    emit_byte(static_cast<uint8_t>(OpCode::OP_POP));
+    
+    skip_newlines();
+    if (match(TokenType::ELSE)) {
+        skip_newlines();
+        statement();
+    }
+    patch_jump(else_jump);
+}
+
+void Parser::while_statement() {
+    size_t loop_start = mark_loop_start();
+    consume(TokenType::LPAREN, "Expected '(' after 'while'");
+    expression();
+    consume(TokenType::RPAREN, "Expected ')' after condition");
+    
+    size_t exit_jump = emit_jump(OpCode::OP_JUMP_IF_FALSE);
+    emit_byte(static_cast<uint8_t>(OpCode::OP_POP));
+    skip_newlines();
+    statement();
+    emit_loop(loop_start);
+    
+    patch_jump(exit_jump);
+    emit_byte(static_cast<uint8_t>(OpCode::OP_POP));
+}
+
+// for (initializer; condition; increment) body. The increment is compiled
+// before the body, so the body jumps back to it and it loops to the
+// condition.
+void Parser::for_statement() {
+    begin_scope();
+    consume(TokenType::LPAREN, "Expected '(' after 'for'");
+    if (match(TokenType::SEMICOLON)) {
+        // No initializer
+    } else if (match(TokenType::LET)) {
+        var_declaration();
+    } else {
+        expression_statement();
+    }
+    
+    size_t loop_start = mark_loop_start();
+    size_t exit_jump = SIZE_MAX;
+    if (!match(TokenType::SEMICOLON)) {
+        expression();
+        consume(TokenType::SEMICOLON, "Expected ';' after loop condition");
+        exit_jump = emit_jump(OpCode::OP_JUMP_IF_FALSE);
+        emit_byte(static_cast<uint8_t>(OpCode::OP_POP));
+    }
+    
+    if (!match(TokenType::RPAREN)) {
+        size_t body_jump = emit_jump(OpCode::OP_JUMP);
+        size_t increment_start = mark_loop_start();
+        expression();
+        emit_byte(static_cast<uint8_t>(OpCode::OP_POP));
+        consume(TokenType::RPAREN, "Expected ')' after for clauses");
+        
+        emit_loop(loop_start);
+        loop_start = increment_start;
+        patch_jump(body_jump);
+    }
+    
+    skip_newlines();
+    statement();
+    emit_loop(loop_start);
+    
+    if (exit_jump != SIZE_MAX) {
+        patch_jump(exit_jump);
+        emit_byte(static_cast<uint8_t>(OpCode::OP_POP));
+    }
+    end_scope();
 }
 
 void Parser::statement() {
     if (match(TokenType::PRINT)) {
         print_statement();
+    } else if (match(TokenType::IF)) {
+        if_statement();
+    } else if (match(TokenType::WHILE)) {
+        while_statement();
+    } else if (match(TokenType::FOR)) {
+        for_statement();
+    } else if (match(TokenType::LBRACE)) {
+        begin_scope();
+        block();
+        end_scope();
     } else {
         expression_statement();
     }
 }
 
+// let name = value; inside a block the value simply stays in its slot,
+// at the top level it becomes a global
 void Parser::var_declaration() {
-    // TODO: Implement variable declarations
+    consume(TokenType::IDENTIFIER, "Expected variable name");
+    Token name = previous();
+    if (scope_depth > 0) declare_local(name);
+    
+    if (match(TokenType::ASSIGN)) {
+        expression();
+    } else {
+        emit_constant(nullptr);
+    }
+    consume(TokenType::SEMICOLON, "Expected ';' after variable declaration");
+    
+    if (scope_depth > 0) {
+        if (!locals.empty()) locals.back().depth = scope_depth;
+        return;
+    }
+    emit_bytes(static_cast<uint8_t>(OpCode::OP_DEFINE_GLOBAL), identifier_constant(name));
 }
 
 void Parser::declaration() {
@@ -293,6 +615,12 @@ bool Parser::compile(const std::vector<Token>& tokens, Chunk* chunk) {
     this->current = 0;
     this->had_error = false;
     this->panic_mode = false;
+    this->last_constant = SIZE_MAX;
+    this->last_fused = SIZE_MAX;
+    this->fusion_barrier = 0;
+    this->locals.clear();
+    this->scope_depth = 0;
+    this->warning_messages.clear();
     
     while (!check(TokenType::EOF_TOKEN)) {
         // Skip newlines at the top level
@@ -0,0 +1,147 @@
+#include "replit_core.hpp"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <sys/time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace replit {
+
+// Only one profiler can own SIGPROF at a time; the handler and timer it
+// replaced are put back when it is destroyed
+static std::atomic<Profiler*> active_profiler{nullptr};
+static struct sigaction previous_action;
+static itimerval previous_timer;
+
+Profiler::Profiler(int sample_hz) : sample_hz(sample_hz) {}
+
+Profiler::~Profiler() {
+    if (active_profiler.load() == this) {
+        itimerval timer {};
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        sigaction(SIGPROF, &previous_action, nullptr);
+        setitimer(ITIMER_PROF, &previous_timer, nullptr);
+        active_profiler.store(nullptr);
+    }
+}
+
+uint64_t Profiler::read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Async-signal-safe: only lock-free atomics on storage owned by the
+// profiler for its whole lifetime
+void Profiler::on_signal(int) {
+    Profiler* profiler = active_profiler.load(std::memory_order_relaxed);
+    if (!profiler) return;
+    uint32_t offset = profiler->current_offset.load(std::memory_order_relaxed);
+    if (offset == UINT32_MAX) return;
+    uint32_t slot = profiler->ring_head.fetch_add(1, std::memory_order_relaxed);
+    profiler->sample_ring[slot % SAMPLE_RING].store(offset, std::memory_order_relaxed);
+}
+
+void Profiler::begin(const Chunk& chunk) {
+    active_chunk = &chunk;
+    last_op = -1;
+    ring_tail = ring_head.load();
+    if (timer_armed || sample_hz <= 0) return;
+    
+    Profiler* expected = nullptr;
+    if (!active_profiler.compare_exchange_strong(expected, this)) return;
+    
+    struct sigaction action {};
+    action.sa_handler = &Profiler::on_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &action, &previous_action);
+    
+    itimerval timer {};
+    timer.it_interval.tv_usec = std::max(1, 1000000 / sample_hz);
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, &previous_timer);
+    timer_armed = true;
+}
+
+void Profiler::end() {
+    current_offset.store(UINT32_MAX);
+    // Charge the final instruction up to now
+    if (last_op >= 0) cycles[last_op] += read_cycles() - last_cycles;
+    last_op = -1;
+    if (!active_chunk) return;
+    
+    // Samples older than one ring's worth were overwritten
+    uint32_t head = ring_head.load();
+    if (head - ring_tail > SAMPLE_RING) ring_tail = head - SAMPLE_RING;
+    for (; ring_tail != head; ++ring_tail) {
+        uint32_t offset = sample_ring[ring_tail % SAMPLE_RING].load(std::memory_order_relaxed);
+        if (offset >= active_chunk->code.size()) continue;
+        int line = offset < active_chunk->lines.size() ? active_chunk->lines[offset] : 0;
+        line_hits[line]++;
+        site_hits[{line, active_chunk->code[offset]}]++;
+        total_samples++;
+    }
+    active_chunk = nullptr;
+}
+
+std::string Profiler::report() const {
+    std::ostringstream out;
+    uint64_t total_count = 0, total_cycles = 0;
+    std::vector<int> ops;
+    for (int op = 0; op < 256; ++op) {
+        if (counts[op] == 0) continue;
+        ops.push_back(op);
+        total_count += counts[op];
+        total_cycles += cycles[op];
+    }
+    std::sort(ops.begin(), ops.end(), [this](int a, int b) { return cycles[a] > cycles[b]; });
+    
+    out << std::left << std::setw(20) << "opcode" << std::right << std::setw(14) << "count"
+        << std::setw(16) << "cycles" << std::setw(10) << "cyc/op" << std::setw(8) << "%" << "\n";
+    for (int op : ops) {
+        out << std::left << std::setw(20) << opcode_name(static_cast<uint8_t>(op)) << std::right
+            << std::setw(14) << counts[op] << std::setw(16) << cycles[op]
+            << std::setw(10) << std::fixed << std::setprecision(1)
+            << static_cast<double>(cycles[op]) / counts[op]
+            << std::setw(8) << (total_cycles ? 100.0 * cycles[op] / total_cycles : 0.0) << "\n";
+    }
+    out << std::left << std::setw(20) << "total" << std::right << std::setw(14) << total_count
+        << std::setw(16) << total_cycles << "\n";
+    
+    if (total_samples > 0) {
+        std::vector<std::pair<int, uint64_t>> lines(line_hits.begin(), line_hits.end());
+        std::sort(lines.begin(), lines.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+        out << "\n" << total_samples << " samples\n";
+        for (size_t i = 0; i < lines.size() && i < 20; ++i) {
+            out << "  line " << std::setw(6) << lines[i].first << std::setw(10) << lines[i].second
+                << std::setw(8) << std::setprecision(1) << 100.0 * lines[i].second / total_samples << "%\n";
+        }
+    }
+    return out.str();
+}
+
+std::string Profiler::folded(const std::string& root) const {
+    std::ostringstream out;
+    for (const auto& [site, hits] : site_hits) {
+        out << root << ";line_" << site.first << ";" << opcode_name(site.second) << " " << hits << "\n";
+    }
+    return out.str();
+}
+
+bool Profiler::write_folded(const std::string& path, const std::string& root) const {
+    std::ofstream file(path);
+    if (!file) return false;
+    file << folded(root);
+    return static_cast<bool>(file);
+}
+
+}
\ No newline at end of file
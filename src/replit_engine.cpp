@@ -1,10 +1,44 @@
 #include "replit_core.hpp"
+#include "standard_library.hpp"
+#include <cstdio>
 #include <iostream>
-#include <fstream>
 #include <sstream>
 
 namespace replit {
 
+// FNV-1a of the source text, with its length
+static std::string chunk_key(const std::string& source) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : source) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    char key[40];
+    std::snprintf(key, sizeof(key), "%016llx-%zu", static_cast<unsigned long long>(hash), source.size());
+    return key;
+}
+
+static bool read_source(const std::string& filename, std::string& source) {
+    try {
+        source = FileSystem::read_file(filename);
+    } catch (const std::exception&) {
+        std::cerr << "Could not open file: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool compile_source(const std::string& source, Chunk& chunk) {
+    Lexer lexer(source);
+    std::vector<Token> tokens;
+    while (true) {
+        tokens.push_back(lexer.scan_token());
+        if (tokens.back().type == TokenType::EOF_TOKEN) break;
+    }
+    Parser parser;
+    return parser.compile(tokens, &chunk);
+}
+
 std::string ReplitEngine::run_code(const std::string& code) {
     std::ostringstream output;
     std::streambuf* orig = std::cout.rdbuf();
@@ -18,32 +52,99 @@ std::string ReplitEngine::run_code(const std::string& code) {
         return "Compile error occurred";
     } else if (result == VM::InterpretResult::RUNTIME_ERROR) {
         return "Runtime error occurred";
+    } else if (result == VM::InterpretResult::LIMIT_EXCEEDED) {
+        return "Execution limit exceeded";
     }
     
     return output.str();
 }
 
+// The chunk compiled for this source before, else the restored image's,
+// else a new one; nullptr once an error has been reported
+Chunk* ReplitEngine::chunk_for(const std::string& filename, const std::string& source) {
+    std::string key = chunk_key(source);
+    auto found = chunks.find(key);
+    if (found != chunks.end()) return &found->second;
+    
+    Chunk chunk;
+    try {
+        if (!(restored && restored->load_chunk(key, chunk)) && !compile_source(source, chunk)) {
+            std::cerr << "Compile error in file: " << filename << std::endl;
+            return nullptr;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return nullptr;
+    }
+    return &chunks.emplace(key, std::move(chunk)).first->second;
+}
+
 bool ReplitEngine::run_file(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file) {
-        std::cerr << "Could not open file: " << filename << std::endl;
+    std::string source;
+    if (!read_source(filename, source)) return false;
+    Chunk* chunk = chunk_for(filename, source);
+    if (!chunk) return false;
+    
+    VM::InterpretResult result = vm.run(*chunk);
+    
+    if (result == VM::InterpretResult::RUNTIME_ERROR) {
+        std::cerr << "Runtime error in file: " << filename << std::endl;
+        return false;
+    }
+    if (result == VM::InterpretResult::LIMIT_EXCEEDED) {
+        std::cerr << "Execution limit exceeded in file: " << filename << std::endl;
         return false;
     }
     
-    std::string source((std::istreambuf_iterator<char>(file)),
-                       std::istreambuf_iterator<char>());
-    
-    VM::InterpretResult result = vm.interpret(source);
+    return true;
+}
+
+bool ReplitEngine::compile_file(const std::string& filename) {
+    std::string source;
+    return read_source(filename, source) && chunk_for(filename, source);
+}
+
+bool ReplitEngine::profile_file(const std::string& filename, const std::string& folded_path) {
+    Profiler profiler;
+    vm.set_profiler(&profiler);
+    bool ok = run_file(filename);
+    vm.set_profiler(nullptr);
     
-    if (result == VM::InterpretResult::COMPILE_ERROR) {
-        std::cerr << "Compile error in file: " << filename << std::endl;
+    std::cerr << profiler.report();
+    if (!profiler.write_folded(folded_path, filename)) {
+        std::cerr << "Could not write profile: " << folded_path << std::endl;
+    }
+    return ok;
+}
+
+bool ReplitEngine::save_snapshot(const std::string& path) {
+    try {
+        std::map<std::string, const Chunk*> saved;
+        for (const auto& [key, chunk] : chunks) saved[key] = &chunk;
+        // Chunks of the restored image that were never run carry over
+        std::map<std::string, Chunk> carried;
+        if (restored) {
+            for (const std::string& key : restored->chunk_names()) {
+                if (saved.count(key)) continue;
+                if (restored->load_chunk(key, carried[key])) saved[key] = &carried[key];
+            }
+        }
+        vm.save_snapshot(path, saved);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
         return false;
     }
-    if (result == VM::InterpretResult::RUNTIME_ERROR) {
-        std::cerr << "Runtime error in file: " << filename << std::endl;
+    return true;
+}
+
+bool ReplitEngine::restore_snapshot(const std::string& path) {
+    try {
+        restored = Snapshot::open(path);
+        vm.attach_snapshot(restored);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
         return false;
     }
-    
     return true;
 }
 
@@ -65,6 +166,8 @@ void ReplitEngine::start_repl() {
             std::cout << "Compile error" << std::endl;
         } else if (result == VM::InterpretResult::RUNTIME_ERROR) {
             std::cout << "Runtime error" << std::endl;
+        } else if (result == VM::InterpretResult::LIMIT_EXCEEDED) {
+            std::cout << "Execution limit exceeded" << std::endl;
         }
     }
 }
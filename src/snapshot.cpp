@@ -0,0 +1,475 @@
+#include "replit_core.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace replit {
+
+namespace {
+
+// Image layout, all little-endian host order. Sections are 8-byte aligned
+// and referenced by offset from the start of the image; strings, values,
+// globals and chunks refer to each other by table index.
+//
+//   ImageHeader
+//   StringEntry[string_count]  then the string bytes
+//   ValueEntry[value_count]    collections point at contiguous children
+//   GlobalEntry[global_count]  sorted by name for binary search
+//   ChunkEntry[chunk_count]    sorted by name; code, lines and constants,
+//                              verified on load like any foreign bytecode
+const char IMAGE_MAGIC[8] = {'R', 'P', 'L', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t IMAGE_VERSION = 1;
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct ImageHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t size;
+    uint64_t strings;
+    uint64_t string_data;
+    uint64_t values;
+    uint64_t globals;
+    uint64_t chunks;
+    uint32_t string_count;
+    uint32_t value_count;
+    uint32_t global_count;
+    uint32_t chunk_count;
+};
+
+struct StringEntry {
+    uint64_t offset;  // into the string bytes
+    uint64_t length;
+};
+
+enum class ValueTag : uint8_t {
+    NIL, BOOL, NUMBER, FLOAT, INT, CHAR, STRING, LIST, MAP, REFERENCE
+};
+
+// payload holds the scalar bits, a string index, the first child of a
+// collection or the entry a REFERENCE stands for. A map's children
+// alternate key (a STRING) and value.
+struct ValueEntry {
+    ValueTag tag;
+    uint8_t reserved[3];
+    uint32_t count;
+    uint64_t payload;
+};
+
+struct GlobalEntry {
+    uint32_t name;
+    uint32_t value;
+};
+
+struct ChunkEntry {
+    uint32_t name;
+    uint32_t code_length;
+    uint64_t code;
+    uint64_t lines;  // int32 per code byte
+    uint32_t first_constant;
+    uint32_t constant_count;
+};
+
+// Collections nested deeper than this are rejected rather than recursed into
+const int MAX_VALUE_DEPTH = 256;
+
+size_t align8(size_t size) {
+    return (size + 7) & ~size_t(7);
+}
+
+template<typename T>
+void append(std::vector<uint8_t>& out, const T& item) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&item);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// Accumulates the tables while walking the saved state
+class ImageWriter {
+public:
+    std::vector<StringEntry> strings;
+    std::string string_bytes;
+    std::vector<ValueEntry> values;
+    
+    uint32_t intern(const std::string& text) {
+        auto found = interned.find(text);
+        if (found != interned.end()) return found->second;
+        uint32_t index = checked_index(strings.size());
+        strings.push_back({string_bytes.size(), text.size()});
+        string_bytes += text;
+        interned.emplace(text, index);
+        return index;
+    }
+    
+    // Appends the value and, after it, its children; returns its index
+    uint32_t add_value(const Value& value, int depth = 0) {
+        if (depth > MAX_VALUE_DEPTH) throw std::runtime_error("Snapshot value nested too deeply");
+        uint32_t index = checked_index(values.size());
+        values.push_back(encode_scalar(value));
+        
+        if (const auto* list = std::get_if<std::vector<Value>>(&value)) {
+            uint32_t first = reserve(list->size());
+            for (size_t i = 0; i < list->size(); ++i) {
+                ValueEntry element = slot(list->at(i), depth);
+                values[first + i] = element;
+            }
+            values[index] = {ValueTag::LIST, {}, static_cast<uint32_t>(list->size()), first};
+        } else if (const auto* map = std::get_if<std::unordered_map<std::string, Value>>(&value)) {
+            uint32_t first = reserve(2 * map->size());
+            size_t i = 0;
+            for (const auto& entry : *map) {
+                ValueEntry key{ValueTag::STRING, {}, 0, intern(entry.first)};
+                ValueEntry element = slot(entry.second, depth);
+                values[first + i++] = key;
+                values[first + i++] = element;
+            }
+            values[index] = {ValueTag::MAP, {}, static_cast<uint32_t>(map->size()), first};
+        }
+        return index;
+    }
+    
+    // Reserves a contiguous run of entries, filled in with slot()
+    uint32_t reserve(size_t count) {
+        uint32_t first = checked_index(values.size());
+        checked_index(values.size() + count);
+        values.resize(values.size() + count);
+        return first;
+    }
+    
+    // The entry for one element of a run: scalars inline, collections as
+    // a reference to their own entry appended after the run
+    ValueEntry slot(const Value& value, int depth) {
+        if (!std::holds_alternative<std::vector<Value>>(value) &&
+            !std::holds_alternative<std::unordered_map<std::string, Value>>(value)) {
+            return encode_scalar(value);
+        }
+        return {ValueTag::REFERENCE, {}, 0, add_value(value, depth + 1)};
+    }
+    
+private:
+    std::unordered_map<std::string, uint32_t> interned;
+    
+    static uint32_t checked_index(size_t index) {
+        if (index >= UINT32_MAX) throw std::runtime_error("Snapshot too large");
+        return static_cast<uint32_t>(index);
+    }
+    
+    ValueEntry encode_scalar(const Value& value) {
+        ValueEntry entry{ValueTag::NIL, {}, 0, 0};
+        if (const double* number = std::get_if<double>(&value)) {
+            entry.tag = ValueTag::NUMBER;
+            std::memcpy(&entry.payload, number, sizeof(*number));
+        } else if (const float* single = std::get_if<float>(&value)) {
+            entry.tag = ValueTag::FLOAT;
+            std::memcpy(&entry.payload, single, sizeof(*single));
+        } else if (const int64_t* integer = std::get_if<int64_t>(&value)) {
+            entry.tag = ValueTag::INT;
+            entry.payload = static_cast<uint64_t>(*integer);
+        } else if (const char* character = std::get_if<char>(&value)) {
+            entry.tag = ValueTag::CHAR;
+            entry.payload = static_cast<uint8_t>(*character);
+        } else if (const bool* flag = std::get_if<bool>(&value)) {
+            entry.tag = ValueTag::BOOL;
+            entry.payload = *flag ? 1 : 0;
+        } else if (const std::string* text = std::get_if<std::string>(&value)) {
+            entry.tag = ValueTag::STRING;
+            entry.payload = intern(*text);
+        } else if (std::holds_alternative<std::nullptr_t>(value) ||
+                   std::holds_alternative<std::vector<Value>>(value) ||
+                   std::holds_alternative<std::unordered_map<std::string, Value>>(value)) {
+            // Collections are filled in by add_value
+        } else {
+            throw std::runtime_error("Cannot snapshot a value holding a native object");
+        }
+        return entry;
+    }
+};
+
+}
+
+void Snapshot::write(const std::string& path,
+                     const std::unordered_map<std::string, Value>& globals,
+                     const std::map<std::string, const Chunk*>& chunks) {
+    ImageWriter writer;
+    
+    std::vector<std::pair<std::string, GlobalEntry>> sorted_globals;
+    for (const auto& global : globals) {
+        sorted_globals.push_back({global.first, {writer.intern(global.first), writer.add_value(global.second)}});
+    }
+    std::sort(sorted_globals.begin(), sorted_globals.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    
+    // std::map iterates in name order already
+    std::vector<ChunkEntry> chunk_entries;
+    std::vector<uint8_t> chunk_bytes;
+    for (const auto& named : chunks) {
+        const Chunk& chunk = *named.second;
+        if (chunk.code.size() >= UINT32_MAX) throw std::runtime_error("Snapshot chunk too large");
+        ChunkEntry entry {};
+        entry.name = writer.intern(named.first);
+        entry.code_length = static_cast<uint32_t>(chunk.code.size());
+        entry.code = chunk_bytes.size();
+        chunk_bytes.insert(chunk_bytes.end(), chunk.code.begin(), chunk.code.end());
+        chunk_bytes.resize(align8(chunk_bytes.size()));
+        entry.lines = chunk_bytes.size();
+        for (size_t i = 0; i < chunk.code.size(); ++i) {
+            append(chunk_bytes, static_cast<int32_t>(i < chunk.lines.size() ? chunk.lines[i] : 0));
+        }
+        chunk_bytes.resize(align8(chunk_bytes.size()));
+        entry.first_constant = writer.reserve(chunk.constants.size());
+        entry.constant_count = static_cast<uint32_t>(chunk.constants.size());
+        for (size_t i = 0; i < chunk.constants.size(); ++i) {
+            ValueEntry constant = writer.slot(chunk.constants[i], 0);
+            writer.values[entry.first_constant + i] = constant;
+        }
+        chunk_entries.push_back(entry);
+    }
+    
+    ImageHeader header {};
+    std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version = IMAGE_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.string_count = static_cast<uint32_t>(writer.strings.size());
+    header.value_count = static_cast<uint32_t>(writer.values.size());
+    header.global_count = static_cast<uint32_t>(sorted_globals.size());
+    header.chunk_count = static_cast<uint32_t>(chunk_entries.size());
+    
+    header.strings = align8(sizeof(ImageHeader));
+    header.string_data = header.strings + writer.strings.size() * sizeof(StringEntry);
+    header.values = align8(header.string_data + writer.string_bytes.size());
+    header.globals = header.values + writer.values.size() * sizeof(ValueEntry);
+    header.chunks = align8(header.globals + sorted_globals.size() * sizeof(GlobalEntry));
+    size_t chunk_data = header.chunks + chunk_entries.size() * sizeof(ChunkEntry);
+    header.size = chunk_data + chunk_bytes.size();
+    for (ChunkEntry& entry : chunk_entries) {
+        entry.code += chunk_data;
+        entry.lines += chunk_data;
+    }
+    
+    std::vector<uint8_t> image;
+    image.reserve(header.size);
+    append(image, header);
+    image.resize(header.strings);
+    for (const StringEntry& entry : writer.strings) append(image, entry);
+    image.insert(image.end(), writer.string_bytes.begin(), writer.string_bytes.end());
+    image.resize(header.values);
+    for (const ValueEntry& entry : writer.values) append(image, entry);
+    for (const auto& global : sorted_globals) append(image, global.second);
+    image.resize(header.chunks);
+    for (const ChunkEntry& entry : chunk_entries) append(image, entry);
+    image.insert(image.end(), chunk_bytes.begin(), chunk_bytes.end());
+    
+    // Written aside and renamed so a running reader never sees half an image
+    std::string staging = path + ".tmp";
+    {
+        std::ofstream out(staging, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+        if (!out) throw std::runtime_error("Could not write snapshot: " + staging);
+    }
+    if (std::rename(staging.c_str(), path.c_str()) != 0) {
+        std::remove(staging.c_str());
+        throw std::runtime_error("Could not write snapshot: " + path);
+    }
+}
+
+std::shared_ptr<const Snapshot> Snapshot::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("Could not open snapshot: " + path);
+    struct stat info {};
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(ImageHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Not a snapshot image: " + path);
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void* memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) throw std::runtime_error("Could not map snapshot: " + path);
+    
+    std::shared_ptr<Snapshot> snapshot(new Snapshot());
+    snapshot->memory = memory;
+    snapshot->mapped = size;
+    if (!snapshot->valid()) throw std::runtime_error("Not a valid snapshot image: " + path);
+    return snapshot;
+}
+
+Snapshot::~Snapshot() {
+    if (memory) munmap(memory, mapped);
+}
+
+const uint8_t* Snapshot::base() const {
+    return static_cast<const uint8_t*>(memory);
+}
+
+// Checks that every table lies inside the mapping; entries are bounds
+// checked again as they are decoded
+bool Snapshot::valid() const {
+    const ImageHeader* header = reinterpret_cast<const ImageHeader*>(base());
+    if (std::memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0) return false;
+    if (header->version != IMAGE_VERSION || header->byte_order != BYTE_ORDER_MARK) return false;
+    if (header->size != mapped) return false;
+    
+    auto fits = [&](uint64_t offset, uint64_t count, size_t entry_size) {
+        return offset % 8 == 0 && offset <= mapped && count <= (mapped - offset) / entry_size;
+    };
+    return fits(header->strings, header->string_count, sizeof(StringEntry)) &&
+           header->string_data == header->strings + uint64_t(header->string_count) * sizeof(StringEntry) &&
+           fits(header->values, header->value_count, sizeof(ValueEntry)) &&
+           fits(header->globals, header->global_count, sizeof(GlobalEntry)) &&
+           fits(header->chunks, header->chunk_count, sizeof(ChunkEntry));
+}
+
+std::string_view Snapshot::string_at(uint32_t index) const {
+    const ImageHeader* header = reinterpret_cast<const ImageHeader*>(base());
+    if (index >= header->string_count) throw std::runtime_error("Corrupt snapshot string index");
+    const StringEntry& entry = reinterpret_cast<const StringEntry*>(base() + header->strings)[index];
+    if (entry.offset > mapped - header->string_data || entry.length > mapped - header->string_data - entry.offset) {
+        throw std::runtime_error("Corrupt snapshot string");
+    }
+    return std::string_view(reinterpret_cast<const char*>(base() + header->string_data + entry.offset), entry.length);
+}
+
+Value Snapshot::value_at(uint32_t index, int depth) const {
+    const ImageHeader* header = reinterpret_cast<const ImageHeader*>(base());
+    if (index >= header->value_count || depth > MAX_VALUE_DEPTH) throw std::runtime_error("Corrupt snapshot value");
+    const ValueEntry& entry = reinterpret_cast<const ValueEntry*>(base() + header->values)[index];
+    
+    switch (entry.tag) {
+        case ValueTag::NIL: return nullptr;
+        case ValueTag::BOOL: return entry.payload != 0;
+        case ValueTag::NUMBER: {
+            double number;
+            std::memcpy(&number, &entry.payload, sizeof(number));
+            return number;
+        }
+        case ValueTag::FLOAT: {
+            float single;
+            std::memcpy(&single, &entry.payload, sizeof(single));
+            return single;
+        }
+        case ValueTag::INT: return static_cast<int64_t>(entry.payload);
+        case ValueTag::CHAR: return static_cast<char>(entry.payload);
+        case ValueTag::STRING: return std::string(string_at(static_cast<uint32_t>(entry.payload)));
+        case ValueTag::REFERENCE: return value_at(static_cast<uint32_t>(entry.payload), depth + 1);
+        case ValueTag::LIST: {
+            if (entry.payload > header->value_count || entry.count > header->value_count - entry.payload) {
+                throw std::runtime_error("Corrupt snapshot list");
+            }
+            std::vector<Value> list;
+            list.reserve(entry.count);
+            for (uint32_t i = 0; i < entry.count; ++i) {
+                list.push_back(value_at(static_cast<uint32_t>(entry.payload + i), depth + 1));
+            }
+            return list;
+        }
+        case ValueTag::MAP: {
+            if (entry.payload > header->value_count || entry.count > (header->value_count - entry.payload) / 2) {
+                throw std::runtime_error("Corrupt snapshot map");
+            }
+            std::unordered_map<std::string, Value> map;
+            for (uint32_t i = 0; i < entry.count; ++i) {
+                Value key = value_at(static_cast<uint32_t>(entry.payload + 2 * i), depth + 1);
+                if (!std::holds_alternative<std::string>(key)) throw std::runtime_error("Corrupt snapshot map key");
+                map.emplace(std::get<std::string>(key), value_at(static_cast<uint32_t>(entry.payload + 2 * i + 1), depth + 1));
+            }
+            return map;
+        }
+    }
+    throw std::runtime_error("Corrupt snapshot value tag");
+}
+
+size_t Snapshot::global_count() const {
+    return reinterpret_cast<const ImageHeader*>(base())->global_count;
+}
+
+std::vector<std::string> Snapshot::global_names() const {
+    const ImageHeader* header = reinterpret_cast<const ImageHeader*>(base());
+    const GlobalEntry* globals = reinterpret_cast<const GlobalEntry*>(base() + header->globals);
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < header->global_count; ++i) names.emplace_back(string_at(globals[i].name));
+    return names;
+}
+
+// Binary search over the sorted global table; only the match is decoded
+bool Snapshot::find_global(const std::string& name, Value& value) const {
+    const ImageHeader* header = reinterpret_cast<const ImageHeader*>(base());
+    const GlobalEntry* globals = reinterpret_cast<const GlobalEntry*>(base() + header->globals);
+    
+    size_t low = 0;
+    size_t high = header->global_count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        int order = string_at(globals[middle].name).compare(name);
+        if (order == 0) {
+            value = value_at(globals[middle].value);
+            return true;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> Snapshot::chunk_names() const {
+    const ImageHeader* header = reinterpret_cast<const ImageHeader*>(base());
+    const ChunkEntry* chunks = reinterpret_cast<const ChunkEntry*>(base() + header->chunks);
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < header->chunk_count; ++i) names.emplace_back(string_at(chunks[i].name));
+    return names;
+}
+
+// Quickened instructions are saved as they were, so a loaded chunk starts
+// warm; compiled machine code is not saved and is rebuilt when hot
+bool Snapshot::load_chunk(const std::string& name, Chunk& chunk) const {
+    const ImageHeader* header = reinterpret_cast<const ImageHeader*>(base());
+    const ChunkEntry* chunks = reinterpret_cast<const ChunkEntry*>(base() + header->chunks);
+    size_t low = 0;
+    size_t high = header->chunk_count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        const ChunkEntry& entry = chunks[middle];
+        int order = string_at(entry.name).compare(name);
+        if (order < 0) {
+            low = middle + 1;
+            continue;
+        }
+        if (order > 0) {
+            high = middle;
+            continue;
+        }
+        
+        uint64_t lines_size = uint64_t(entry.code_length) * sizeof(int32_t);
+        if (entry.code > mapped || entry.code_length > mapped - entry.code ||
+            entry.lines > mapped || lines_size > mapped - entry.lines ||
+            entry.first_constant > header->value_count || entry.constant_count > header->value_count - entry.first_constant) {
+            throw std::runtime_error("Corrupt snapshot chunk");
+        }
+        
+        Chunk loaded;
+        loaded.code.assign(base() + entry.code, base() + entry.code + entry.code_length);
+        loaded.lines.resize(entry.code_length);
+        for (uint32_t j = 0; j < entry.code_length; ++j) {
+            int32_t line;
+            std::memcpy(&line, base() + entry.lines + j * sizeof(int32_t), sizeof(line));
+            loaded.lines[j] = line;
+        }
+        for (uint32_t j = 0; j < entry.constant_count; ++j) {
+            loaded.constants.push_back(value_at(entry.first_constant + j));
+        }
+        // Images are not trusted to hold what the Parser would emit
+        verify_chunk(loaded);
+        chunk = std::move(loaded);
+        return true;
+    }
+    return false;
+}
+
+}
\ No newline at end of file
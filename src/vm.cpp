@@ -1,9 +1,205 @@
 #include "replit_core.hpp"
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
 namespace replit {
 
+const char* opcode_name(uint8_t op) {
+    static const char* NAMES[] = {
+        "OP_CONSTANT", "OP_ADD", "OP_SUBTRACT", "OP_MULTIPLY", "OP_DIVIDE",
+        "OP_NEGATE", "OP_NOT", "OP_EQUAL", "OP_GREATER", "OP_LESS",
+        "OP_PRINT", "OP_POP", "OP_DEFINE_GLOBAL", "OP_GET_GLOBAL",
+        "OP_SET_GLOBAL", "OP_JUMP_IF_FALSE", "OP_JUMP", "OP_LOOP",
+        "OP_CALL", "OP_RETURN", "OP_HALT",
+        "OP_ADD_NUM", "OP_ADD_STR", "OP_SUBTRACT_NUM", "OP_MULTIPLY_NUM",
+        "OP_DIVIDE_NUM", "OP_EQUAL_NUM", "OP_GREATER_NUM", "OP_LESS_NUM",
+        "OP_ADD_CONSTANT", "OP_SUBTRACT_CONSTANT", "OP_MULTIPLY_CONSTANT",
+        "OP_DIVIDE_CONSTANT", "OP_EQUAL_CONSTANT", "OP_GREATER_CONSTANT",
+        "OP_LESS_CONSTANT", "OP_PRINT_CONSTANT", "OP_GET_LOCAL", "OP_SET_LOCAL",
+        "OP_EQUAL_CONSTANT_JUMP", "OP_GREATER_CONSTANT_JUMP", "OP_LESS_CONSTANT_JUMP"
+    };
+    if (op < sizeof(NAMES) / sizeof(NAMES[0])) return NAMES[op];
+    return "OP_UNKNOWN";
+}
+
+OpCode generic_opcode(OpCode op) {
+    switch (op) {
+        case OpCode::OP_ADD_NUM:
+        case OpCode::OP_ADD_STR: return OpCode::OP_ADD;
+        case OpCode::OP_SUBTRACT_NUM: return OpCode::OP_SUBTRACT;
+        case OpCode::OP_MULTIPLY_NUM: return OpCode::OP_MULTIPLY;
+        case OpCode::OP_DIVIDE_NUM: return OpCode::OP_DIVIDE;
+        case OpCode::OP_EQUAL_NUM: return OpCode::OP_EQUAL;
+        case OpCode::OP_GREATER_NUM: return OpCode::OP_GREATER;
+        case OpCode::OP_LESS_NUM: return OpCode::OP_LESS;
+        default: return op;
+    }
+}
+
+OpCode unfused_opcode(OpCode op) {
+    switch (op) {
+        case OpCode::OP_ADD_CONSTANT: return OpCode::OP_ADD;
+        case OpCode::OP_SUBTRACT_CONSTANT: return OpCode::OP_SUBTRACT;
+        case OpCode::OP_MULTIPLY_CONSTANT: return OpCode::OP_MULTIPLY;
+        case OpCode::OP_DIVIDE_CONSTANT: return OpCode::OP_DIVIDE;
+        case OpCode::OP_EQUAL_CONSTANT: return OpCode::OP_EQUAL;
+        case OpCode::OP_GREATER_CONSTANT: return OpCode::OP_GREATER;
+        case OpCode::OP_LESS_CONSTANT: return OpCode::OP_LESS;
+        case OpCode::OP_PRINT_CONSTANT: return OpCode::OP_PRINT;
+        default: return op;
+    }
+}
+
+OpCode unbranched_opcode(OpCode op) {
+    switch (op) {
+        case OpCode::OP_EQUAL_CONSTANT_JUMP: return OpCode::OP_EQUAL_CONSTANT;
+        case OpCode::OP_GREATER_CONSTANT_JUMP: return OpCode::OP_GREATER_CONSTANT;
+        case OpCode::OP_LESS_CONSTANT_JUMP: return OpCode::OP_LESS_CONSTANT;
+        default: return op;
+    }
+}
+
+int opcode_operand_bytes(uint8_t op) {
+    switch (static_cast<OpCode>(op)) {
+        case OpCode::OP_CONSTANT:
+        case OpCode::OP_DEFINE_GLOBAL:
+        case OpCode::OP_GET_GLOBAL:
+        case OpCode::OP_SET_GLOBAL:
+        case OpCode::OP_GET_LOCAL:
+        case OpCode::OP_SET_LOCAL:
+        case OpCode::OP_CALL:
+            return 1;
+        case OpCode::OP_JUMP_IF_FALSE:
+        case OpCode::OP_JUMP:
+        case OpCode::OP_LOOP:
+            return 2;
+        case OpCode::OP_EQUAL_CONSTANT_JUMP:
+        case OpCode::OP_GREATER_CONSTANT_JUMP:
+        case OpCode::OP_LESS_CONSTANT_JUMP:
+            return 3;
+        default:
+            return unfused_opcode(static_cast<OpCode>(op)) != static_cast<OpCode>(op) ? 1 : 0;
+    }
+}
+
+void verify_chunk(const Chunk& chunk) {
+    const std::vector<uint8_t>& code = chunk.code;
+    auto fail = [](size_t offset, const std::string& problem) {
+        throw std::runtime_error("Invalid bytecode at offset " + std::to_string(offset) + ": " + problem);
+    };
+    if (code.empty()) fail(0, "empty chunk");
+    if (chunk.lines.size() != code.size()) fail(0, "line table does not match the code");
+    
+    // Instruction starts in a linear decode; the VM rewrites opcodes in
+    // place, so no jump may land inside an operand
+    std::vector<bool> starts(code.size(), false);
+    for (size_t pc = 0; pc < code.size(); pc += 1 + opcode_operand_bytes(code[pc])) {
+        if (code[pc] > static_cast<uint8_t>(OpCode::OP_LESS_CONSTANT_JUMP)) fail(pc, "unknown opcode");
+        starts[pc] = true;
+    }
+    
+    // Stack depth on entry to each reachable instruction, -1 until reached
+    std::vector<int> depth_at(code.size(), -1);
+    std::vector<size_t> pending;
+    auto reach = [&](size_t from, size_t target, int depth) {
+        if (target >= code.size() || !starts[target]) fail(from, "jump to a non-instruction");
+        if (depth_at[target] == -1) {
+            depth_at[target] = depth;
+            pending.push_back(target);
+        } else if (depth_at[target] != depth) {
+            fail(from, "stack depth differs between paths");
+        }
+    };
+    auto constant = [&](size_t pc, bool name) {
+        uint8_t index = code[pc + 1];
+        if (index >= chunk.constants.size()) fail(pc, "constant index out of range");
+        if (name && !std::holds_alternative<std::string>(chunk.constants[index])) fail(pc, "global name is not a string");
+    };
+    
+    reach(0, 0, 0);
+    while (!pending.empty()) {
+        size_t pc = pending.back();
+        pending.pop_back();
+        int depth = depth_at[pc];
+        size_t next = pc + 1 + opcode_operand_bytes(code[pc]);
+        if (next > code.size()) fail(pc, "operand past the end of the chunk");
+        
+        // A superinstruction pushes its constant, then runs its operation;
+        // a compare-and-branch then branches like OP_JUMP_IF_FALSE
+        OpCode op = generic_opcode(static_cast<OpCode>(code[pc]));
+        bool branches = unbranched_opcode(op) != op;
+        op = unbranched_opcode(op);
+        if (unfused_opcode(op) != op) {
+            constant(pc, false);
+            depth++;
+            op = unfused_opcode(op);
+        }
+        
+        int pops = 0;
+        int pushes = 0;
+        switch (op) {
+            case OpCode::OP_CONSTANT: constant(pc, false); pushes = 1; break;
+            case OpCode::OP_ADD:
+            case OpCode::OP_SUBTRACT:
+            case OpCode::OP_MULTIPLY:
+            case OpCode::OP_DIVIDE:
+            case OpCode::OP_EQUAL:
+            case OpCode::OP_GREATER:
+            case OpCode::OP_LESS: pops = 2; pushes = 1; break;
+            case OpCode::OP_NEGATE:
+            case OpCode::OP_NOT:
+            case OpCode::OP_JUMP_IF_FALSE: pops = 1; pushes = 1; break;
+            case OpCode::OP_PRINT:
+            case OpCode::OP_POP: pops = 1; break;
+            case OpCode::OP_DEFINE_GLOBAL: constant(pc, true); pops = 1; break;
+            case OpCode::OP_GET_GLOBAL: constant(pc, true); pushes = 1; break;
+            case OpCode::OP_SET_GLOBAL: constant(pc, true); pops = 1; pushes = 1; break;
+            case OpCode::OP_GET_LOCAL:
+            case OpCode::OP_SET_LOCAL:
+                if (code[pc + 1] >= depth) fail(pc, "local slot out of range");
+                pops = op == OpCode::OP_SET_LOCAL ? 1 : 0;
+                pushes = 1;
+                break;
+            case OpCode::OP_JUMP:
+            case OpCode::OP_LOOP:
+            case OpCode::OP_RETURN: break;
+            default:
+                fail(pc, std::string(opcode_name(code[pc])) + " is not executable");
+        }
+        if (depth < pops) fail(pc, "stack underflow");
+        depth += pushes - pops;
+        
+        if (op == OpCode::OP_RETURN) continue;
+        if (branches) op = OpCode::OP_JUMP_IF_FALSE;
+        uint16_t offset = 0;
+        if (op == OpCode::OP_JUMP || op == OpCode::OP_LOOP || op == OpCode::OP_JUMP_IF_FALSE) {
+            offset = static_cast<uint16_t>((code[next - 2] << 8) | code[next - 1]);
+        }
+        if (op == OpCode::OP_LOOP) {
+            if (offset > next) fail(pc, "jump to a non-instruction");
+            reach(pc, next - offset, depth);
+            continue;
+        }
+        if (op == OpCode::OP_JUMP) {
+            reach(pc, next + offset, depth);
+            continue;
+        }
+        if (op == OpCode::OP_JUMP_IF_FALSE) reach(pc, next + offset, depth);
+        if (next >= code.size()) fail(pc, "execution runs past the end of the chunk");
+        reach(pc, next, depth);
+    }
+}
+
+// Loop iterations that count as one run towards the JIT threshold
+static const uint32_t BACKEDGES_PER_RUN = 64;
+
+// Type misses tolerated per chunk before it stops quickening
+static const uint32_t QUICKEN_MISS_LIMIT = 64;
+
+// Charged instructions between reads of the clock under a timeout
+static const uint64_t DEADLINE_CHECK_INTERVAL = 4096;
+
 VM::VM() {
     reset_stack();
 }
@@ -72,6 +268,117 @@ void VM::runtime_error(const std::string& message) {
     reset_stack();
 }
 
+void VM::set_limits(const ExecutionLimits& bounds) {
+    limits = bounds;
+    limited = bounds.max_instructions || bounds.max_allocated_bytes || bounds.timeout.count() > 0;
+}
+
+// Globals missing from the map are copied in from the attached snapshot
+// the first time they are used
+Value* VM::find_global(const std::string& name) {
+    auto found = globals.find(name);
+    if (found != globals.end()) return &found->second;
+    
+    Value value;
+    if (!snapshot || !snapshot->find_global(name, value)) return nullptr;
+    return &globals.emplace(name, std::move(value)).first->second;
+}
+
+void VM::save_snapshot(const std::string& path, const std::map<std::string, const Chunk*>& chunks) const {
+    std::unordered_map<std::string, Value> all = globals;
+    if (snapshot) {
+        for (const std::string& name : snapshot->global_names()) {
+            if (all.count(name)) continue;
+            Value value;
+            if (snapshot->find_global(name, value)) all.emplace(name, std::move(value));
+        }
+    }
+    Snapshot::write(path, all, chunks);
+}
+
+// Instructions in the loop body, an upper bound on what one iteration runs
+uint32_t VM::loop_cost(size_t loop_start, size_t loop_end) {
+    if (chunk->loop_costs.size() < chunk->code.size()) chunk->loop_costs.resize(chunk->code.size());
+    uint32_t& cost = chunk->loop_costs[loop_start];
+    if (cost == 0) {
+        for (size_t pc = loop_start; pc < loop_end; pc += 1 + opcode_operand_bytes(chunk->code[pc])) cost++;
+    }
+    return cost;
+}
+
+// Compares against the budget and reads the clock only once the charged
+// count passes next_check
+bool VM::charge_instructions(uint64_t count) {
+    instructions_charged += count;
+    if (instructions_charged < next_check) return true;
+    
+    if (limits.max_instructions && instructions_charged > limits.max_instructions) {
+        exceeded = Limit::INSTRUCTIONS;
+        return false;
+    }
+    if (limits.timeout.count() > 0 && std::chrono::steady_clock::now() >= deadline) {
+        exceeded = Limit::TIME;
+        return false;
+    }
+    
+    next_check = UINT64_MAX;
+    if (limits.timeout.count() > 0) next_check = instructions_charged + DEADLINE_CHECK_INTERVAL;
+    if (limits.max_instructions) next_check = std::min(next_check, limits.max_instructions + 1);
+    return true;
+}
+
+bool VM::charge_allocation(size_t bytes) {
+    if (!limits.max_allocated_bytes) return true;
+    live_bytes += static_cast<int64_t>(bytes);
+    if (live_bytes <= 0 || static_cast<uint64_t>(live_bytes) <= limits.max_allocated_bytes) return true;
+    exceeded = Limit::ALLOCATION;
+    return false;
+}
+
+void VM::limit_error() {
+    switch (exceeded) {
+        case Limit::INSTRUCTIONS:
+            std::cerr << "Limit exceeded: more than " << limits.max_instructions << " instructions" << std::endl;
+            break;
+        case Limit::ALLOCATION:
+            std::cerr << "Limit exceeded: more than " << limits.max_allocated_bytes << " bytes live" << std::endl;
+            break;
+        case Limit::TIME:
+            std::cerr << "Limit exceeded: ran longer than " << limits.timeout.count() << "ms" << std::endl;
+            break;
+        default:
+            break;
+    }
+    
+    // A backward branch has already moved ip to the loop header
+    size_t instruction = ip > chunk->code.data() ? ip - chunk->code.data() - 1 : 0;
+    if (instruction < chunk->lines.size()) {
+        std::cerr << "[line " << chunk->lines[instruction] << "] in script" << std::endl;
+    }
+    
+    reset_stack();
+}
+
+// Bytes a copy of the value allocates
+static size_t string_bytes(const Value& value) {
+    const std::string* text = std::get_if<std::string>(&value);
+    return text ? text->size() : 0;
+}
+
+// Called with a value about to be popped or overwritten
+void VM::credit_allocation(const Value& value) {
+    if (limits.max_allocated_bytes) live_bytes -= static_cast<int64_t>(string_bytes(value));
+}
+
+// Text of a value joined to a string with '+'
+static std::string concat_operand(const Value& value) {
+    if (const std::string* text = std::get_if<std::string>(&value)) return *text;
+    if (const double* number = std::get_if<double>(&value)) return std::to_string(*number);
+    if (const bool* flag = std::get_if<bool>(&value)) return *flag ? "true" : "false";
+    if (std::holds_alternative<std::nullptr_t>(value)) return "nil";
+    throw std::runtime_error("Operands must be two numbers or include a string");
+}
+
 void print_value(Value value) {
     if (std::holds_alternative<double>(value)) {
         double num = std::get<double>(value);
@@ -89,49 +396,221 @@ void print_value(Value value) {
     }
 }
 
+// Unboxes the values this run pushed into slots, runs the compiled code
+// and resumes interpretation wherever it exited, with its slots pushed back
+// as Values. False, without running anything, when the stack does not
+// match the code's entry or holds values that cannot be unboxed.
+bool VM::run_compiled(const JitCode& code) {
+    if (stack.size() - stack_base != code.entry_slots()) return false;
+    if (jit_slots.size() < code.slots_needed()) jit_slots.resize(code.slots_needed());
+    
+    for (size_t i = 0; i < code.entry_slots(); ++i) {
+        const Value& value = stack[stack_base + i];
+        JitSlot& slot = jit_slots[i];
+        if (const double* number = std::get_if<double>(&value)) {
+            slot.tag = JitCode::NUMBER;
+            std::memcpy(&slot.bits, number, sizeof(slot.bits));
+        } else if (const bool* flag = std::get_if<bool>(&value)) {
+            slot.tag = JitCode::BOOL;
+            slot.bits = *flag ? 1 : 0;
+        } else if (std::holds_alternative<std::nullptr_t>(value)) {
+            slot.tag = JitCode::NIL;
+            slot.bits = 0;
+        } else {
+            return false;
+        }
+    }
+    stack.resize(stack_base);
+    
+    uint32_t depth = 0;
+    uint32_t offset = code.enter(jit_slots.data(), &depth);
+    
+    for (uint32_t i = 0; i < depth; ++i) {
+        const JitSlot& slot = jit_slots[i];
+        switch (slot.tag) {
+            case JitCode::NUMBER: {
+                double number;
+                std::memcpy(&number, &slot.bits, sizeof(number));
+                push(number);
+                break;
+            }
+            case JitCode::BOOL: push(slot.bits != 0); break;
+            default: push(nullptr); break;
+        }
+    }
+    ip = chunk->code.data() + offset;
+    return true;
+}
+
+// Called on a hot backward branch; compiles the loop once and enters it
+void VM::enter_loop(size_t loop_start, size_t loop_end) {
+    auto found = chunk->loop_jit.find(static_cast<uint32_t>(loop_start));
+    if (found == chunk->loop_jit.end()) {
+        std::shared_ptr<JitCode> code = JitCode::compile_loop(*chunk, loop_start, loop_end, stack.size() - stack_base);
+        found = chunk->loop_jit.emplace(static_cast<uint32_t>(loop_start), code).first;
+    }
+    // Values that cannot be unboxed right now; count towards another try
+    if (found->second && !run_compiled(*found->second)) chunk->backedges[loop_start] = 0;
+}
+
 VM::InterpretResult VM::run() {
+    stack_base = stack.size();
+    if (limited) {
+        exceeded = Limit::NONE;
+        instructions_charged = 0;
+        live_bytes = 0;
+        next_check = 0;
+        deadline = std::chrono::steady_clock::now() + limits.timeout;
+    }
+    if (!profiler) {
+        bool at_start = ip == chunk->code.data();
+        if (jit_threshold && at_start && chunk->executions < jit_threshold) chunk->executions++;
+        if (jit_threshold && !limited && at_start && chunk->executions >= jit_threshold) {
+            if (!chunk->jit && !chunk->jit_failed) {
+                chunk->jit = JitCode::compile(*chunk);
+                chunk->jit_failed = !chunk->jit;
+            }
+            if (chunk->jit) run_compiled(*chunk->jit);
+        }
+        return execute<false>();
+    }
+    
+    profiler->begin(*chunk);
+    InterpretResult result = execute<true>();
+    profiler->end();
+    return result;
+}
+
+// The profiled variant is a separate instantiation so the normal dispatch
+// loop carries no instrumentation
+template<bool Profiled>
+VM::InterpretResult VM::execute() {
     #define READ_BYTE() (*ip++)
     #define READ_CONSTANT() (chunk->constants[READ_BYTE()])
-    #define BINARY_OP(value_type, op) \
+    #define READ_SHORT() (ip += 2, static_cast<uint16_t>((ip[-2] << 8) | ip[-1]))
+    // Rewrites the instruction just read into its specialised form
+    #define QUICKEN(quick) \
+        do { \
+            if (rewritable && chunk->quicken_misses < QUICKEN_MISS_LIMIT) { \
+                ip[-1] = static_cast<uint8_t>(OpCode::quick); \
+            } \
+        } while (false)
+    #define BINARY_OP(value_type, op, quick) \
         do { \
             if (!std::holds_alternative<double>(peek(0)) || \
                 !std::holds_alternative<double>(peek(1))) { \
                 runtime_error("Operands must be numbers"); \
                 return InterpretResult::RUNTIME_ERROR; \
             } \
+            QUICKEN(quick); \
             double b = std::get<double>(pop()); \
             double a = std::get<double>(pop()); \
             push(value_type(a op b)); \
         } while (false)
+    // Quickened number forms work on the stack in place. A type miss
+    // rewrites the instruction back to its generic form and re-dispatches.
+    #define NUMBER_OP(generic, result) \
+        do { \
+            size_t top = stack.size(); \
+            double* b = top >= 2 ? std::get_if<double>(&stack[top - 1]) : nullptr; \
+            double* a = top >= 2 ? std::get_if<double>(&stack[top - 2]) : nullptr; \
+            if (!a || !b) { \
+                DEOPTIMIZE(generic); \
+                break; \
+            } \
+            stack[top - 2] = result; \
+            stack.pop_back(); \
+        } while (false)
+    // Superinstructions take the number fast path in place; anything else
+    // pushes the constant and re-dispatches as the plain operation
+    #define CONSTANT_OP(generic, result) \
+        do { \
+            const Value& constant = READ_CONSTANT(); \
+            double* a = stack.empty() ? nullptr : std::get_if<double>(&stack.back()); \
+            const double* b = std::get_if<double>(&constant); \
+            if (!a || !b) { \
+                CHARGE(string_bytes(constant)); \
+                push(constant); \
+                instruction = static_cast<uint8_t>(OpCode::generic); \
+                rewritable = false; \
+                goto dispatch; \
+            } \
+            stack.back() = result; \
+        } while (false)
+    // Compare-and-branch: the result is left on the stack for the code at
+    // either target to pop. Non-number operands take the generic compare.
+    #define CONSTANT_BRANCH(result, generic_result) \
+        do { \
+            const Value& constant = READ_CONSTANT(); \
+            uint16_t offset = READ_SHORT(); \
+            double* a = stack.empty() ? nullptr : std::get_if<double>(&stack.back()); \
+            const double* b = std::get_if<double>(&constant); \
+            bool condition; \
+            if (a && b) { \
+                condition = result; \
+            } else { \
+                generic_result; \
+                CREDIT(stack.back()); \
+            } \
+            stack.back() = condition; \
+            if (!condition) ip += offset; \
+        } while (false)
+    // Under limits, copies of values onto the stack or into variables are
+    // charged and values dropped are credited
+    #define CHARGE(bytes) \
+        do { \
+            if (limited && !charge_allocation(bytes)) { \
+                limit_error(); \
+                return InterpretResult::LIMIT_EXCEEDED; \
+            } \
+        } while (false)
+    #define CREDIT(value) \
+        do { \
+            if (limited) credit_allocation(value); \
+        } while (false)
+    #define DEOPTIMIZE(generic) \
+        do { \
+            chunk->quicken_misses++; \
+            *--ip = static_cast<uint8_t>(OpCode::generic); \
+        } while (false)
     
     try {
         while (true) {
+            if (Profiled) profiler->enter(ip - chunk->code.data(), *ip);
             uint8_t instruction = READ_BYTE();
-            
+            // False while a superinstruction runs its generic fallback,
+            // whose ip[-1] is an operand rather than the opcode
+            bool rewritable = true;
+        
+        dispatch:
             switch (static_cast<OpCode>(instruction)) {
                 case OpCode::OP_CONSTANT: {
                     Value constant = READ_CONSTANT();
+                    CHARGE(string_bytes(constant));
                     push(constant);
                     break;
                 }
                 case OpCode::OP_ADD: {
+                    if (std::holds_alternative<std::string>(peek(0)) &&
+                        std::holds_alternative<std::string>(peek(1))) {
+                        QUICKEN(OP_ADD_STR);
+                    }
                     if (std::holds_alternative<std::string>(peek(0)) || 
                         std::holds_alternative<std::string>(peek(1))) {
-                        std::string b = std::holds_alternative<std::string>(peek(0)) ? 
-                                       std::get<std::string>(pop()) : 
-                                       std::to_string(std::get<double>(pop()));
-                        std::string a = std::holds_alternative<std::string>(peek(0)) ? 
-                                       std::get<std::string>(pop()) : 
-                                       std::to_string(std::get<double>(pop()));
+                        CREDIT(peek());
+                        std::string b = concat_operand(pop());
+                        CREDIT(peek());
+                        std::string a = concat_operand(pop());
+                        CHARGE(a.size() + b.size());
                         push(a + b);
                     } else {
-                        BINARY_OP(Value, +);
+                        BINARY_OP(Value, +, OP_ADD_NUM);
                     }
                     break;
                 }
-                case OpCode::OP_SUBTRACT: BINARY_OP(Value, -); break;
-                case OpCode::OP_MULTIPLY: BINARY_OP(Value, *); break;
-                case OpCode::OP_DIVIDE: BINARY_OP(Value, /); break;
+                case OpCode::OP_SUBTRACT: BINARY_OP(Value, -, OP_SUBTRACT_NUM); break;
+                case OpCode::OP_MULTIPLY: BINARY_OP(Value, *, OP_MULTIPLY_NUM); break;
+                case OpCode::OP_DIVIDE: BINARY_OP(Value, /, OP_DIVIDE_NUM); break;
                 case OpCode::OP_NEGATE: {
                     if (!std::holds_alternative<double>(peek())) {
                         runtime_error("Operand must be a number");
@@ -141,22 +620,156 @@ VM::InterpretResult VM::run() {
                     break;
                 }
                 case OpCode::OP_NOT:
+                    CREDIT(peek());
                     push(is_falsey(pop()));
                     break;
                 case OpCode::OP_EQUAL: {
+                    if (std::holds_alternative<double>(peek(0)) &&
+                        std::holds_alternative<double>(peek(1))) {
+                        QUICKEN(OP_EQUAL_NUM);
+                    }
                     Value b = pop();
                     Value a = pop();
+                    CREDIT(a);
+                    CREDIT(b);
                     push(values_equal(a, b));
                     break;
                 }
-                case OpCode::OP_GREATER: BINARY_OP(bool, >); break;
-                case OpCode::OP_LESS: BINARY_OP(bool, <); break;
+                case OpCode::OP_GREATER: BINARY_OP(bool, >, OP_GREATER_NUM); break;
+                case OpCode::OP_LESS: BINARY_OP(bool, <, OP_LESS_NUM); break;
+                case OpCode::OP_ADD_NUM: NUMBER_OP(OP_ADD, *a + *b); break;
+                case OpCode::OP_SUBTRACT_NUM: NUMBER_OP(OP_SUBTRACT, *a - *b); break;
+                case OpCode::OP_MULTIPLY_NUM: NUMBER_OP(OP_MULTIPLY, *a * *b); break;
+                case OpCode::OP_DIVIDE_NUM: NUMBER_OP(OP_DIVIDE, *a / *b); break;
+                case OpCode::OP_EQUAL_NUM: NUMBER_OP(OP_EQUAL, *a == *b); break;
+                case OpCode::OP_GREATER_NUM: NUMBER_OP(OP_GREATER, *a > *b); break;
+                case OpCode::OP_LESS_NUM: NUMBER_OP(OP_LESS, *a < *b); break;
+                case OpCode::OP_ADD_CONSTANT: CONSTANT_OP(OP_ADD, *a + *b); break;
+                case OpCode::OP_SUBTRACT_CONSTANT: CONSTANT_OP(OP_SUBTRACT, *a - *b); break;
+                case OpCode::OP_MULTIPLY_CONSTANT: CONSTANT_OP(OP_MULTIPLY, *a * *b); break;
+                case OpCode::OP_DIVIDE_CONSTANT: CONSTANT_OP(OP_DIVIDE, *a / *b); break;
+                case OpCode::OP_EQUAL_CONSTANT: CONSTANT_OP(OP_EQUAL, *a == *b); break;
+                case OpCode::OP_GREATER_CONSTANT: CONSTANT_OP(OP_GREATER, *a > *b); break;
+                case OpCode::OP_LESS_CONSTANT: CONSTANT_OP(OP_LESS, *a < *b); break;
+                case OpCode::OP_EQUAL_CONSTANT_JUMP:
+                    CONSTANT_BRANCH(*a == *b, condition = values_equal(peek(), constant));
+                    break;
+                case OpCode::OP_GREATER_CONSTANT_JUMP:
+                    CONSTANT_BRANCH(*a > *b, runtime_error("Operands must be numbers"); return InterpretResult::RUNTIME_ERROR);
+                    break;
+                case OpCode::OP_LESS_CONSTANT_JUMP:
+                    CONSTANT_BRANCH(*a < *b, runtime_error("Operands must be numbers"); return InterpretResult::RUNTIME_ERROR);
+                    break;
+                case OpCode::OP_PRINT_CONSTANT: {
+                    print_value(READ_CONSTANT());
+                    std::cout << std::endl;
+                    break;
+                }
+                case OpCode::OP_ADD_STR: {
+                    size_t top = stack.size();
+                    std::string* b = top >= 2 ? std::get_if<std::string>(&stack[top - 1]) : nullptr;
+                    std::string* a = top >= 2 ? std::get_if<std::string>(&stack[top - 2]) : nullptr;
+                    if (!a || !b) {
+                        DEOPTIMIZE(OP_ADD);
+                        break;
+                    }
+                    // a grows by what popping b releases
+                    CHARGE(b->size());
+                    CREDIT(*b);
+                    *a += *b;
+                    stack.pop_back();
+                    break;
+                }
                 case OpCode::OP_PRINT: {
+                    CREDIT(peek());
                     print_value(pop());
                     std::cout << std::endl;
                     break;
                 }
-                case OpCode::OP_POP: pop(); break;
+                case OpCode::OP_POP:
+                    CREDIT(peek());
+                    pop();
+                    break;
+                case OpCode::OP_DEFINE_GLOBAL: {
+                    const std::string& name = std::get<std::string>(READ_CONSTANT());
+                    // The value moves off the stack, already charged
+                    if (limited) {
+                        auto existing = globals.find(name);
+                        if (existing != globals.end()) {
+                            credit_allocation(existing->second);
+                        } else {
+                            CHARGE(name.size() + sizeof(Value));
+                        }
+                    }
+                    globals[name] = pop();
+                    break;
+                }
+                case OpCode::OP_GET_GLOBAL: {
+                    const std::string& name = std::get<std::string>(READ_CONSTANT());
+                    Value* global = find_global(name);
+                    if (!global) {
+                        runtime_error("Undefined variable '" + name + "'");
+                        return InterpretResult::RUNTIME_ERROR;
+                    }
+                    CHARGE(string_bytes(*global));
+                    push(*global);
+                    break;
+                }
+                case OpCode::OP_SET_GLOBAL: {
+                    const std::string& name = std::get<std::string>(READ_CONSTANT());
+                    Value* global = find_global(name);
+                    if (!global) {
+                        runtime_error("Undefined variable '" + name + "'");
+                        return InterpretResult::RUNTIME_ERROR;
+                    }
+                    CHARGE(string_bytes(stack.back()));
+                    CREDIT(*global);
+                    *global = peek(0);
+                    break;
+                }
+                case OpCode::OP_GET_LOCAL: {
+                    const Value& local = stack[stack_base + READ_BYTE()];
+                    CHARGE(string_bytes(local));
+                    push(local);
+                    break;
+                }
+                case OpCode::OP_SET_LOCAL: {
+                    uint8_t slot = READ_BYTE();
+                    CHARGE(string_bytes(stack.back()));
+                    CREDIT(stack[stack_base + slot]);
+                    stack[stack_base + slot] = peek(0);
+                    break;
+                }
+                case OpCode::OP_JUMP: {
+                    uint16_t offset = READ_SHORT();
+                    ip += offset;
+                    break;
+                }
+                case OpCode::OP_JUMP_IF_FALSE: {
+                    uint16_t offset = READ_SHORT();
+                    if (is_falsey(peek(0))) ip += offset;
+                    break;
+                }
+                case OpCode::OP_LOOP: {
+                    uint16_t offset = READ_SHORT();
+                    size_t loop_end = ip - chunk->code.data();
+                    ip -= offset;
+                    
+                    // Backward branches per loop header drive loop tiering
+                    size_t loop_start = ip - chunk->code.data();
+                    if (chunk->backedges.size() < chunk->code.size()) chunk->backedges.resize(chunk->code.size());
+                    uint32_t& taken = chunk->backedges[loop_start];
+                    if (taken < UINT32_MAX) taken++;
+                    if (limited) {
+                        if (!charge_instructions(loop_cost(loop_start, loop_end))) {
+                            limit_error();
+                            return InterpretResult::LIMIT_EXCEEDED;
+                        }
+                    } else if (!Profiled && jit_threshold && taken >= jit_threshold * BACKEDGES_PER_RUN) {
+                        enter_loop(loop_start, loop_end);
+                    }
+                    break;
+                }
                 case OpCode::OP_RETURN: {
                     return InterpretResult::OK;
                 }
@@ -172,7 +785,15 @@ VM::InterpretResult VM::run() {
     
     #undef READ_BYTE
     #undef READ_CONSTANT
+    #undef READ_SHORT
     #undef BINARY_OP
+    #undef QUICKEN
+    #undef NUMBER_OP
+    #undef DEOPTIMIZE
+    #undef CONSTANT_OP
+    #undef CONSTANT_BRANCH
+    #undef CHARGE
+    #undef CREDIT
 }
 
 VM::InterpretResult VM::interpret(const std::string& source) {
@@ -193,11 +814,13 @@ VM::InterpretResult VM::interpret(const std::string& source) {
         return InterpretResult::COMPILE_ERROR;
     }
     
-    this->chunk = &chunk;
-    this->ip = chunk.code.data();
-    
-    InterpretResult result = run();
-    return result;
+    return run(chunk);
+}
+
+VM::InterpretResult VM::run(Chunk& compiled) {
+    this->chunk = &compiled;
+    this->ip = compiled.code.data();
+    return run();
 }
 
 }
\ No newline at end of file
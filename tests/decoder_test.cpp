@@ -0,0 +1,308 @@
+#include "graphics.hpp"
+#include <cstdio>
+#include <iostream>
+
+// Decoder tests: valid images and sounds decode as expected, and hostile
+// headers and streams are rejected with an exception instead of huge
+// allocations, endless output or out-of-range reads.
+
+using namespace replit;
+
+static int failures = 0;
+
+#define CHECK(condition)                                                             \
+    do {                                                                             \
+        if (!(condition)) {                                                          \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ")\n"; \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+template <typename F>
+static bool throws(F&& body) {
+    try {
+        body();
+    } catch (const std::exception&) {
+        return true;
+    }
+    return false;
+}
+
+static void put_be32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back((value >> shift) & 0xFF);
+}
+
+// zlib stream of stored blocks, like Framebuffer::save_png writes
+static std::vector<uint8_t> zlib_stored(const std::vector<uint8_t>& raw) {
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    size_t pos = 0;
+    do {
+        size_t len = std::min<size_t>(65535, raw.size() - pos);
+        bool last = pos + len == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(len & 0xFF);
+        zlib.push_back(len >> 8);
+        zlib.push_back(~len & 0xFF);
+        zlib.push_back((~len >> 8) & 0xFF);
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+        pos += len;
+    } while (pos < raw.size());
+    put_be32(zlib, Framebuffer::adler32(raw.data(), raw.size()));
+    return zlib;
+}
+
+static void chunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& body) {
+    put_be32(png, static_cast<uint32_t>(body.size()));
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), body.begin(), body.end());
+    uint32_t crc = Framebuffer::crc32(reinterpret_cast<const uint8_t*>(type), 4);
+    put_be32(png, Framebuffer::crc32(body.data(), body.size(), crc) ^ 0xFFFFFFFFu);
+}
+
+// PNG with the given IHDR fields; rows are filtered scanlines (filter
+// byte first). extra chunks go between IHDR and IDAT.
+static std::vector<uint8_t> make_png(uint32_t width, uint32_t height, int depth, int color_type,
+                                     const std::vector<uint8_t>& rows,
+                                     const std::vector<std::pair<const char*, std::vector<uint8_t>>>& extra = {}) {
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::vector<uint8_t> header;
+    put_be32(header, width);
+    put_be32(header, height);
+    header.insert(header.end(), {static_cast<uint8_t>(depth), static_cast<uint8_t>(color_type), 0, 0, 0});
+    chunk(png, "IHDR", header);
+    for (const auto& [type, body] : extra) chunk(png, type, body);
+    chunk(png, "IDAT", zlib_stored(rows));
+    chunk(png, "IEND", {});
+    return png;
+}
+
+static Image decode(const std::vector<uint8_t>& data) {
+    return ImageDecoder::decode(data.data(), data.size());
+}
+
+static Image decode(const std::string& text) {
+    return ImageDecoder::decode(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+static void test_png_decodes() {
+    // 2x2 RGBA, second row Sub-filtered (blue wraps: 10 + 255)
+    Image rgba = decode(make_png(2, 2, 8, 6, {0, 255, 0, 0, 255, 0, 255, 0, 128,
+                                              1, 0, 0, 255, 255, 10, 10, 10, 0}));
+    CHECK(rgba.width == 2 && rgba.height == 2);
+    CHECK(rgba.pixels.size() == 4);
+    CHECK(rgba.pixels[0] == 0xFF0000FFu);
+    CHECK(rgba.pixels[1] == 0x8000FF00u);
+    CHECK(rgba.pixels[2] == 0xFFFF0000u);
+    CHECK(rgba.pixels[3] == 0xFF090A0Au);
+    
+    // 1-bit grayscale: 0b10100000 over three pixels
+    Image gray = decode(make_png(3, 1, 1, 0, {0, 0xA0}));
+    CHECK(gray.pixels.size() == 3);
+    CHECK(gray.pixels[0] == 0xFFFFFFFFu);
+    CHECK(gray.pixels[1] == 0xFF000000u);
+    CHECK(gray.pixels[2] == 0xFFFFFFFFu);
+    
+    // 2-bit palette with a transparent first entry
+    Image indexed = decode(make_png(2, 1, 2, 3, {0, 0x10},
+                                    {{"PLTE", {1, 2, 3, 40, 50, 60}}, {"tRNS", {0}}}));
+    CHECK(indexed.pixels.size() == 2);
+    CHECK(indexed.pixels[0] == 0x00030201u);
+    CHECK(indexed.pixels[1] == 0xFF3C3228u);
+    
+    // Framebuffer::save_png output reads back
+    Framebuffer framebuffer(3, 2);
+    framebuffer.clear(Color::WHITE());
+    framebuffer.set_pixel(1, 1, 0xFF123456u);
+    const char* path = "decoder_test_tmp.png";
+    CHECK(framebuffer.save_png(path));
+    Image saved = ImageDecoder::load(path);
+    std::remove(path);
+    CHECK(saved.width == 3 && saved.height == 2);
+    CHECK(saved.pixels.size() == 6 && saved.pixels[4] == 0xFF123456u && saved.pixels[0] == 0xFFFFFFFFu);
+}
+
+static void test_png_rejects() {
+    std::vector<uint8_t> row = {0, 0, 0, 0, 0};
+    
+    // Dimensions past the cap fail before anything is allocated for them
+    CHECK(throws([] { decode(make_png(ImageDecoder::MAX_DIMENSION + 1, 1, 8, 6, {0, 0, 0, 0, 0})); }));
+    CHECK(throws([] { decode(make_png(1, 0xFFFFFFFFu, 8, 6, {0, 0, 0, 0, 0})); }));
+    CHECK(throws([] { decode(make_png(0x80000000u, 0x80000000u, 16, 6, {0})); }));
+    CHECK(throws([] { decode(make_png(0, 1, 8, 6, {0})); }));
+    
+    // Depth and color type pairs the specification does not allow
+    CHECK(throws([&] { decode(make_png(1, 1, 4, 2, row)); }));
+    CHECK(throws([&] { decode(make_png(1, 1, 16, 3, row, {{"PLTE", {0, 0, 0}}})); }));
+    CHECK(throws([&] { decode(make_png(1, 1, 2, 4, row)); }));
+    CHECK(throws([&] { decode(make_png(1, 1, 1, 6, row)); }));
+    CHECK(throws([&] { decode(make_png(1, 1, 3, 0, row)); }));
+    CHECK(throws([&] { decode(make_png(1, 1, 8, 5, row)); }));
+    
+    // Short IHDR, missing palette, short image data, bad filter
+    std::vector<uint8_t> short_header = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    chunk(short_header, "IHDR", {0, 0, 0, 1, 0, 0, 0, 1, 8});
+    chunk(short_header, "IEND", {});
+    CHECK(throws([&] { decode(short_header); }));
+    CHECK(throws([] { decode(make_png(1, 1, 8, 3, {0, 0})); }));
+    CHECK(throws([] { decode(make_png(4, 4, 8, 6, {0, 1, 2, 3})); }));
+    CHECK(throws([] { decode(make_png(1, 1, 8, 0, {9, 0})); }));
+}
+
+static void test_inflate() {
+    std::vector<uint8_t> raw(1000, 7);
+    std::vector<uint8_t> zlib = zlib_stored(raw);
+    CHECK(Inflate::zlib(zlib.data(), zlib.size()) == raw);
+    CHECK(Inflate::zlib(zlib.data(), zlib.size(), raw.size()) == raw);
+    CHECK(throws([&] { Inflate::zlib(zlib.data(), zlib.size(), raw.size() - 1); }));
+    
+    // 2000 'a's in a fixed-Huffman block, mostly as length-258 matches
+    std::vector<uint8_t> fixed = {0x78, 0x01, 0x4B, 0x4C, 0x1C, 0x05, 0xA3, 0x60, 0x14, 0x8C, 0x82, 0x51,
+                                  0x30, 0x0A, 0x46, 0xC1, 0x50, 0x07, 0x00, 0x64, 0xC6, 0xF5, 0xEF};
+    CHECK(Inflate::zlib(fixed.data(), fixed.size()) == std::vector<uint8_t>(2000, 'a'));
+    CHECK(Inflate::zlib(fixed.data(), fixed.size(), 2000).size() == 2000);
+    CHECK(throws([&] { Inflate::zlib(fixed.data(), fixed.size(), 1999); }));
+    CHECK(throws([&] { Inflate::zlib(fixed.data(), fixed.size(), 100); }));
+    
+    // Truncated and corrupt streams
+    CHECK(throws([&] { Inflate::zlib(zlib.data(), zlib.size() / 2); }));
+    std::vector<uint8_t> bad_checksum = zlib;
+    bad_checksum.back() ^= 1;
+    CHECK(throws([&] { Inflate::zlib(bad_checksum.data(), bad_checksum.size()); }));
+    std::vector<uint8_t> bad_type = {0x78, 0x01, 0x07, 0, 0, 0, 0};
+    CHECK(throws([&] { Inflate::zlib(bad_type.data(), bad_type.size()); }));
+    
+    // A dynamic block whose all-zero code is a literal decodes the reader's
+    // zero padding as literals forever unless overrun is checked per symbol
+    std::vector<uint8_t> runaway = {0x05, 0xC0, 0x21, 0x09, 0x00, 0x00, 0x00, 0x00, 0x20, 0xFF, 0xAF, 0x16};
+    std::vector<uint8_t> out;
+    CHECK(throws([&] { Inflate::raw(runaway.data(), runaway.size(), out); }));
+    CHECK(out.size() < 1024);
+}
+
+static void test_ppm_and_bmp() {
+    Image ppm = decode(std::string("P3\n# comment\n2 1\n255\n255 0 0  0 0 255\n"));
+    CHECK(ppm.width == 2 && ppm.height == 1);
+    CHECK(ppm.pixels.size() == 2 && ppm.pixels[0] == 0xFF0000FFu && ppm.pixels[1] == 0xFFFF0000u);
+    CHECK(throws([] { decode(std::string("P6\n20000 1\n255\n")); }));
+    CHECK(throws([] { decode(std::string("P6\n4 4\n255\n\x01\x02")); }));
+    
+    // 1x1 24-bit bottom-up BMP
+    std::vector<uint8_t> bmp(58, 0);
+    auto le32 = [&](size_t at, uint32_t v) { for (int i = 0; i < 4; ++i) bmp[at + i] = (v >> (8 * i)) & 0xFF; };
+    bmp[0] = 'B';
+    bmp[1] = 'M';
+    le32(10, 54);
+    le32(14, 40);
+    le32(18, 1);
+    le32(22, 1);
+    bmp[28] = 24;
+    bmp[54] = 0x30;
+    bmp[55] = 0x20;
+    bmp[56] = 0x10;
+    Image decoded = decode(bmp);
+    CHECK(decoded.width == 1 && decoded.height == 1 && decoded.pixels[0] == 0xFF302010u);
+    
+    le32(18, 20000);
+    CHECK(throws([&] { decode(bmp); }));
+    le32(18, 1);
+    le32(22, 0x80000000u);
+    CHECK(throws([&] { decode(bmp); }));
+    
+    // 1x1 8-bit BMP with a two-color palette
+    bmp.assign(66, 0);
+    bmp[0] = 'B';
+    bmp[1] = 'M';
+    le32(10, 62);
+    le32(14, 40);
+    le32(18, 1);
+    le32(22, 1);
+    bmp[28] = 8;
+    le32(46, 2);
+    le32(58, 0x00112233u);
+    bmp[62] = 1;
+    decoded = decode(bmp);
+    CHECK(decoded.width == 1 && decoded.height == 1 && decoded.pixels[0] == 0xFF332211u);
+    
+    // Palette sizes whose byte count wraps 32 bits, or that overrun the file
+    le32(46, 0x40000000u);
+    CHECK(throws([&] { decode(bmp); }));
+    le32(46, 257);
+    CHECK(throws([&] { decode(bmp); }));
+    le32(46, 2);
+    le32(14, 0xFFFFFFF0u);
+    CHECK(throws([&] { decode(bmp); }));
+}
+
+static void test_atlas_and_assets() {
+    // AtlasRegion holds 16-bit sizes
+    TextureAtlas atlas(64);
+    Image wide;
+    wide.width = 70000;
+    wide.height = 1;
+    wide.pixels.resize(70000);
+    CHECK(throws([&] { atlas.insert(wide); }));
+    Image small;
+    small.width = small.height = 2;
+    small.pixels.assign(4, 0xFFFFFFFFu);
+    AtlasRegion region = atlas.insert(small);
+    CHECK(region.width == 2 && region.height == 2);
+    
+    // Failures reach the entry instead of escaping the loader
+    AssetManager assets(64);
+    TextureHandle missing = assets.load_now("decoder_test_missing.png");
+    CHECK(assets.state(missing) == AssetManager::State::FAILED);
+    TextureHandle queued = assets.load("decoder_test_missing_too.png");
+    assets.finish();
+    CHECK(assets.state(queued) == AssetManager::State::FAILED);
+    CHECK(!assets.error(queued).empty());
+}
+
+// Mono 16-bit PCM WAV with `frames` samples of value 0x4000
+static std::vector<uint8_t> make_wav(uint32_t rate, uint32_t frames) {
+    std::vector<uint8_t> wav = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ',
+                                16, 0, 0, 0, 1, 0, 1, 0};
+    auto le32 = [&](uint32_t v) { for (int i = 0; i < 4; ++i) wav.push_back((v >> (8 * i)) & 0xFF); };
+    le32(rate);
+    le32(rate * 2);
+    wav.insert(wav.end(), {2, 0, 16, 0, 'd', 'a', 't', 'a'});
+    le32(frames * 2);
+    for (uint32_t i = 0; i < frames; ++i) wav.insert(wav.end(), {0x00, 0x40});
+    return wav;
+}
+
+static void test_wav() {
+    std::vector<uint8_t> wav = make_wav(24000, 100);
+    SoundBuffer sound = WavCodec::decode(wav.data(), wav.size(), 48000);
+    CHECK(sound.sample_rate == 48000 && sound.frames() == 199);
+    CHECK(sound.samples[0] == 0.5f && sound.samples[1] == 0.5f);
+    
+    // A 1 Hz header would resample 48000x; absurd rates and durations are refused
+    wav = make_wav(1, 100);
+    CHECK(throws([&] { WavCodec::decode(wav.data(), wav.size(), 48000); }));
+    wav = make_wav(4000000, 100);
+    CHECK(throws([&] { WavCodec::decode(wav.data(), wav.size(), 48000); }));
+    wav = make_wav(1000, 1000 * WavCodec::MAX_SECONDS);
+    CHECK(throws([&] { WavCodec::decode(wav.data(), wav.size(), 48000); }));
+    
+    // A missing file is reported, not thrown, and never plays
+    AudioMixer mixer(AudioSink::null(), 48000, false);
+    mixer.play("decoder_test_missing.wav");
+    while (mixer.loading()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    CHECK(!mixer.load_error("decoder_test_missing.wav").empty());
+    CHECK(mixer.stats().active_voices == 0);
+}
+
+int main() {
+    test_png_decodes();
+    test_png_rejects();
+    test_inflate();
+    test_ppm_and_bmp();
+    test_atlas_and_assets();
+    test_wav();
+    if (failures) {
+        std::cerr << failures << " decoder check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Decoder tests passed" << std::endl;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "graphics.hpp"
+#include <iostream>
+
+// Window-side runtime pieces that are easy to get subtly wrong: spatial
+// hash queries over unbounded rays and timer scheduling at wheel edges.
+
+using namespace replit;
+
+static int failures = 0;
+
+#define CHECK(condition)                                                             \
+    do {                                                                             \
+        if (!(condition)) {                                                          \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ")\n"; \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+static void test_ray_queries() {
+    SpatialHash hash(16.0f);
+    hash.insert(1, Rectangle(100, 0, 10, 10));
+    hash.insert(2, Rectangle(40, 0, 10, 10));
+    hash.insert(3, Rectangle(0, 200, 10, 10));
+    
+    // Unbounded rays stop where they leave the boxes' extent
+    CHECK((hash.query_ray(Vector2D(0, 5), Vector2D(1, 0), INFINITY) == std::vector<uint32_t>{2, 1}));
+    CHECK(hash.query_ray(Vector2D(0, 5), Vector2D(-1, 0), INFINITY).empty());
+    CHECK(hash.query_ray(Vector2D(0, 5), Vector2D(1, 0), 60.0f) == std::vector<uint32_t>{2});
+    CHECK(hash.query_ray(Vector2D(5, 5), Vector2D(0, 1), INFINITY) == std::vector<uint32_t>{3});
+    
+    // Origins far outside the extent still find the boxes
+    CHECK((hash.query_ray(Vector2D(-1e9f, 5), Vector2D(1, 0), INFINITY) == std::vector<uint32_t>{2, 1}));
+    CHECK(hash.query_ray(Vector2D(-1e9f, 5), Vector2D(1, 0), 1000.0f).empty());
+    
+    // Non-finite input returns nothing instead of walking forever
+    CHECK(hash.query_ray(Vector2D(NAN, 5), Vector2D(1, 0), INFINITY).empty());
+    CHECK(hash.query_ray(Vector2D(INFINITY, 5), Vector2D(-1, 0), INFINITY).empty());
+    CHECK(hash.query_ray(Vector2D(0, 5), Vector2D(NAN, 0), INFINITY).empty());
+    CHECK(hash.query_ray(Vector2D(0, 5), Vector2D(1, 0), NAN).empty());
+    
+    SpatialHash empty;
+    CHECK(empty.query_ray(Vector2D(0, 0), Vector2D(1, 1), INFINITY).empty());
+}
+
+static void test_window_raycast() {
+    Window window("test", 320, 240);
+    auto near = std::make_shared<Sprite>();
+    near->bounds = Rectangle(50, 50, 20, 20);
+    auto far = std::make_shared<Sprite>();
+    far->bounds = Rectangle(150, 50, 20, 20);
+    window.add_sprite(far);
+    window.add_sprite(near);
+    
+    auto hits = window.raycast(Vector2D(0, 60), Vector2D(1, 0), INFINITY);
+    CHECK(hits.size() == 2 && hits[0] == near && hits[1] == far);
+}
+
+// An event loop that sleeps for ticks_until_next() must never step past
+// an expiry, including timers cascading down from higher levels
+static void test_timer_sleeps() {
+    for (uint64_t start : {0, 1, 63, 100}) {
+        for (uint64_t delay : {1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 4160, 262144}) {
+            TimerWheel wheel(1.0f);
+            wheel.advance_ticks(start);
+            uint64_t fired_at = 0;
+            wheel.schedule(static_cast<float>(delay), [&]() { fired_at = wheel.now(); });
+            
+            // The sleep that fires the timer must end exactly on its tick
+            bool on_time = true;
+            while (fired_at == 0) {
+                uint64_t sleep = wheel.ticks_until_next();
+                if (sleep == 0) break;
+                wheel.advance_ticks(sleep);
+                on_time &= fired_at == 0 || wheel.now() == start + delay;
+            }
+            CHECK(on_time && fired_at == start + delay);
+        }
+    }
+    
+    // Timer 64 ticks out, checked one tick before the level-1 cascade
+    TimerWheel wheel(1.0f);
+    wheel.schedule(64.0f, []() {});
+    wheel.advance_ticks(63);
+    CHECK(wheel.ticks_until_next() == 1);
+}
+
+int main() {
+    test_ray_queries();
+    test_window_raycast();
+    test_timer_sleeps();
+    
+    if (failures) {
+        std::cerr << failures << " graphics test(s) failed\n";
+        return 1;
+    }
+    std::cout << "Graphics tests passed\n";
+    return 0;
+}
\ No newline at end of file
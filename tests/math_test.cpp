@@ -0,0 +1,172 @@
+#include "standard_library.hpp"
+#include <cfloat>
+#include <iostream>
+
+// Batch Math kernels against libm: the SSE2 approximations stay within the
+// error bounds documented on Math, strict mode matches libm exactly, and
+// special inputs (NaN, infinities, zeros, negative bases) match libm.
+
+using namespace replit;
+
+static int failures = 0;
+
+#define CHECK(condition)                                                             \
+    do {                                                                             \
+        if (!(condition)) {                                                          \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ")\n"; \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+// Distance from `reference` in units of the float spacing at the reference
+static double ulps(float value, double reference) {
+    if (std::isnan(reference)) return std::isnan(value) ? 0.0 : INFINITY;
+    if (std::isinf(reference)) return value == reference ? 0.0 : INFINITY;
+    float rounded = std::fabs(static_cast<float>(reference));
+    double spacing = std::isinf(rounded) ? std::ldexp(1.0, 104)
+                                         : std::nextafter(rounded, INFINITY) - rounded;
+    return std::fabs(value - reference) / spacing;
+}
+
+static bool same(float a, float b) {
+    if (std::isnan(a) || std::isnan(b)) return std::isnan(a) && std::isnan(b);
+    return a == b && std::signbit(a) == std::signbit(b);
+}
+
+// `count` points spread evenly over [lo, hi]; odd so the padded tail runs
+static std::vector<float> sweep(float lo, float hi, size_t count = 100003) {
+    std::vector<float> values(count);
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = static_cast<float>(lo + (static_cast<double>(hi) - lo) * i / (count - 1));
+    }
+    return values;
+}
+
+template <typename Batch, typename Reference>
+static double max_ulps(const std::vector<float>& input, Batch batch, Reference reference) {
+    std::vector<float> output = batch(input);
+    double worst = 0;
+    for (size_t i = 0; i < input.size(); ++i) {
+        worst = std::max(worst, ulps(output[i], reference(static_cast<double>(input[i]))));
+    }
+    return worst;
+}
+
+static void test_exp() {
+    auto batch = [](const std::vector<float>& v) { return Math::exp(v); };
+    auto reference = [](double x) { return std::exp(x); };
+    CHECK(max_ulps(sweep(-104.0f, 88.0f), batch, reference) <= 1.0);
+    CHECK(max_ulps(sweep(-1.0f, 1.0f), batch, reference) <= 1.0);
+    
+    std::vector<float> edges = {0.0f, -0.0f, 89.0f, -110.0f, INFINITY, -INFINITY, NAN};
+    std::vector<float> out = Math::exp(edges);
+    CHECK(out[0] == 1.0f && out[1] == 1.0f);
+    CHECK(std::isinf(out[2]) && out[3] == 0.0f);
+    CHECK(std::isinf(out[4]) && out[5] == 0.0f && std::isnan(out[6]));
+}
+
+static void test_log() {
+    auto batch = [](const std::vector<float>& v) { return Math::log(v); };
+    auto reference = [](double x) { return std::log(x); };
+    CHECK(max_ulps(sweep(1e-3f, 10.0f), batch, reference) <= 1.0);
+    CHECK(max_ulps(sweep(0.5f, 2.0f), batch, reference) <= 1.0);
+    CHECK(max_ulps(sweep(1.0f, 3e38f), batch, reference) <= 1.0);
+    CHECK(max_ulps(sweep(1e-44f, FLT_MIN), batch, reference) <= 1.0);
+    
+    std::vector<float> edges = {0.0f, -0.0f, -1.0f, INFINITY, NAN};
+    std::vector<float> out = Math::log(edges);
+    CHECK(out[0] == -INFINITY && out[1] == -INFINITY);
+    CHECK(std::isnan(out[2]) && out[3] == INFINITY && std::isnan(out[4]));
+}
+
+static void test_sin() {
+    auto batch = [](const std::vector<float>& v) { return Math::sin(v); };
+    CHECK(max_ulps(sweep(-10.0f, 10.0f), batch, [](double x) { return std::sin(x); }) <= 1.5);
+    
+    std::vector<float> wide = sweep(-8192.0f, 8192.0f);
+    std::vector<float> out = Math::sin(wide);
+    double worst = 0;
+    for (size_t i = 0; i < wide.size(); ++i) {
+        worst = std::max(worst, std::fabs(out[i] - std::sin(static_cast<double>(wide[i]))));
+    }
+    CHECK(worst <= 8e-8);
+    
+    // Lanes past 8192 fall back to libm
+    std::vector<float> edges = {1e6f, -3e7f, INFINITY, NAN, -0.0f};
+    out = Math::sin(edges);
+    for (size_t i = 0; i < edges.size(); ++i) CHECK(same(out[i], std::sin(edges[i])));
+}
+
+static void test_pow() {
+    for (float exponent : {0.5f, 2.0f, -1.5f, 3.0f}) {
+        std::vector<float> bases = sweep(1e-3f, 100.0f);
+        std::vector<float> out = Math::pow(bases, exponent);
+        bool within = true;
+        for (size_t i = 0; i < bases.size(); ++i) {
+            double reference = std::pow(static_cast<double>(bases[i]), exponent);
+            double bound = (2.0 + std::fabs(exponent * std::log(bases[i]))) * FLT_EPSILON;
+            within &= std::fabs(out[i] - reference) <= bound * std::fabs(reference);
+        }
+        CHECK(within);
+    }
+    
+    // Negative bases and signed zeros go through libm, in any lane
+    std::vector<float> bases = {2.0f, -2.0f, -0.5f, 4.0f, -0.0f, -3.0f, 0.0f};
+    for (float exponent : {3.0f, 2.0f, 0.5f, -1.0f}) {
+        std::vector<float> out = Math::pow(bases, exponent);
+        for (size_t i = 0; i < bases.size(); ++i) {
+            if (bases[i] <= 0.0f) CHECK(same(out[i], std::pow(bases[i], exponent)));
+        }
+    }
+    CHECK(Math::pow(bases, 0.0f) == std::vector<float>(bases.size(), 1.0f));
+}
+
+static void test_strict() {
+    Math::strict_batch = true;
+    std::vector<float> input = sweep(-20.0f, 20.0f, 4099);
+    std::vector<float> positive = sweep(1e-3f, 50.0f, 4099);
+    std::vector<float> sines = Math::sin(input);
+    std::vector<float> exps = Math::exp(input);
+    std::vector<float> logs = Math::log(positive);
+    std::vector<float> pows = Math::pow(input, 3.0f);
+    Math::strict_batch = false;
+    
+    bool exact = true;
+    for (size_t i = 0; i < input.size(); ++i) {
+        exact &= same(sines[i], std::sin(input[i]));
+        exact &= same(exps[i], std::exp(input[i]));
+        exact &= same(logs[i], std::log(positive[i]));
+        exact &= same(pows[i], std::pow(input[i], 3.0f));
+    }
+    CHECK(exact);
+}
+
+static void test_exact_kernels() {
+    std::vector<float> input = sweep(0.0f, 1000.0f, 1001);
+    std::vector<float> roots = Math::sqrt(input);
+    std::vector<float> clamped = Math::clamp(input, 10.0f, 20.0f);
+    std::vector<float> mixed = Math::lerp(input, roots, 0.25f);
+    bool exact = true;
+    for (size_t i = 0; i < input.size(); ++i) {
+        exact &= roots[i] == std::sqrt(input[i]);
+        exact &= clamped[i] == std::max(10.0f, std::min(input[i], 20.0f));
+        exact &= mixed[i] == input[i] + 0.25f * (roots[i] - input[i]);
+    }
+    CHECK(exact);
+}
+
+int main() {
+    test_exp();
+    test_log();
+    test_sin();
+    test_pow();
+    test_strict();
+    test_exact_kernels();
+    
+    if (failures) {
+        std::cerr << failures << " math test(s) failed\n";
+        return 1;
+    }
+    std::cout << "Math tests passed\n";
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,475 @@
+#include "replit_core.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// VM tests: scripts produce the same output with the JIT off and with it
+// compiling on first use, across guard exits, loop entry, quickened and
+// fused instructions; execution limits stop runaway scripts.
+
+using namespace replit;
+
+static int failures = 0;
+
+#define CHECK(condition)                                                             \
+    do {                                                                             \
+        if (!(condition)) {                                                          \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ")\n"; \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+static bool compile(const std::string& source, Chunk& chunk) {
+    Lexer lexer(source);
+    std::vector<Token> tokens;
+    while (true) {
+        tokens.push_back(lexer.scan_token());
+        if (tokens.back().type == TokenType::EOF_TOKEN) break;
+    }
+    Parser parser;
+    return parser.compile(tokens, &chunk);
+}
+
+struct Outcome {
+    std::string output;
+    std::string errors;
+    VM::InterpretResult result = VM::InterpretResult::OK;
+    bool compiled = false;      // some of the chunk ran as machine code
+};
+
+// Runs one chunk `runs` times in a fresh VM and captures what it prints
+static Outcome run(const std::string& source, uint32_t jit_threshold, int runs = 3,
+                   const ExecutionLimits& limits = {}) {
+    Outcome outcome;
+    Chunk chunk;
+    if (!compile(source, chunk)) {
+        outcome.result = VM::InterpretResult::COMPILE_ERROR;
+        return outcome;
+    }
+    
+    VM vm;
+    vm.set_jit_threshold(jit_threshold);
+    vm.set_limits(limits);
+    std::ostringstream captured, diagnostics;
+    std::streambuf* original = std::cout.rdbuf(captured.rdbuf());
+    std::streambuf* original_errors = std::cerr.rdbuf(diagnostics.rdbuf());
+    for (int i = 0; i < runs && outcome.result == VM::InterpretResult::OK; ++i) {
+        outcome.result = vm.run(chunk);
+        std::cout << "|";
+    }
+    std::cout.rdbuf(original);
+    std::cerr.rdbuf(original_errors);
+    
+    outcome.output = captured.str();
+    outcome.errors = diagnostics.str();
+    outcome.compiled = chunk.jit != nullptr;
+    for (const auto& [offset, code] : chunk.loop_jit) outcome.compiled |= code != nullptr;
+    return outcome;
+}
+
+// Interpreter and JIT must agree; returns the interpreter's output
+static std::string same_both_ways(const std::string& source, bool expect_compiled = true) {
+    Outcome interpreted = run(source, 0);
+    Outcome jitted = run(source, 1);
+    CHECK(interpreted.result == jitted.result);
+    CHECK(interpreted.output == jitted.output);
+    CHECK(interpreted.errors == jitted.errors);
+    CHECK(!interpreted.compiled);
+    if (expect_compiled && JitCode::supported()) CHECK(jitted.compiled);
+    if (interpreted.output != jitted.output) {
+        std::cerr << "  interpreter: " << interpreted.output << "\n  jit:         " << jitted.output << "\n";
+    }
+    return interpreted.output;
+}
+
+// A local changes type after the loop has been compiled, so the guards
+// on arithmetic and on the branch condition fail and exit mid-loop
+static void test_guard_exits() {
+    std::string output = same_both_ways(R"(
+{
+    let v = 0;
+    let x = 1;
+    let total = 0;
+    let i = 0;
+    while (i < 300) {
+        if (i == 200) v = true;
+        if (i == 250) v = nil;
+        if (i == 280) x = "s";
+        let y = x + i;
+        total = total + i;
+        if (v) total = total + 1;
+        if (i == 299) print y;
+        i = i + 1;
+    }
+    print total;
+    print v;
+}
+)");
+    CHECK(output == "s299.000000\n45100\nnil\n|s299.000000\n45100\nnil\n|s299.000000\n45100\nnil\n|");
+}
+
+// Enough iterations to enter compiled loops part way through a run, with
+// values already on the stack
+static void test_loop_entry() {
+    std::string output = same_both_ways(R"(
+{
+    let outer = 0;
+    let sum = 0;
+    while (outer < 5) {
+        let inner = 0;
+        while (inner < 100) {
+            sum = sum + inner * outer;
+            inner = inner + 1;
+        }
+        outer = outer + 1;
+    }
+    print sum;
+}
+)");
+    CHECK(output == "49500\n|49500\n|49500\n|");
+}
+
+// NaN compares false every way, including through fused constants
+static void test_nan_compares() {
+    std::string output = same_both_ways(R"(
+{
+    let nan = 0 / 0;
+    let count = 0;
+    let i = 0;
+    while (i < 200) {
+        if (nan < i) count = count + 1;
+        if (nan > i) count = count + 10;
+        if (nan == nan) count = count + 100;
+        if (!(nan < i)) count = count + 1000;
+        if (nan != nan) count = count + 1;
+        if (nan < 5) count = count + 10000;
+        if (nan == 1) count = count + 10000;
+        i = i + 1;
+    }
+    print count;
+    print nan == nan;
+    print nan < 1;
+    print 1 > nan;
+}
+)");
+    CHECK(output.substr(0, output.find('|')) == "200200\nfalse\nfalse\nfalse\n");
+}
+
+// Only nil and false are falsey; and/or yield an operand, not a bool
+static void test_truthiness() {
+    std::string output = same_both_ways(R"(
+{
+    let hits = 0;
+    let i = 0;
+    while (i < 200) {
+        let a = nil;
+        let b = false;
+        let c = 0;
+        if (i > 100) a = true;
+        if (a or b) hits = hits + 1;
+        if (a and c) hits = hits + 2;
+        if (c) hits = hits + 4;
+        if (!a) hits = hits + 8;
+        if (nil or c) hits = hits + 16;
+        let d = b or a;
+        if (d == true) hits = hits + 32;
+        let e = a and 5;
+        if (e == 5) hits = hits + 64;
+        if (!nil == true) hits = hits + 128;
+        i = i + 1;
+    }
+    print hits;
+    print nil or 3;
+    print false and 1;
+    print 1 and 2;
+    print nil == false;
+}
+)");
+    CHECK(output.substr(0, output.find('|')) == "40209\n3\nfalse\n2\nfalse\n");
+}
+
+// Globals keep these sites in the interpreter: quickened arithmetic and
+// compares see numbers, then strings, and fall back to the generic path
+static void test_quickening_fallback() {
+    std::string output = same_both_ways(R"(
+let g = 1;
+let acc = 0;
+let equal = 0;
+let i = 0;
+while (i < 100) {
+    if (i == 50) g = "s";
+    if (g == 1) equal = equal + 1;
+    acc = acc + g;
+    i = i + 1;
+}
+print equal;
+print acc == 50;
+)", false);
+    CHECK(output == "50\nfalse\n|50\nfalse\n|50\nfalse\n|");
+}
+
+// Superinstructions with a non-number operand take the generic path, and
+// type errors are reported the same way, including in compare-and-branch
+static void test_fused_fallback() {
+    std::string output = same_both_ways(R"(
+{
+    let s = 0;
+    let r = 0;
+    let zeros = 0;
+    let i = 0;
+    while (i < 150) {
+        if (i == 100) s = "t";
+        r = s + 1;
+        if (s == 0) zeros = zeros + 1;
+        i = i + 1;
+    }
+    print r;
+    print zeros;
+}
+)");
+    CHECK(output == "t1.000000\n100\n|t1.000000\n100\n|t1.000000\n100\n|");
+    
+    // Compare-and-branch on strings, nil and bools
+    output = same_both_ways(R"(
+{
+    let v = 0;
+    let taken = 0;
+    let i = 0;
+    while (i < 200) {
+        if (i == 120) v = "x";
+        if (i == 160) v = nil;
+        if (i == 180) v = false;
+        if (v == 0) taken = taken + 1;
+        if (v == "x") taken = taken + 1000;
+        if (i > 189) taken = taken + 100000;
+        i = i + 1;
+    }
+    print taken;
+}
+)");
+    CHECK(output == "1040120\n|1040120\n|1040120\n|");
+    
+    for (const char* source : {"let z = \"a\"; print z < 3;", "let z = \"a\"; if (z > 3) print z;"}) {
+        Outcome interpreted = run(source, 0);
+        Outcome jitted = run(source, 1);
+        CHECK(interpreted.result == VM::InterpretResult::RUNTIME_ERROR);
+        CHECK(jitted.result == VM::InterpretResult::RUNTIME_ERROR);
+        CHECK(interpreted.errors == jitted.errors && !interpreted.errors.empty());
+    }
+}
+
+static void test_instruction_limit() {
+    ExecutionLimits limits;
+    limits.max_instructions = 10000;
+    Outcome endless = run("while (true) {}", 1, 1, limits);
+    CHECK(endless.result == VM::InterpretResult::LIMIT_EXCEEDED);
+    CHECK(endless.errors.find("more than 10000 instructions") != std::string::npos);
+    
+    Outcome bounded = run("{ let i = 0; while (i < 100) i = i + 1; print i; }", 1, 3, limits);
+    CHECK(bounded.result == VM::InterpretResult::OK);
+    CHECK(bounded.output == "100\n|100\n|100\n|");
+}
+
+// The budget covers what a run holds, so copying and replacing strings
+// in a long loop stays within it while an ever-growing string does not
+static void test_allocation_limit() {
+    ExecutionLimits limits;
+    limits.max_allocated_bytes = 1000;
+    
+    Outcome churn = run(R"(
+let g = "0123456789012345678901234567890123456789";
+{
+    let s = "abcdefghijklmnopqrstuvwxyz";
+    let copies = 0;
+    let i = 0;
+    while (i < 1000) {
+        let t = s;
+        g = t + "!";
+        s = "abcdefghijklmnopqrstuvwxyz";
+        if (g == s) copies = copies - 1;
+        copies = copies + 1;
+        i = i + 1;
+    }
+    print copies;
+}
+)", 1, 3, limits);
+    CHECK(churn.result == VM::InterpretResult::OK);
+    CHECK(churn.output == "1000\n|1000\n|1000\n|");
+    
+    Outcome growth = run(R"(
+{
+    let s = "";
+    let i = 0;
+    while (i < 1000) {
+        s = s + "0123456789";
+        i = i + 1;
+    }
+}
+)", 1, 1, limits);
+    CHECK(growth.result == VM::InterpretResult::LIMIT_EXCEEDED);
+    CHECK(growth.errors.find("more than 1000 bytes") != std::string::npos);
+    
+    Outcome globals = run(R"(
+let i = 0;
+let all = "";
+while (i < 200) {
+    all = all + "x";
+    i = i + 1;
+}
+print all == "";
+)", 1, 1, limits);
+    CHECK(globals.result == VM::InterpretResult::OK);
+    CHECK(globals.output == "false\n|");
+}
+
+static void test_time_limit() {
+    ExecutionLimits limits;
+    limits.timeout = std::chrono::milliseconds(50);
+    auto start = std::chrono::steady_clock::now();
+    Outcome endless = run("{ let i = 0; while (true) i = i + 1; }", 1, 1, limits);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    CHECK(endless.result == VM::InterpretResult::LIMIT_EXCEEDED);
+    CHECK(endless.errors.find("longer than 50ms") != std::string::npos);
+    CHECK(elapsed >= limits.timeout);
+    CHECK(elapsed < std::chrono::seconds(5));
+}
+
+static std::vector<char> read_bytes(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void write_bytes(const std::string& path, const std::vector<char>& bytes) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+// A list whose element count runs past the value table is rejected
+// before anything is reserved for it
+static void test_snapshot_hostile_counts() {
+    const std::string path = "temp_vm_test.img";
+    std::unordered_map<std::string, Value> globals;
+    globals["list"] = std::vector<Value>{1.0, std::string("two"), nullptr};
+    Snapshot::write(path, globals);
+    
+    // ImageHeader::values sits after magic, version, byte order, size,
+    // strings and string_data, value_count after the other offsets and the
+    // string count; ValueEntry is tag, 3 reserved, count, payload
+    std::vector<char> image = read_bytes(path);
+    uint64_t values;
+    uint32_t value_count;
+    std::memcpy(&values, image.data() + 40, sizeof(values));
+    std::memcpy(&value_count, image.data() + 68, sizeof(value_count));
+    const uint8_t LIST_TAG = 7;
+    int patched = 0;
+    for (uint32_t i = 0; i < value_count; ++i) {
+        char* entry = image.data() + values + i * 16;
+        if (static_cast<uint8_t>(entry[0]) != LIST_TAG) continue;
+        uint32_t count = UINT32_MAX;
+        std::memcpy(entry + 4, &count, sizeof(count));
+        patched++;
+    }
+    CHECK(patched == 1);
+    write_bytes(path, image);
+    
+    std::shared_ptr<const Snapshot> snapshot = Snapshot::open(path);
+    Value value;
+    bool rejected = false;
+    try {
+        snapshot->find_global("list", value);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+    std::remove(path.c_str());
+}
+
+static std::string run_restored(const std::string& image, const std::string& filename) {
+    ReplitEngine engine;
+    CHECK(engine.restore_snapshot(image));
+    std::ostringstream captured;
+    std::streambuf* original = std::cout.rdbuf(captured.rdbuf());
+    CHECK(engine.run_file(filename));
+    std::cout.rdbuf(original);
+    return captured.str();
+}
+
+// Globals and compiled chunks survive an image; a restored engine runs the
+// saved chunk for unchanged source and compiles edited source
+static void test_snapshot_round_trip() {
+    const std::string image = "temp_vm_test.img";
+    const std::string setup = "temp_vm_setup.rpl";
+    const std::string main_file = "temp_vm_main.rpl";
+    const std::string main_source = "{\n    let i = 0;\n    while (i < 3) i = i + 1;\n"
+                                    "    print greeting;\n    print base + i;\n}\n";
+    std::string setup_source = "let base = 41; let greeting = \"hi\";";
+    write_bytes(setup, std::vector<char>(setup_source.begin(), setup_source.end()));
+    write_bytes(main_file, std::vector<char>(main_source.begin(), main_source.end()));
+    {
+        ReplitEngine engine;
+        CHECK(engine.run_file(setup));
+        CHECK(engine.compile_file(main_file));
+        CHECK(engine.save_snapshot(image));
+    }
+    
+    std::shared_ptr<const Snapshot> snapshot = Snapshot::open(image);
+    CHECK(snapshot->global_count() == 2);
+    CHECK(snapshot->chunk_names().size() == 2);
+    Chunk compiled;
+    CHECK(compile(main_source, compiled));
+    bool saved = false;
+    for (const std::string& name : snapshot->chunk_names()) {
+        Chunk loaded;
+        CHECK(snapshot->load_chunk(name, loaded));
+        saved |= loaded.code == compiled.code && loaded.lines == compiled.lines &&
+                 loaded.constants.size() == compiled.constants.size();
+    }
+    CHECK(saved);
+    snapshot.reset();
+    
+    CHECK(run_restored(image, main_file) == "hi\n44\n");
+    
+    // Only the saved chunk sees a loop bound changed in the image
+    std::vector<char> bytes = read_bytes(image);
+    double three = 3.0;
+    double five = 5.0;
+    auto found = std::search(bytes.begin(), bytes.end(), reinterpret_cast<const char*>(&three),
+                             reinterpret_cast<const char*>(&three) + sizeof(three));
+    CHECK(found != bytes.end());
+    if (found != bytes.end()) std::memcpy(&*found, &five, sizeof(five));
+    write_bytes(image, bytes);
+    CHECK(run_restored(image, main_file) == "hi\n46\n");
+    
+    std::string edited = "print greeting;";
+    write_bytes(main_file, std::vector<char>(edited.begin(), edited.end()));
+    CHECK(run_restored(image, main_file) == "hi\n");
+    
+    std::remove(image.c_str());
+    std::remove(setup.c_str());
+    std::remove(main_file.c_str());
+}
+
+int main() {
+    test_guard_exits();
+    test_loop_entry();
+    test_nan_compares();
+    test_truthiness();
+    test_quickening_fallback();
+    test_fused_fallback();
+    test_instruction_limit();
+    test_allocation_limit();
+    test_time_limit();
+    test_snapshot_hostile_counts();
+    test_snapshot_round_trip();
+    
+    if (failures) {
+        std::cerr << failures << " VM test(s) failed\n";
+        return 1;
+    }
+    std::cout << "VM tests passed\n";
+    return 0;
+}
\ No newline at end of file